@@ -1,11 +1,16 @@
 #include "mainwindow.h"
 
+#include "AsyncLog.h"
+
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    AsyncLog::start();
     MainWindow w;
     w.show();
-    return a.exec();
+    const int exitCode = a.exec();
+    AsyncLog::stop();
+    return exitCode;
 }
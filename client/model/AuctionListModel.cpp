@@ -0,0 +1,341 @@
+#include "AuctionListModel.h"
+
+#include <QDateTime>
+#include <QLocale>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+bool lessBy(int column, const Protocol::AuctionSummary &a, const Protocol::AuctionSummary &b)
+{
+    switch (column) {
+    case AuctionListModel::TitleColumn:
+        return a.title.compare(b.title, Qt::CaseInsensitive) < 0;
+    case AuctionListModel::PriceColumn:
+        return a.currentPrice < b.currentPrice;
+    case AuctionListModel::MinimumBidColumn:
+        return a.minimumBid < b.minimumBid;
+    case AuctionListModel::BidsColumn:
+        return a.bidCount < b.bidCount;
+    case AuctionListModel::EndsColumn:
+        return a.endsAtMs < b.endsAtMs;
+    case AuctionListModel::StatusColumn:
+        return a.open < b.open;
+    default:
+        return a.auctionId < b.auctionId;
+    }
+}
+
+bool isOpen(const Protocol::AuctionSummary &auction)
+{
+    return auction.open && auction.endsAtMs > QDateTime::currentMSecsSinceEpoch();
+}
+} // namespace
+
+AuctionListModel::AuctionListModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , refreshTimer(this)
+    , expiryTimer(this)
+{
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(kRefreshMs);
+    connect(&refreshTimer, &QTimer::timeout, this, &AuctionListModel::flushPriceUpdates);
+    expiryTimer.setSingleShot(true);
+    connect(&expiryTimer, &QTimer::timeout, this, &AuctionListModel::expireRows);
+}
+
+int AuctionListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int AuctionListModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant AuctionListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.size()) {
+        return QVariant();
+    }
+    const Protocol::AuctionSummary &auction = rows.at(index.row());
+
+    if (role == AuctionIdRole) {
+        return auction.auctionId;
+    }
+    if (role == Qt::TextAlignmentRole) {
+        const bool numeric = index.column() != TitleColumn && index.column() != StatusColumn;
+        return static_cast<int>((numeric ? Qt::AlignRight : Qt::AlignLeft) | Qt::AlignVCenter);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case IdColumn:
+        return auction.auctionId;
+    case TitleColumn:
+        return auction.title;
+    case PriceColumn:
+        return QLocale().toString(auction.currentPrice);
+    case MinimumBidColumn:
+        return QLocale().toString(auction.minimumBid);
+    case BidsColumn:
+        return auction.bidCount;
+    case EndsColumn:
+        return QDateTime::fromMSecsSinceEpoch(auction.endsAtMs).toString(QStringLiteral("dd/MM/yyyy HH:mm"));
+    case StatusColumn:
+        return isOpen(auction) ? tr("Open") : tr("Closed");
+    default:
+        return QVariant();
+    }
+}
+
+QVariant AuctionListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case IdColumn:
+        return tr("#");
+    case TitleColumn:
+        return tr("Title");
+    case PriceColumn:
+        return tr("Price");
+    case MinimumBidColumn:
+        return tr("Min bid");
+    case BidsColumn:
+        return tr("Bids");
+    case EndsColumn:
+        return tr("Ends");
+    case StatusColumn:
+        return tr("Status");
+    default:
+        return QVariant();
+    }
+}
+
+bool AuctionListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !exhausted && !fetching;
+}
+
+void AuctionListModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    fetching = true;
+    emit fetchRequested(nextBeforeId, kPageSize);
+}
+
+void AuctionListModel::appendPage(const Protocol::AuctionPage &page)
+{
+    if (!fetching || page.beforeId != nextBeforeId) {
+        return; // answers a request made before reload()
+    }
+    fetching = false;
+    nextBeforeId = page.nextBeforeId;
+    exhausted = nextBeforeId == 0;
+
+    // Keyset pages do not overlap, but a reload can race an older request.
+    QVector<Protocol::AuctionSummary> fresh;
+    fresh.reserve(page.auctions.size());
+    for (const Protocol::AuctionSummary &auction : page.auctions) {
+        if (!rowOfAuction.contains(auction.auctionId)) {
+            fresh.append(auction);
+        }
+    }
+    if (fresh.isEmpty()) {
+        return;
+    }
+
+    const int first = rows.size();
+    beginInsertRows(QModelIndex(), first, first + fresh.size() - 1);
+    for (const Protocol::AuctionSummary &auction : std::as_const(fresh)) {
+        rowOfAuction.insert(auction.auctionId, rows.size());
+        rows.append(auction);
+    }
+    endInsertRows();
+
+    if (!isServerOrder()) {
+        sortRows();
+    }
+    scheduleExpiry();
+}
+
+void AuctionListModel::fetchFailed(qint64 beforeId)
+{
+    if (fetching && beforeId == nextBeforeId) {
+        fetching = false;
+    }
+}
+
+void AuctionListModel::reload()
+{
+    beginResetModel();
+    rows.clear();
+    rowOfAuction.clear();
+    pendingUpdates.clear();
+    refreshTimer.stop();
+    expiryTimer.stop();
+    nextBeforeId = 0;
+    exhausted = false;
+    fetching = false;
+    endResetModel();
+}
+
+void AuctionListModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= ColumnCount) {
+        column = IdColumn;
+    }
+    if (column == sortColumn && order == sortOrder) {
+        return;
+    }
+    sortColumn = column;
+    sortOrder = order;
+    sortRows();
+}
+
+void AuctionListModel::sortRows()
+{
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    // Persistent indexes (selection, current row) follow their auction.
+    const QModelIndexList before = persistentIndexList();
+    QVector<qint64> auctionIds;
+    auctionIds.reserve(before.size());
+    for (const QModelIndex &index : before) {
+        auctionIds.append(rows.at(index.row()).auctionId);
+    }
+
+    const int column = sortColumn;
+    const bool ascending = sortOrder == Qt::AscendingOrder;
+    std::sort(rows.begin(), rows.end(), [column, ascending](const Protocol::AuctionSummary &a,
+                                                            const Protocol::AuctionSummary &b) {
+        if (lessBy(column, a, b)) {
+            return ascending;
+        }
+        if (lessBy(column, b, a)) {
+            return !ascending;
+        }
+        return a.auctionId > b.auctionId; // ties: newest first
+    });
+    rebuildIndex();
+
+    QModelIndexList after;
+    after.reserve(before.size());
+    for (int i = 0; i < before.size(); ++i) {
+        after.append(index(rowOfAuction.value(auctionIds.at(i)), before.at(i).column()));
+    }
+    changePersistentIndexList(before, after);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void AuctionListModel::rebuildIndex()
+{
+    rowOfAuction.clear();
+    rowOfAuction.reserve(rows.size());
+    for (int row = 0; row < rows.size(); ++row) {
+        rowOfAuction.insert(rows.at(row).auctionId, row);
+    }
+}
+
+qint64 AuctionListModel::auctionIdAt(int row) const
+{
+    return row >= 0 && row < rows.size() ? rows.at(row).auctionId : 0;
+}
+
+void AuctionListModel::applyPriceUpdates(const QVector<Protocol::PriceUpdate> &updates)
+{
+    for (const Protocol::PriceUpdate &update : updates) {
+        // bidCount only grows, so a lower one is a late snapshot of an older state.
+        const int row = rowOfAuction.value(update.auctionId, -1);
+        if (row < 0 || rows.at(row).bidCount > update.bidCount) {
+            continue;
+        }
+        const auto pending = pendingUpdates.constFind(update.auctionId);
+        if (pending == pendingUpdates.constEnd() || pending->bidCount <= update.bidCount) {
+            pendingUpdates.insert(update.auctionId, update);
+        }
+    }
+    if (!pendingUpdates.isEmpty() && !refreshTimer.isActive()) {
+        refreshTimer.start();
+    }
+}
+
+void AuctionListModel::flushPriceUpdates()
+{
+    QVector<int> changed;
+    changed.reserve(pendingUpdates.size());
+    for (const Protocol::PriceUpdate &update : std::as_const(pendingUpdates)) {
+        const int row = rowOfAuction.value(update.auctionId, -1);
+        if (row < 0) {
+            continue;
+        }
+        Protocol::AuctionSummary &auction = rows[row];
+        auction.currentPrice = update.currentPrice;
+        auction.minimumBid = update.minimumBid;
+        auction.leaderId = update.leaderId;
+        auction.bidCount = update.bidCount;
+        auction.endsAtMs = update.endsAtMs;
+        changed.append(row);
+    }
+    pendingUpdates.clear();
+
+    // Only the columns a bid changes; a new end time can change the status too.
+    std::sort(changed.begin(), changed.end());
+    emitRowsChanged(changed, PriceColumn, StatusColumn);
+    scheduleExpiry();
+}
+
+void AuctionListModel::expireRows()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<int> changed;
+    for (int row = 0; row < rows.size(); ++row) {
+        Protocol::AuctionSummary &auction = rows[row];
+        if (auction.open && auction.endsAtMs <= now) {
+            auction.open = false;
+            changed.append(row);
+        }
+    }
+    emitRowsChanged(changed, StatusColumn, StatusColumn);
+    scheduleExpiry();
+}
+
+void AuctionListModel::scheduleExpiry()
+{
+    qint64 next = std::numeric_limits<qint64>::max();
+    for (const Protocol::AuctionSummary &auction : std::as_const(rows)) {
+        if (auction.open) {
+            next = std::min(next, auction.endsAtMs);
+        }
+    }
+    if (next == std::numeric_limits<qint64>::max()) {
+        expiryTimer.stop();
+        return;
+    }
+    // Rows ending close together are closed by one pass.
+    const qint64 delay = next - QDateTime::currentMSecsSinceEpoch();
+    expiryTimer.start(static_cast<int>(qBound<qint64>(kExpiryCheckMs, delay, 24ll * 3600 * 1000)));
+}
+
+void AuctionListModel::emitRowsChanged(const QVector<int> &changed, int firstColumn, int lastColumn)
+{
+    static const QVector<int> roles{Qt::DisplayRole};
+    for (int i = 0; i < changed.size();) {
+        const int first = changed.at(i);
+        int last = first;
+        while (++i < changed.size() && changed.at(i) == last + 1) {
+            last = changed.at(i);
+        }
+        emit dataChanged(index(first, firstColumn), index(last, lastColumn), roles);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef AUCTIONLISTMODEL_H
+#define AUCTIONLISTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+
+#include "network/Protocol.h"
+
+// Auctions loaded page by page as the view scrolls (canFetchMore/fetchMore).
+// The model only asks for pages through fetchRequested; its owner fetches
+// them and hands them back to appendPage(). Price pushes are buffered and
+// applied on a timer as dataChanged() over the affected rows, never as a
+// reset, so selection and scroll position survive a busy auction. Status is
+// derived from the local clock, so rows are also marked closed when their
+// end time passes.
+class AuctionListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        IdColumn,
+        TitleColumn,
+        PriceColumn,
+        MinimumBidColumn,
+        BidsColumn,
+        EndsColumn,
+        StatusColumn,
+        ColumnCount
+    };
+
+    static constexpr int AuctionIdRole = Qt::UserRole + 1;
+    static constexpr int kPageSize = 200;
+    // Buffered price changes are shown at most this often.
+    static constexpr int kRefreshMs = 16;
+    // Rows that ended are marked closed at most this often.
+    static constexpr int kExpiryCheckMs = 1000;
+
+    explicit AuctionListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    // Sorts the loaded rows; pages fetched later are merged into the order.
+    // Live price changes do not move rows until the next sort.
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    qint64 auctionIdAt(int row) const;
+    // True once the last page has arrived.
+    bool isComplete() const { return exhausted; }
+
+public slots:
+    void appendPage(const Protocol::AuctionPage &page);
+    // Lets the next fetchMore() retry the page that failed.
+    void fetchFailed(qint64 beforeId);
+    void applyPriceUpdates(const QVector<Protocol::PriceUpdate> &updates);
+    // Drops every row and starts again from the newest auction.
+    void reload();
+
+signals:
+    void fetchRequested(qint64 beforeId, int limit);
+
+private:
+    void flushPriceUpdates();
+    // Marks rows whose end time has passed as closed, then re-arms expiryTimer.
+    void expireRows();
+    void scheduleExpiry();
+    // One dataChanged() per run of adjacent rows; rows must be sorted.
+    void emitRowsChanged(const QVector<int> &changed, int firstColumn, int lastColumn);
+    // Reorders rows by the current sort column, keeping persistent indexes.
+    void sortRows();
+    void rebuildIndex();
+    bool isServerOrder() const { return sortColumn == IdColumn && sortOrder == Qt::DescendingOrder; }
+
+    QVector<Protocol::AuctionSummary> rows;
+    QHash<qint64, int> rowOfAuction;
+    qint64 nextBeforeId = 0;
+    bool exhausted = false;
+    bool fetching = false;
+    // LIST_AUCTIONS returns newest first, which is this order.
+    int sortColumn = IdColumn;
+    Qt::SortOrder sortOrder = Qt::DescendingOrder;
+
+    // Latest change per auction, waiting for refreshTimer.
+    QHash<qint64, Protocol::PriceUpdate> pendingUpdates;
+    QTimer refreshTimer;
+    // Fires when the next open row ends.
+    QTimer expiryTimer;
+};
+
+#endif // AUCTIONLISTMODEL_H
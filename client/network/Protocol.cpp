@@ -1,99 +1,251 @@
 #include "Protocol.h"
 
+#include "BinaryProtocol.h"
+
+#include <QCborArray>
+#include <QCborValue>
 #include <QJsonDocument>
 #include <QJsonObject>
 
-namespace {
-constexpr char kCmd[] = "CMD=";
-constexpr char kReq[] = "REQ=";
-constexpr char kLen[] = "LEN=";
+namespace Protocol {
 
-QByteArray jsonToBytes(const QJsonObject &obj)
+namespace {
+// Integer field of a server reply; fallback when it is missing or not an integer.
+qint64 integerOf(const QCborValue &value, qint64 fallback = 0)
 {
-    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    qint64 out = fallback;
+    return BinaryProtocol::toInt64(value, out) ? out : fallback;
 }
 } // namespace
 
-namespace Protocol {
-
 QString buildHeader(const QString &command, quint64 reqId, quint64 payloadLen)
 {
     return QStringLiteral("CMD=%1;REQ=%2;LEN=%3\n").arg(command).arg(reqId).arg(payloadLen);
 }
 
+QByteArray encodeFrame(const Frame &frame, int protocolVersion)
+{
+    if (protocolVersion < 2) {
+        const QByteArray json = QJsonDocument(frame.payload.toJsonObject()).toJson(QJsonDocument::Compact);
+        QByteArray data = buildHeader(frame.command, frame.requestId, json.size()).toUtf8();
+        data.append(json);
+        return data;
+    }
+
+    const QByteArray cbor = frame.payload.toCborValue().toCbor();
+    return BinaryProtocol::encodeFrame(BinaryProtocol::commandFromName(frame.command.toLatin1()),
+                                       frame.requestId, cbor);
+}
+
+Frame makeHello(quint64 reqId, int protocolVersion, bool ordered)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("protocol"), protocolVersion);
+    obj.insert(QStringLiteral("ordered"), ordered);
+
+    Frame frame;
+    frame.command = QStringLiteral("HELLO");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
 Frame makeLoginRequest(quint64 reqId, const QString &username, const QString &password)
 {
-    QJsonObject obj;
+    QCborMap obj;
     obj.insert(QStringLiteral("username"), username);
     obj.insert(QStringLiteral("password"), password);
     obj.insert(QStringLiteral("client"), QStringLiteral("qt"));
-    const QByteArray payload = jsonToBytes(obj);
 
     Frame frame;
     frame.command = QStringLiteral("LOGIN");
     frame.requestId = reqId;
-    frame.payload = payload;
+    frame.payload = obj;
     return frame;
 }
 
 Frame makeRegisterRequest(quint64 reqId, const User &user)
 {
-    QJsonObject obj;
+    QCborMap obj;
     obj.insert(QStringLiteral("username"), user.email);
     obj.insert(QStringLiteral("password"), user.password);
     obj.insert(QStringLiteral("fullName"), user.fullName);
     obj.insert(QStringLiteral("phone"), user.phone);
     obj.insert(QStringLiteral("client"), QStringLiteral("qt"));
-    const QByteArray payload = jsonToBytes(obj);
 
     Frame frame;
     frame.command = QStringLiteral("REGISTER");
     frame.requestId = reqId;
-    frame.payload = payload;
+    frame.payload = obj;
     return frame;
 }
 
 Frame makePing(quint64 reqId)
 {
-    QJsonObject obj;
-    const QByteArray payload = jsonToBytes(obj);
+    QCborMap obj;
 
     Frame frame;
     frame.command = QStringLiteral("PING");
     frame.requestId = reqId;
-    frame.payload = payload;
+    frame.payload = obj;
     return frame;
 }
 
-Frame parseFrame(const QByteArray &headerLine, const QByteArray &payload)
+Frame makeCreateAuctionRequest(quint64 reqId, const QString &token, const QString &title, qint64 startPrice,
+                               qint64 minIncrement, qint64 durationSeconds)
 {
+    QCborMap obj;
+    obj.insert(QStringLiteral("token"), token);
+    obj.insert(QStringLiteral("title"), title);
+    obj.insert(QStringLiteral("startPrice"), startPrice);
+    obj.insert(QStringLiteral("minIncrement"), minIncrement);
+    obj.insert(QStringLiteral("durationSeconds"), durationSeconds);
+
     Frame frame;
-    const QList<QByteArray> parts = headerLine.trimmed().split(';');
-    for (const QByteArray &part : parts) {
-        if (part.startsWith(kCmd)) {
-            frame.command = QString::fromUtf8(part.mid(strlen(kCmd)));
-        } else if (part.startsWith(kReq)) {
-            frame.requestId = part.mid(strlen(kReq)).toULongLong();
-        } else if (part.startsWith(kLen)) {
-            // payload length is validated by caller.
-        }
+    frame.command = QStringLiteral("CREATE_AUCTION");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makePlaceBidRequest(quint64 reqId, const QString &token, qint64 auctionId, qint64 amount)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("token"), token);
+    obj.insert(QStringLiteral("auctionId"), auctionId);
+    obj.insert(QStringLiteral("amount"), amount);
+
+    Frame frame;
+    frame.command = QStringLiteral("PLACE_BID");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makeGetAuctionRequest(quint64 reqId, qint64 auctionId)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("auctionId"), auctionId);
+
+    Frame frame;
+    frame.command = QStringLiteral("GET_AUCTION");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makeListAuctionsRequest(quint64 reqId, qint64 beforeId, int limit)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("beforeId"), beforeId);
+    obj.insert(QStringLiteral("limit"), limit);
+
+    Frame frame;
+    frame.command = QStringLiteral("LIST_AUCTIONS");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makeSubscribeRequest(quint64 reqId, qint64 auctionId)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("auctionId"), auctionId);
+
+    Frame frame;
+    frame.command = QStringLiteral("SUBSCRIBE");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makeUnsubscribeRequest(quint64 reqId, qint64 auctionId)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("auctionId"), auctionId);
+
+    Frame frame;
+    frame.command = QStringLiteral("UNSUBSCRIBE");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+Frame makeResumeRequest(quint64 reqId, const QString &token)
+{
+    QCborMap obj;
+    obj.insert(QStringLiteral("token"), token);
+
+    Frame frame;
+    frame.command = QStringLiteral("RESUME");
+    frame.requestId = reqId;
+    frame.payload = obj;
+    return frame;
+}
+
+PriceUpdate parsePriceUpdate(const Frame &frame)
+{
+    const QCborMap &obj = frame.payload;
+    PriceUpdate update;
+    update.auctionId = integerOf(obj.value(QStringLiteral("auctionId")));
+    update.currentPrice = integerOf(obj.value(QStringLiteral("currentPrice")));
+    update.leaderId = integerOf(obj.value(QStringLiteral("leaderId")));
+    update.bidCount = static_cast<int>(integerOf(obj.value(QStringLiteral("bidCount"))));
+    update.minimumBid = integerOf(obj.value(QStringLiteral("minimumBid")));
+    update.endsAtMs = integerOf(obj.value(QStringLiteral("endsAt")));
+    return update;
+}
+
+AuctionPage parseAuctionPage(const Frame &frame, qint64 beforeId)
+{
+    const QCborMap &obj = frame.payload;
+    const QCborArray rows = obj.value(QStringLiteral("auctions")).toArray();
+
+    AuctionPage page;
+    page.beforeId = beforeId;
+    page.nextBeforeId = integerOf(obj.value(QStringLiteral("nextBeforeId")));
+    page.auctions.reserve(rows.size());
+    for (const QCborValue &value : rows) {
+        const QCborMap row = value.toMap();
+        AuctionSummary auction;
+        auction.auctionId = integerOf(row.value(QStringLiteral("auctionId")));
+        auction.title = row.value(QStringLiteral("title")).toString();
+        auction.currentPrice = integerOf(row.value(QStringLiteral("currentPrice")));
+        auction.minimumBid = integerOf(row.value(QStringLiteral("minimumBid")));
+        auction.leaderId = integerOf(row.value(QStringLiteral("leaderId")));
+        auction.bidCount = static_cast<int>(integerOf(row.value(QStringLiteral("bidCount"))));
+        auction.endsAtMs = integerOf(row.value(QStringLiteral("endsAt")));
+        auction.open = row.value(QStringLiteral("status")).toString() != QLatin1String("closed");
+        page.auctions.append(auction);
     }
-    frame.payload = payload;
+    return page;
+}
+
+Frame parseFrame(const RawFrame &raw)
+{
+    Frame frame;
+    frame.requestId = raw.requestId;
+
+    if (raw.binary) {
+        const auto command = static_cast<BinaryProtocol::Command>(raw.commandId);
+        frame.command = QString::fromLatin1(BinaryProtocol::commandName(command));
+        frame.payload = QCborValue::fromCbor(raw.payload).toMap();
+        return frame;
+    }
+
+    frame.command = QString::fromUtf8(raw.command);
+    // Decoded now: raw.payload is a view only valid until the decoder's next append().
+    frame.payload = QCborMap::fromJsonObject(QJsonDocument::fromJson(raw.payload).object());
     return frame;
 }
 
 LoginResponse parseLoginResponse(const Frame &frame)
 {
     LoginResponse resp;
-    const QJsonDocument doc = QJsonDocument::fromJson(frame.payload);
-    if (!doc.isObject()) {
-        resp.message = QStringLiteral("Invalid JSON");
-        return resp;
-    }
-    const QJsonObject obj = doc.object();
+    const QCborMap &obj = frame.payload;
     if (frame.command == QLatin1String("LOGIN_OK")) {
         resp.success = true;
-        resp.userId = obj.value(QStringLiteral("userId")).toInt(-1);
+        resp.userId = static_cast<int>(integerOf(obj.value(QStringLiteral("userId")), -1));
         resp.username = obj.value(QStringLiteral("username")).toString();
         resp.token = obj.value(QStringLiteral("token")).toString();
     } else {
@@ -2,9 +2,12 @@
 #define PROTOCOL_H
 
 #include <QByteArray>
-#include <QJsonObject>
+#include <QCborMap>
+#include <QMetaType>
 #include <QString>
+#include <QVector>
 
+#include "FrameDecoder.h"
 #include "model/User.h"
 
 namespace Protocol {
@@ -13,7 +16,9 @@ struct Frame
 {
     QString command;
     quint64 requestId = 0;
-    QByteArray payload; // raw JSON utf-8
+    // Encoded as JSON or CBOR only when written, for whichever protocol the
+    // connection negotiated by then.
+    QCborMap payload;
 };
 
 struct LoginResponse
@@ -25,14 +30,67 @@ struct LoginResponse
     QString username;
 };
 
+// PRICE_UPDATE push, decoded off the UI thread.
+struct PriceUpdate
+{
+    qint64 auctionId = 0;
+    qint64 currentPrice = 0;
+    qint64 leaderId = 0;
+    int bidCount = 0;
+    qint64 minimumBid = 0;
+    qint64 endsAtMs = 0;
+};
+
+// One row of LIST_AUCTIONS.
+struct AuctionSummary
+{
+    qint64 auctionId = 0;
+    QString title;
+    qint64 currentPrice = 0;
+    qint64 minimumBid = 0;
+    qint64 leaderId = 0;
+    int bidCount = 0;
+    qint64 endsAtMs = 0;
+    bool open = true;
+};
+
+struct AuctionPage
+{
+    qint64 beforeId = 0;     // the cursor this page was requested with
+    qint64 nextBeforeId = 0; // cursor for the next page; 0 after the last one
+    QVector<AuctionSummary> auctions;
+};
+
+// Highest protocol version this client negotiates with HELLO.
+constexpr int kPreferredProtocolVersion = 2;
+
 QString buildHeader(const QString &command, quint64 reqId, quint64 payloadLen);
+// Serializes frame for the negotiated protocol version (1 = text, 2 = binary).
+QByteArray encodeFrame(const Frame &frame, int protocolVersion);
+// ordered = false lets the server answer requests as they complete; the
+// client must then match replies by request id.
+Frame makeHello(quint64 reqId, int protocolVersion, bool ordered = true);
 Frame makeLoginRequest(quint64 reqId, const QString &username, const QString &password);
 Frame makeRegisterRequest(quint64 reqId, const User &user);
 Frame makePing(quint64 reqId = 0);
+Frame makeCreateAuctionRequest(quint64 reqId, const QString &token, const QString &title, qint64 startPrice,
+                               qint64 minIncrement, qint64 durationSeconds);
+Frame makePlaceBidRequest(quint64 reqId, const QString &token, qint64 auctionId, qint64 amount);
+Frame makeGetAuctionRequest(quint64 reqId, qint64 auctionId);
+Frame makeSubscribeRequest(quint64 reqId, qint64 auctionId);
+Frame makeUnsubscribeRequest(quint64 reqId, qint64 auctionId);
+Frame makeResumeRequest(quint64 reqId, const QString &token);
+// beforeId = 0 asks for the newest auctions.
+Frame makeListAuctionsRequest(quint64 reqId, qint64 beforeId, int limit);
 
 LoginResponse parseLoginResponse(const Frame &frame);
-Frame parseFrame(const QByteArray &headerLine, const QByteArray &payload);
+PriceUpdate parsePriceUpdate(const Frame &frame);
+AuctionPage parseAuctionPage(const Frame &frame, qint64 beforeId);
+Frame parseFrame(const RawFrame &raw);
 
 } // namespace Protocol
 
+Q_DECLARE_METATYPE(Protocol::PriceUpdate)
+Q_DECLARE_METATYPE(Protocol::AuctionPage)
+
 #endif // PROTOCOL_H
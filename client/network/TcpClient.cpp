@@ -1,174 +1,616 @@
 #include "TcpClient.h"
 
+#include "AsyncLog.h"
+#include "BinaryProtocol.h"
+
 #include <QAbstractSocket>
 #include <QJsonDocument>
 #include <QHostAddress>
 #include <QDebug>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QThread>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kConnectTimeoutMs = 5000;
+constexpr int kBackoffBaseMs = 250;
+constexpr int kBackoffMaxMs = 30 * 1000;
+
+bool isFailure(const QString &command)
+{
+    return command.endsWith(QLatin1String("_FAIL")) || command == QLatin1String("ERROR");
+}
+
+// Safe to send twice, so re-sent on the next connection when the reply was lost.
+bool isReplayable(const QString &command)
+{
+    return command == QLatin1String("PING") || command == QLatin1String("GET_AUCTION")
+           || command == QLatin1String("SUBSCRIBE") || command == QLatin1String("UNSUBSCRIBE")
+           || command == QLatin1String("STATS") || command == QLatin1String("LIST_AUCTIONS");
+}
+
+qint64 auctionIdOf(const Protocol::Frame &frame)
+{
+    return frame.payload.value(QStringLiteral("auctionId")).toInteger();
+}
+
+const QString kTimedOutMessage = QStringLiteral("The server did not answer in time.");
+} // namespace
+
+QJsonObject TcpClient::Reply::payload() const
+{
+    return frame.payload.toJsonObject();
+}
 
 TcpClient::TcpClient(QObject *parent)
     : QObject(parent)
     , socket(new QTcpSocket(this))
+    , reconnectTimer(this)
+    , connectTimer(this)
+    , timeoutTimer(this)
+    , priceTimer(this)
 {
+    // Signals cross to the UI thread queued, so their argument types must be known.
+    qRegisterMetaType<Protocol::PriceUpdate>();
+    qRegisterMetaType<QVector<Protocol::PriceUpdate>>();
+    qRegisterMetaType<Protocol::AuctionPage>();
+
     connect(socket, &QTcpSocket::connected, this, &TcpClient::handleConnected);
     connect(socket, &QTcpSocket::disconnected, this, &TcpClient::handleDisconnected);
     connect(socket, &QTcpSocket::readyRead, this, &TcpClient::handleReadyRead);
     connect(socket, &QTcpSocket::errorOccurred, this, &TcpClient::handleError);
+
+    reconnectTimer.setSingleShot(true);
+    connect(&reconnectTimer, &QTimer::timeout, this, &TcpClient::startConnect);
+    connectTimer.setSingleShot(true);
+    connect(&connectTimer, &QTimer::timeout, this, &TcpClient::handleConnectTimeout);
+
+    clock.start();
+    timeoutTimer.setSingleShot(true);
+    connect(&timeoutTimer, &QTimer::timeout, this, &TcpClient::expireRequests);
+
+    priceTimer.setSingleShot(true);
+    priceTimer.setInterval(kPriceBatchMs);
+    connect(&priceTimer, &QTimer::timeout, this, &TcpClient::flushPriceUpdates);
 }
 
 void TcpClient::connectToServer(const QString &hostName, quint16 portNumber)
 {
     host = hostName;
     port = portNumber;
+    autoReconnect = true;
+    reconnectAttempt = 0;
+    startConnect();
+}
 
-    if (socket->state() == QAbstractSocket::ConnectedState ||
-        socket->state() == QAbstractSocket::ConnectingState) {
+void TcpClient::disconnectFromServer()
+{
+    autoReconnect = false;
+    reconnectTimer.stop();
+    if (socket->state() == QAbstractSocket::ConnectedState) {
+        socket->disconnectFromHost(); // handleDisconnected() fails what is pending
         return;
     }
+    socket->abort();
+    resetConnection();
+}
+
+QString TcpClient::sessionToken() const
+{
+    QMutexLocker locker(&tokenMutex);
+    return token;
+}
 
+void TcpClient::setToken(const QString &value)
+{
+    QMutexLocker locker(&tokenMutex);
+    token = value;
+}
+
+void TcpClient::startConnect()
+{
+    if (linkState != LinkState::Idle || host.isEmpty() || port == 0) {
+        return;
+    }
+    reconnectTimer.stop();
+    if (socket->state() != QAbstractSocket::UnconnectedState) {
+        socket->abort();
+    }
+    linkState = LinkState::Connecting;
     socket->connectToHost(host, port);
+    // An unreachable host can leave connectToHost() pending for minutes.
+    connectTimer.start(kConnectTimeoutMs);
 }
 
-bool TcpClient::isConnected() const
+void TcpClient::handleConnectTimeout()
 {
-    return socket->state() == QAbstractSocket::ConnectedState;
+    if (linkState != LinkState::Connecting) {
+        return;
+    }
+    AsyncLog::log(AsyncLog::Level::Info, "[CLIENT] connect attempt timed out");
+    socket->abort();
+    linkState = LinkState::Idle;
+    scheduleReconnect();
 }
 
-void TcpClient::sendLogin(const QString &email, const QString &password)
+void TcpClient::scheduleReconnect()
 {
-    const quint64 reqId = nextRequestId++;
-    auto frame = Protocol::makeLoginRequest(reqId, email, password);
-    sendFrame(frame, RequestType::Login);
+    if (!autoReconnect || linkState != LinkState::Idle || reconnectTimer.isActive()) {
+        return;
+    }
+    const int ceiling = qMin(kBackoffMaxMs, kBackoffBaseMs << qMin(reconnectAttempt, 10));
+    // Somewhere between half and all of the ceiling, so clients dropped by the
+    // same server restart do not all come back at the same instant.
+    const int delayMs = ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1);
+    ++reconnectAttempt;
+    AsyncLog::log(AsyncLog::Level::Info, "[CLIENT] reconnecting in %d ms (attempt %d)", delayMs, reconnectAttempt);
+    emit reconnecting(reconnectAttempt, delayMs);
+    reconnectTimer.start(delayMs);
 }
 
-void TcpClient::sendRegister(const User &user)
+quint64 TcpClient::request(Protocol::Frame frame, QObject *context, ReplyHandler handler, int timeoutMs)
 {
-    const quint64 reqId = nextRequestId++;
-    auto frame = Protocol::makeRegisterRequest(reqId, user);
-    sendFrame(frame, RequestType::Register);
+    PendingRequest pending;
+    pending.handler = std::move(handler);
+    pending.context = context;
+    pending.hasContext = context != nullptr;
+
+    frame.requestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+    const quint64 requestId = frame.requestId;
+    // Even on the network thread the request is queued, so the handler never
+    // runs inside request() and the id is known before any outcome.
+    auto enqueue = [this, frame = std::move(frame), pending = std::move(pending), timeoutMs]() mutable {
+        enqueueRequest(std::move(frame), std::move(pending), timeoutMs);
+    };
+    QMetaObject::invokeMethod(this, std::move(enqueue), Qt::QueuedConnection);
+    return requestId;
 }
 
-void TcpClient::sendPing()
+void TcpClient::send(Protocol::Frame frame, ReplyHandler handler)
 {
-    const quint64 reqId = nextRequestId++;
-    auto frame = Protocol::makePing(reqId);
-    sendFrame(frame, RequestType::Generic);
+    PendingRequest pending;
+    pending.handler = std::move(handler);
+    pending.context = this;
+    pending.hasContext = true;
+    frame.requestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+    enqueueRequest(std::move(frame), std::move(pending), kDefaultTimeoutMs);
 }
 
-void TcpClient::sendFrame(const Protocol::Frame &frame, RequestType type)
+void TcpClient::enqueueRequest(Protocol::Frame frame, PendingRequest pending, int timeoutMs)
 {
-    if (!ensureConnected()) {
-        emit errorOccurred(QStringLiteral("Not connected to server."));
+    const bool canQueue = autoReconnect && !host.isEmpty() && port != 0;
+    if (!canQueue || (linkState != LinkState::Ready && outbound.size() >= kMaxQueuedRequests)) {
+        emit errorOccurred(canQueue ? QStringLiteral("Too many requests waiting for the server.")
+                                    : QStringLiteral("Not connected to server."));
+        deliver(pending, Reply{Reply::Status::Disconnected, {}});
         return;
     }
 
-    const QString header = Protocol::buildHeader(frame.command, frame.requestId, frame.payload.size());
-    QByteArray data = header.toUtf8();
-    data.append(frame.payload);
+    const quint64 requestId = frame.requestId;
+    if (timeoutMs > 0) {
+        pending.deadlineMs = clock.elapsed() + timeoutMs;
+        deadlines.insert(pending.deadlineMs, requestId);
+        armTimeout();
+    }
+    pending.frame = std::move(frame);
+    pendingRequests.insert(requestId, std::move(pending));
 
-    qInfo() << "[CLIENT->SERVER]" << frame.command << "req" << frame.requestId << "len" << frame.payload.size();
+    if (linkState == LinkState::Ready) {
+        writeRequest(requestId);
+    } else {
+        outbound.enqueue(requestId); // written by finishNegotiation()
+    }
+}
 
-    const qint64 bytesWritten = socket->write(data);
-    if (bytesWritten == -1) {
-        emit errorOccurred(socket->errorString());
-        return;
+void TcpClient::cancel(quint64 requestId)
+{
+    // Queued behind the request() that created requestId, so it is never early.
+    QMetaObject::invokeMethod(this, [this, requestId]() {
+        finish(requestId, Reply{Reply::Status::Cancelled, {}});
+    }, Qt::QueuedConnection);
+}
+
+bool TcpClient::finish(quint64 requestId, const Reply &reply)
+{
+    const auto it = pendingRequests.find(requestId);
+    if (it == pendingRequests.end()) {
+        return false;
+    }
+    const PendingRequest pending = std::move(it.value());
+    pendingRequests.erase(it);
+    if (pending.deadlineMs > 0) {
+        deadlines.remove(pending.deadlineMs, requestId);
     }
+    // The handler may start new requests, so it runs after the bookkeeping.
+    deliver(pending, reply);
+    return true;
+}
 
-    pendingRequests.enqueue({frame.requestId, type});
+void TcpClient::failPending(const QList<quint64> &requestIds)
+{
+    for (const quint64 requestId : requestIds) {
+        finish(requestId, Reply{Reply::Status::Disconnected, {}});
+    }
 }
 
-bool TcpClient::ensureConnected()
+void TcpClient::deliver(const PendingRequest &pending, const Reply &reply)
 {
-    if (socket->state() == QAbstractSocket::ConnectedState) {
-        return true;
+    if (!pending.handler || (pending.hasContext && !pending.context)) {
+        return;
     }
+    if (!pending.hasContext || pending.context->thread() == QThread::currentThread()) {
+        pending.handler(reply);
+        return;
+    }
+    // Posted to the context's thread; Qt drops it if the context dies first.
+    QMetaObject::invokeMethod(pending.context.data(), [handler = pending.handler, reply]() { handler(reply); },
+                              Qt::QueuedConnection);
+}
 
-    if (host.isEmpty() || port == 0) {
-        return false;
+void TcpClient::expireRequests()
+{
+    const qint64 now = clock.elapsed();
+    while (!deadlines.isEmpty() && deadlines.firstKey() <= now) {
+        const quint64 requestId = deadlines.first();
+        deadlines.erase(deadlines.begin());
+        const auto it = pendingRequests.find(requestId);
+        if (it != pendingRequests.end()) {
+            it->deadlineMs = 0;
+            finish(requestId, Reply{Reply::Status::TimedOut, {}});
+        }
     }
+    armTimeout();
+}
 
-    socket->connectToHost(host, port);
-    socket->waitForConnected(1000);
-    return socket->state() == QAbstractSocket::ConnectedState;
+void TcpClient::armTimeout()
+{
+    if (deadlines.isEmpty()) {
+        timeoutTimer.stop();
+        return;
+    }
+    const qint64 wait = qMax<qint64>(0, deadlines.firstKey() - clock.elapsed());
+    if (!timeoutTimer.isActive() || timeoutTimer.remainingTime() > wait) {
+        timeoutTimer.start(static_cast<int>(wait));
+    }
 }
 
-void TcpClient::handleReadyRead()
+void TcpClient::sendLogin(const QString &email, const QString &password)
 {
-    buffer.append(socket->readAll());
+    send(Protocol::makeLoginRequest(0, email, password), [this](const Reply &reply) {
+        if (reply.status == Reply::Status::TimedOut) {
+            emit loginFinished(false, kTimedOutMessage);
+        }
+        if (!reply.answered()) {
+            return; // a lost connection is reported through errorOccurred / disconnected
+        }
+        const auto loginResp = Protocol::parseLoginResponse(reply.frame);
+        if (loginResp.success) {
+            setToken(loginResp.token);
+        }
+        emit loginFinished(loginResp.success,
+                           loginResp.message.isEmpty() ? QStringLiteral("Login OK") : loginResp.message);
+    });
+}
 
-    auto parseLen = [](const QByteArray &header) -> int {
-        const QList<QByteArray> parts = header.trimmed().split(';');
-        for (const QByteArray &p : parts) {
-            if (p.startsWith("LEN=")) {
-                bool ok = false;
-                int len = p.mid(4).toInt(&ok);
-                if (ok) return len;
-            }
+void TcpClient::sendRegister(const User &user)
+{
+    send(Protocol::makeRegisterRequest(0, user), [this](const Reply &reply) {
+        if (reply.status == Reply::Status::TimedOut) {
+            emit registerFinished(false, kTimedOutMessage);
         }
-        return 0;
-    };
+        if (!reply.answered()) {
+            return;
+        }
+        const QString message = reply.payload().value(QStringLiteral("message")).toString();
+        const bool success = reply.frame.command.toUpper() == QLatin1String("REGISTER_OK");
+        emit registerFinished(success,
+                              message.isEmpty()
+                                  ? (success ? QStringLiteral("Register OK") : QStringLiteral("Register failed"))
+                                  : message);
+    });
+}
 
-    while (true) {
-        if (currentHeader.isEmpty()) {
-            const int newlineIndex = buffer.indexOf('\n');
-            if (newlineIndex == -1) {
-                return; // wait for full header line
-            }
-            currentHeader = buffer.left(newlineIndex + 1);
-            buffer.remove(0, newlineIndex + 1);
-            expectedPayloadLen = parseLen(currentHeader);
+void TcpClient::sendPing()
+{
+    send(Protocol::makePing(0), [this](const Reply &reply) { emitMessage(reply); });
+}
+
+void TcpClient::subscribeAuction(qint64 auctionId)
+{
+    subscriptions.insert(auctionId);
+    send(Protocol::makeSubscribeRequest(0, auctionId), [this, auctionId](const Reply &reply) {
+        if (reply.ok()) {
+            // The snapshot carries the same fields as a push.
+            queuePriceUpdate(Protocol::parsePriceUpdate(reply.frame));
+        } else if (reply.status == Reply::Status::Failed) {
+            subscriptions.remove(auctionId);
+        }
+        emitMessage(reply);
+    });
+}
+
+void TcpClient::unsubscribeAuction(qint64 auctionId)
+{
+    subscriptions.remove(auctionId);
+    send(Protocol::makeUnsubscribeRequest(0, auctionId), [this](const Reply &reply) {
+        emitMessage(reply);
+    });
+}
+
+void TcpClient::listAuctions(qint64 beforeId, int limit)
+{
+    send(Protocol::makeListAuctionsRequest(0, beforeId, limit), [this, beforeId](const Reply &reply) {
+        if (reply.ok()) {
+            emit auctionPageReceived(Protocol::parseAuctionPage(reply.frame, beforeId));
+            return;
+        }
+        QString message = reply.payload().value(QStringLiteral("message")).toString();
+        if (message.isEmpty()) {
+            message = reply.status == Reply::Status::TimedOut ? kTimedOutMessage
+                                                              : QStringLiteral("Not connected to server.");
         }
+        emit auctionPageFailed(beforeId, message);
+    });
+}
+
+void TcpClient::emitMessage(const Reply &reply)
+{
+    if (reply.answered()) {
+        emit messageReceived(QString::fromUtf8(QJsonDocument(reply.payload()).toJson(QJsonDocument::Compact)));
+    } else if (reply.status == Reply::Status::TimedOut) {
+        emit errorOccurred(kTimedOutMessage);
+    }
+}
 
-        if (expectedPayloadLen > buffer.size()) {
-            return; // wait for full payload
+void TcpClient::restoreSession()
+{
+    if (!token.isEmpty()) {
+        send(Protocol::makeResumeRequest(0, token), [this, sent = token](const Reply &reply) {
+            if (reply.ok()) {
+                emit sessionResumed(reply.payload().value(QStringLiteral("username")).toString());
+            } else if (reply.payload().value(QStringLiteral("code")).toInt() == 401 && token == sent) {
+                setToken(QString());
+                emit sessionExpired();
+            }
+        });
+    }
+
+    // A SUBSCRIBE still waiting in the queue restores its auction by itself.
+    QSet<qint64> restore = subscriptions;
+    for (const quint64 requestId : std::as_const(outbound)) {
+        const auto it = pendingRequests.constFind(requestId);
+        if (it != pendingRequests.constEnd() && it->frame.command == QLatin1String("SUBSCRIBE")) {
+            restore.remove(auctionIdOf(it->frame));
         }
+    }
+    for (const qint64 auctionId : std::as_const(restore)) {
+        send(Protocol::makeSubscribeRequest(0, auctionId), [this, auctionId](const Reply &reply) {
+            if (reply.ok()) {
+                queuePriceUpdate(Protocol::parsePriceUpdate(reply.frame));
+                emit subscriptionRestored(auctionId, reply.payload());
+            } else if (reply.status == Reply::Status::Failed) {
+                subscriptions.remove(auctionId); // e.g. the auction is gone
+            }
+        });
+    }
+}
+
+void TcpClient::writeRequest(quint64 requestId)
+{
+    const auto it = pendingRequests.find(requestId);
+    if (it == pendingRequests.end()) {
+        return; // cancelled or timed out while it waited
+    }
+    it->written = true;
+    writeFrame(it->frame);
+}
+
+void TcpClient::writeFrame(const Protocol::Frame &frame)
+{
+    const QByteArray data = Protocol::encodeFrame(frame, protocolVersion);
+
+    // Checked first: toLatin1() allocates even when the trace is off.
+    if (AsyncLog::enabled(AsyncLog::Level::Debug)) {
+        AsyncLog::frame("[CLIENT->SERVER] %s req %d len %d", frame.command.toLatin1(),
+                        static_cast<qint64>(frame.requestId), data.size());
+    }
+
+    queueWrite(data);
+}
+
+void TcpClient::queueWrite(const QByteArray &data)
+{
+    outbox.append(data);
+    if (!flushScheduled) {
+        flushScheduled = true;
+        QMetaObject::invokeMethod(this, &TcpClient::flushOutbox, Qt::QueuedConnection);
+    }
+}
+
+void TcpClient::flushOutbox()
+{
+    flushScheduled = false;
+    if (outbox.isEmpty()) {
+        return;
+    }
+    const qint64 bytesWritten = socket->write(outbox);
+    outbox.clear();
+    if (bytesWritten == -1) {
+        emit errorOccurred(socket->errorString());
+    }
+}
+
+void TcpClient::finishNegotiation(const Protocol::Frame &reply)
+{
+    // Servers that predate HELLO answer HELLO_FAIL, which keeps us on text.
+    qint64 agreed = 1;
+    if (reply.command == QLatin1String("HELLO_OK")
+        && BinaryProtocol::toInt64(reply.payload.value(QStringLiteral("protocol")), agreed) && agreed >= 2) {
+        protocolVersion = 2;
+        decoder.setMode(FrameDecoder::Mode::Binary);
+    }
+    helloRequestId = 0;
+    linkState = LinkState::Ready;
+    reconnectAttempt = 0;
+    qInfo() << "[CLIENT] using protocol v" << protocolVersion;
+
+    // RESUME and the subscriptions go first, then whatever waited for the link.
+    restoreSession();
+    while (!outbound.isEmpty()) {
+        writeRequest(outbound.dequeue());
+    }
+}
+
+void TcpClient::handleReadyRead()
+{
+    decoder.append(socket->readAll());
 
-        QByteArray payload = buffer.left(expectedPayloadLen);
-        buffer.remove(0, expectedPayloadLen);
+    RawFrame raw;
+    FrameDecoder::Status status;
+    while ((status = decoder.next(raw)) == FrameDecoder::Status::Ready) {
+        Protocol::Frame frame = Protocol::parseFrame(raw);
+        if (AsyncLog::enabled(AsyncLog::Level::Debug)) {
+            AsyncLog::frame("[SERVER->CLIENT] %s req %d len %d", frame.command.toLatin1(),
+                            static_cast<qint64>(frame.requestId), raw.payload.size());
+        }
 
-        Protocol::Frame frame = Protocol::parseFrame(currentHeader, payload);
-        qInfo() << "[SERVER->CLIENT]" << frame.command << "req" << frame.requestId << "len" << frame.payload.size();
+        if (helloRequestId != 0 && frame.requestId == helloRequestId) {
+            finishNegotiation(frame);
+            continue;
+        }
 
-        RequestType type = RequestType::Generic;
-        if (!pendingRequests.isEmpty() && pendingRequests.head().first == frame.requestId) {
-            type = pendingRequests.dequeue().second;
+        if (frame.requestId == 0) {
+            if (frame.command == QLatin1String("SERVER_SHUTDOWN") && linkState == LinkState::Ready) {
+                // Requests already sent are still answered; new ones wait for
+                // the next server, which is usually up by the first retry.
+                qInfo() << "[CLIENT] server is shutting down";
+                linkState = LinkState::Draining;
+                reconnectAttempt = 0;
+            }
+            if (frame.command == QLatin1String("PRICE_UPDATE")) {
+                // Decoded here, delivered by flushPriceUpdates().
+                queuePriceUpdate(Protocol::parsePriceUpdate(frame));
+                continue;
+            }
+            emit pushReceived(frame.command, frame.payload.toJsonObject());
+            continue;
         }
 
-        if (type == RequestType::Login) {
-            const auto loginResp = Protocol::parseLoginResponse(frame);
-            emit loginFinished(loginResp.success,
-                               loginResp.message.isEmpty() ? QStringLiteral("Login OK") : loginResp.message);
-        } else if (type == RequestType::Register) {
-            const QJsonDocument doc = QJsonDocument::fromJson(frame.payload);
-            const QString message = doc.isObject()
-                                        ? doc.object().value(QStringLiteral("message")).toString()
-                                        : QString();
-            const bool success = frame.command.toUpper() == QLatin1String("REGISTER_OK");
-            emit registerFinished(success,
-                                  message.isEmpty()
-                                      ? (success ? QStringLiteral("Register OK") : QStringLiteral("Register failed"))
-                                      : message);
-        } else {
-            emit messageReceived(QString::fromUtf8(frame.payload));
+        const quint64 requestId = frame.requestId;
+        const Reply reply{isFailure(frame.command) ? Reply::Status::Failed : Reply::Status::Ok, std::move(frame)};
+        if (!finish(requestId, reply)) {
+            AsyncLog::log(AsyncLog::Level::Debug, "[CLIENT] dropped reply to request %d (timed out or cancelled)",
+                          static_cast<qint64>(requestId));
         }
+    }
 
-        currentHeader.clear();
-        expectedPayloadLen = -1;
+    if (status == FrameDecoder::Status::Malformed) {
+        qWarning() << "[CLIENT] malformed frame header from server, dropping connection";
+        decoder.clear();
+        socket->abort();
     }
 }
 
-void TcpClient::handleError(QAbstractSocket::SocketError)
+void TcpClient::queuePriceUpdate(const Protocol::PriceUpdate &update)
 {
-    emit errorOccurred(socket->errorString());
+    // In ordered mode a SUBSCRIBE_OK can trail pushes sent after it was built.
+    const auto it = pendingPrices.constFind(update.auctionId);
+    if (it != pendingPrices.constEnd() && it->bidCount > update.bidCount) {
+        return;
+    }
+    pendingPrices.insert(update.auctionId, update);
+    if (!priceTimer.isActive()) {
+        priceTimer.start();
+    }
+}
+
+void TcpClient::flushPriceUpdates()
+{
+    if (pendingPrices.isEmpty()) {
+        return;
+    }
+    QVector<Protocol::PriceUpdate> batch;
+    batch.reserve(pendingPrices.size());
+    for (const Protocol::PriceUpdate &update : std::as_const(pendingPrices)) {
+        batch.append(update);
+    }
+    pendingPrices.clear();
+    emit priceUpdates(batch);
+}
+
+void TcpClient::handleError(QAbstractSocket::SocketError socketError)
+{
+    if (linkState == LinkState::Connecting) {
+        // A failed attempt emits no disconnected(); only the first one is
+        // reported, the retries show up as reconnecting().
+        AsyncLog::log(AsyncLog::Level::Info, "[CLIENT] connect failed: %s", socket->errorString().toUtf8());
+        if (reconnectAttempt == 0) {
+            emit errorOccurred(socket->errorString());
+        }
+        connectTimer.stop();
+        linkState = LinkState::Idle;
+        scheduleReconnect();
+        return;
+    }
+    if (socketError != QAbstractSocket::RemoteHostClosedError) {
+        emit errorOccurred(socket->errorString());
+    }
 }
 
 void TcpClient::handleConnected()
 {
+    connectTimer.stop();
+    socketConnected.store(true, std::memory_order_relaxed);
     qInfo() << "[CLIENT] connected to" << host << ":" << port;
+
+    // HELLO always goes out as text; everything after it waits for the reply.
+    // Replies are matched by id, so the server need not keep them in order.
+    linkState = LinkState::Negotiating;
+    helloRequestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+    queueWrite(Protocol::encodeFrame(
+        Protocol::makeHello(helloRequestId, Protocol::kPreferredProtocolVersion, false), 1));
+
     emit connected();
 }
 
 void TcpClient::handleDisconnected()
 {
     qInfo() << "[CLIENT] disconnected";
+    resetConnection();
     emit disconnected();
+    scheduleReconnect();
+}
+
+void TcpClient::resetConnection()
+{
+    connectTimer.stop();
+    socketConnected.store(false, std::memory_order_relaxed);
+    linkState = LinkState::Idle;
+    decoder.clear();
+    protocolVersion = 1;
+    helloRequestId = 0;
+    outbox.clear();
+
+    // Unanswered idempotent requests go out again on the next connection, in
+    // their original order; anything else may or may not have taken effect.
+    QList<quint64> waiting;
+    QList<quint64> lost;
+    for (auto it = pendingRequests.begin(); it != pendingRequests.end(); ++it) {
+        if (!autoReconnect || (it->written && !isReplayable(it->frame.command))) {
+            lost.append(it.key());
+            continue;
+        }
+        it->written = false;
+        waiting.append(it.key());
+    }
+    std::sort(waiting.begin(), waiting.end());
+    std::sort(lost.begin(), lost.end());
+    outbound.clear();
+    for (const quint64 requestId : std::as_const(waiting)) {
+        outbound.enqueue(requestId);
+    }
+    failPending(lost);
 }
@@ -1,35 +1,126 @@
 #ifndef TCPCLIENT_H
 #define TCPCLIENT_H
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QMultiMap>
+#include <QMutex>
 #include <QObject>
+#include <QPointer>
 #include <QQueue>
+#include <QSet>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
 
 #include "model/User.h"
 #include "Protocol.h"
 
+// Keeps one connection to the server alive: reconnects with jittered
+// exponential backoff, buffers requests while the link is down, replays the
+// idempotent ones that were in flight when it dropped, and restores the login
+// token and auction subscriptions on every new connection.
+//
+// Meant to live on its own network thread (moveToThread()), so socket reads,
+// frame parsing and JSON decoding never run on the UI thread. Slots are
+// invoked through queued connections or QMetaObject::invokeMethod(); only
+// request(), cancel(), isConnected() and sessionToken() may be called directly
+// from another thread. Signals are emitted on the network thread.
 class TcpClient : public QObject
 {
     Q_OBJECT
 
 public:
+    // Outcome of one request(); the handler sees exactly one of these.
+    struct Reply
+    {
+        enum class Status
+        {
+            Ok,           // the server answered with a success verb
+            Failed,       // the server answered with *_FAIL or ERROR
+            TimedOut,     // no answer before the request's deadline
+            Cancelled,    // cancel() was called
+            Disconnected, // could not be sent, or lost with a connection
+        };
+
+        Status status = Status::Disconnected;
+        Protocol::Frame frame; // the server's answer when status is Ok or Failed
+
+        bool ok() const { return status == Status::Ok; }
+        bool answered() const { return status == Status::Ok || status == Status::Failed; }
+        QJsonObject payload() const;
+    };
+    using ReplyHandler = std::function<void(const Reply &reply)>;
+
+    static constexpr int kDefaultTimeoutMs = 10 * 1000;
+    // Requests that may wait for a connection; more fail straight away.
+    static constexpr int kMaxQueuedRequests = 256;
+    // PRICE_UPDATE pushes are coalesced for this long, about one UI frame.
+    static constexpr int kPriceBatchMs = 16;
+
     explicit TcpClient(QObject *parent = nullptr);
 
-    void connectToServer(const QString &hostName, quint16 portNumber);
-    bool isConnected() const;
+    bool isConnected() const { return socketConnected.load(std::memory_order_relaxed); }
+
+    // Thread-safe. Sends frame under a fresh request id and returns that id.
+    // While the link is down the frame waits (up to kMaxQueuedRequests) and
+    // goes out after the next handshake. handler runs once: with the reply,
+    // or on timeout (timeoutMs <= 0 waits forever), cancellation or a lost
+    // connection, including when the request could not be queued at all. It
+    // runs on context's thread, or on the network thread without a context,
+    // is never called from inside request(), and not at all once context has
+    // been destroyed. Replies are matched by id in any order.
+    quint64 request(Protocol::Frame frame, QObject *context, ReplyHandler handler,
+                    int timeoutMs = kDefaultTimeoutMs);
+    // Thread-safe. Completes requestId with Status::Cancelled unless it has
+    // already finished; a late reply is dropped.
+    void cancel(quint64 requestId);
+
+    // Thread-safe. Token from the last LOGIN_OK, resumed after each
+    // reconnect; empty when logged out or after the server refused it.
+    QString sessionToken() const;
 
 public slots:
+    // Connects and keeps reconnecting until disconnectFromServer().
+    void connectToServer(const QString &hostName, quint16 portNumber);
+    // Closes the connection for good; pending requests end as Disconnected.
+    void disconnectFromServer();
     void sendLogin(const QString &email, const QString &password);
     void sendRegister(const User &user);
     void sendPing();
+    // PRICE_UPDATE pushes for auctionId arrive on priceUpdates until
+    // unsubscribed, across reconnects.
+    void subscribeAuction(qint64 auctionId);
+    void unsubscribeAuction(qint64 auctionId);
+    // One LIST_AUCTIONS page, decoded here and delivered on auctionPageReceived.
+    void listAuctions(qint64 beforeId, int limit);
 
 signals:
     void connected();
     void disconnected();
+    // The next connection attempt starts in delayMs.
+    void reconnecting(int attempt, int delayMs);
     void errorOccurred(const QString &message);
     void loginFinished(bool success, const QString &message);
     void registerFinished(bool success, const QString &message);
     void messageReceived(const QString &message);
+    // Server-initiated frames (REQ=0) other than PRICE_UPDATE.
+    void pushReceived(const QString &command, const QJsonObject &payload);
+    // The newest price of every auction that changed since the last batch,
+    // at most once per kPriceBatchMs, so a bidding war costs the UI one
+    // queued call per frame instead of one per bid.
+    void priceUpdates(const QVector<Protocol::PriceUpdate> &updates);
+    void auctionPageReceived(const Protocol::AuctionPage &page);
+    void auctionPageFailed(qint64 beforeId, const QString &message);
+    // After a reconnect: the stored token still works / was refused.
+    void sessionResumed(const QString &username);
+    void sessionExpired();
+    // SUBSCRIBE_OK after a reconnect, with the auction as it is now.
+    void subscriptionRestored(qint64 auctionId, const QJsonObject &auction);
 
 private slots:
     void handleReadyRead();
@@ -38,19 +129,87 @@ private slots:
     void handleDisconnected();
 
 private:
-    enum class RequestType { Generic, Login, Register };
+    enum class LinkState
+    {
+        Idle,        // no socket; a reconnect may be scheduled
+        Connecting,  // connectToHost() issued
+        Negotiating, // HELLO sent, waiting for the reply
+        Ready,       // requests are written as they come
+        Draining,    // SERVER_SHUTDOWN received; requests wait for the next server
+    };
 
-    void sendFrame(const Protocol::Frame &frame, RequestType type);
-    bool ensureConnected();
+    struct PendingRequest
+    {
+        ReplyHandler handler;
+        QPointer<QObject> context;
+        bool hasContext = false;
+        qint64 deadlineMs = 0; // 0 = no timeout
+        Protocol::Frame frame;
+        bool written = false; // sent on the current connection
+    };
+
+    void startConnect();
+    void scheduleReconnect();
+    void handleConnectTimeout();
+    // Called whenever the link drops: requeues what can be replayed and fails the rest.
+    void resetConnection();
+    void restoreSession();
+    // request() for senders already on the network thread: no queued hop,
+    // so finishNegotiation() can put RESUME ahead of the outbound queue.
+    void send(Protocol::Frame frame, ReplyHandler handler);
+    // Network-thread half of request().
+    void enqueueRequest(Protocol::Frame frame, PendingRequest pending, int timeoutMs);
+    void writeRequest(quint64 requestId);
+    void writeFrame(const Protocol::Frame &frame);
+    // Frames sent in one event-loop pass leave in a single socket write.
+    void queueWrite(const QByteArray &data);
+    void flushOutbox();
+    void finishNegotiation(const Protocol::Frame &reply);
+    // Removes requestId from the pending set and runs its handler.
+    bool finish(quint64 requestId, const Reply &reply);
+    void failPending(const QList<quint64> &requestIds);
+    static void deliver(const PendingRequest &pending, const Reply &reply);
+    void expireRequests();
+    void armTimeout();
+    void emitMessage(const Reply &reply);
+    void setToken(const QString &value);
+    void flushPriceUpdates();
+    // Queues a PRICE_UPDATE or SUBSCRIBE_OK state unless a newer one (higher
+    // bidCount) is already waiting.
+    void queuePriceUpdate(const Protocol::PriceUpdate &update);
 
     QTcpSocket *socket;
+    std::atomic<bool> socketConnected{false};
     QString host;
     quint16 port = 0;
-    QQueue<std::pair<quint64, RequestType>> pendingRequests;
-    quint64 nextRequestId = 1;
-    QByteArray buffer;
-    QByteArray currentHeader;
-    int expectedPayloadLen = -1;
+    LinkState linkState = LinkState::Idle;
+    bool autoReconnect = false;
+    int reconnectAttempt = 0;
+    QTimer reconnectTimer;
+    QTimer connectTimer;
+
+    QHash<quint64, PendingRequest> pendingRequests;
+    // Ids waiting for a usable connection, oldest first.
+    QQueue<quint64> outbound;
+    // Deadline -> request id, earliest first; one timer covers them all.
+    QMultiMap<qint64, quint64> deadlines;
+    QTimer timeoutTimer;
+    QElapsedTimer clock;
+    std::atomic<quint64> nextRequestId{1};
+
+    mutable QMutex tokenMutex;
+    QString token; // written on the network thread only
+    QSet<qint64> subscriptions;
+
+    int protocolVersion = 1;
+    quint64 helloRequestId = 0;
+    FrameDecoder decoder;
+    QByteArray outbox;
+    bool flushScheduled = false;
+
+    // Latest PRICE_UPDATE per auction, waiting for priceTimer.
+    QHash<qint64, Protocol::PriceUpdate> pendingPrices;
+    QTimer priceTimer;
 };
 
 #endif // TCPCLIENT_H
@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "auctionspage.h"
 #include "loginpage.h"
 #include "network/TcpClient.h"
 #include "registerpage.h"
@@ -13,10 +14,16 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
     , loginPage(nullptr)
     , registerPage(nullptr)
-    , tcpClient(new TcpClient(this))
+    , auctionsPage(nullptr)
+    , tcpClient(new TcpClient)
 {
     ui->setupUi(this);
 
+    networkThread.setObjectName(QStringLiteral("network"));
+    tcpClient->moveToThread(&networkThread);
+    connect(&networkThread, &QThread::finished, tcpClient, &QObject::deleteLater);
+    networkThread.start();
+
     setupPages();
     setupNavigation();
     setupNetwork();
@@ -26,6 +33,9 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // The client is deleted on its own thread once the loop has stopped.
+    networkThread.quit();
+    networkThread.wait();
     delete ui;
 }
 
@@ -40,16 +50,20 @@ void MainWindow::setupPages()
 
     loginPage = new LoginPage(this);
     registerPage = new RegisterPage(this);
+    auctionsPage = new AuctionsPage(this);
     ui->stackedWidget->addWidget(loginPage);
     ui->stackedWidget->addWidget(registerPage);
+    ui->stackedWidget->addWidget(auctionsPage);
 
     connect(loginPage, &LoginPage::loginRequested, this, [this](const QString &email, const QString &password) {
-        tcpClient->sendLogin(email, password);
+        QMetaObject::invokeMethod(tcpClient, [client = tcpClient, email, password]() {
+            client->sendLogin(email, password);
+        });
     });
     connect(loginPage, &LoginPage::switchToRegisterRequested, this, &MainWindow::showRegisterPage);
 
     connect(registerPage, &RegisterPage::registerRequested, this, [this](const User &user) {
-        tcpClient->sendRegister(user);
+        QMetaObject::invokeMethod(tcpClient, [client = tcpClient, user]() { client->sendRegister(user); });
     });
     connect(registerPage, &RegisterPage::switchToLoginRequested, this, &MainWindow::showLoginPage);
 }
@@ -58,9 +72,11 @@ void MainWindow::setupNavigation()
 {
     ui->loginNavButton->setCheckable(true);
     ui->registerNavButton->setCheckable(true);
+    ui->auctionsNavButton->setCheckable(true);
 
     connect(ui->loginNavButton, &QPushButton::clicked, this, &MainWindow::showLoginPage);
     connect(ui->registerNavButton, &QPushButton::clicked, this, &MainWindow::showRegisterPage);
+    connect(ui->auctionsNavButton, &QPushButton::clicked, this, &MainWindow::showAuctionsPage);
 }
 
 void MainWindow::setupNetwork()
@@ -71,6 +87,14 @@ void MainWindow::setupNetwork()
     connect(tcpClient, &TcpClient::disconnected, this, [this]() {
         showStatus(tr("Disconnected from server"), 4000);
     });
+    connect(tcpClient, &TcpClient::reconnecting, this, [this](int attempt, int delayMs) {
+        showStatus(tr("Connection lost, retrying in %1 s (attempt %2)").arg(qMax(1, delayMs / 1000)).arg(attempt),
+                   delayMs);
+    });
+    connect(tcpClient, &TcpClient::sessionExpired, this, [this]() {
+        showStatus(tr("Session expired, please log in again"), 5000);
+        showLoginPage();
+    });
     connect(tcpClient, &TcpClient::errorOccurred, this, [this](const QString &message) {
         QMessageBox::warning(this, tr("Network error"), message);
         showStatus(message, 5000);
@@ -78,7 +102,17 @@ void MainWindow::setupNetwork()
     connect(tcpClient, &TcpClient::loginFinished, this, &MainWindow::handleLoginResult);
     connect(tcpClient, &TcpClient::registerFinished, this, &MainWindow::handleRegisterResult);
 
-    tcpClient->connectToServer(defaultHost, defaultPort);
+    // Cross-thread connections, so these are queued in both directions.
+    connect(auctionsPage, &AuctionsPage::fetchRequested, tcpClient, &TcpClient::listAuctions);
+    connect(auctionsPage, &AuctionsPage::watchRequested, tcpClient, &TcpClient::subscribeAuction);
+    connect(auctionsPage, &AuctionsPage::unwatchRequested, tcpClient, &TcpClient::unsubscribeAuction);
+    connect(tcpClient, &TcpClient::auctionPageReceived, auctionsPage, &AuctionsPage::handlePage);
+    connect(tcpClient, &TcpClient::auctionPageFailed, auctionsPage, &AuctionsPage::handlePageFailed);
+    connect(tcpClient, &TcpClient::priceUpdates, auctionsPage, &AuctionsPage::handlePriceUpdates);
+
+    QMetaObject::invokeMethod(tcpClient, [client = tcpClient, host = defaultHost, port = defaultPort]() {
+        client->connectToServer(host, port);
+    });
 }
 
 void MainWindow::showLoginPage()
@@ -86,6 +120,7 @@ void MainWindow::showLoginPage()
     ui->stackedWidget->setCurrentWidget(loginPage);
     ui->loginNavButton->setChecked(true);
     ui->registerNavButton->setChecked(false);
+    ui->auctionsNavButton->setChecked(false);
 }
 
 void MainWindow::showRegisterPage()
@@ -93,6 +128,15 @@ void MainWindow::showRegisterPage()
     ui->stackedWidget->setCurrentWidget(registerPage);
     ui->loginNavButton->setChecked(false);
     ui->registerNavButton->setChecked(true);
+    ui->auctionsNavButton->setChecked(false);
+}
+
+void MainWindow::showAuctionsPage()
+{
+    ui->stackedWidget->setCurrentWidget(auctionsPage);
+    ui->loginNavButton->setChecked(false);
+    ui->registerNavButton->setChecked(false);
+    ui->auctionsNavButton->setChecked(true);
 }
 
 void MainWindow::showStatus(const QString &message, int timeoutMs)
@@ -105,6 +149,7 @@ void MainWindow::handleLoginResult(bool success, const QString &message)
     if (success) {
         QMessageBox::information(this, tr("Login result"), message.isEmpty() ? tr("Login success.") : message);
         showStatus(tr("Logged in"), 3000);
+        showAuctionsPage();
     } else {
         QMessageBox::warning(this, tr("Login failed"), message.isEmpty() ? tr("Login failed.") : message);
     }
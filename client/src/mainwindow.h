@@ -3,6 +3,7 @@
 
 #include <QMainWindow>
 #include <QString>
+#include <QThread>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -10,6 +11,7 @@ class MainWindow;
 }
 QT_END_NAMESPACE
 
+class AuctionsPage;
 class LoginPage;
 class RegisterPage;
 class TcpClient;
@@ -26,13 +28,17 @@ private:
     Ui::MainWindow *ui;
     LoginPage *loginPage;
     RegisterPage *registerPage;
+    AuctionsPage *auctionsPage;
+    // Lives on networkThread; reached only through queued calls and signals.
     class TcpClient *tcpClient;
+    QThread networkThread;
 
     void setupPages();
     void setupNavigation();
     void setupNetwork();
     void showLoginPage();
     void showRegisterPage();
+    void showAuctionsPage();
     void showStatus(const QString &message, int timeoutMs = 3000);
     void handleLoginResult(bool success, const QString &message);
     void handleRegisterResult(bool success, const QString &message);
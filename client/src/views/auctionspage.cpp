@@ -0,0 +1,117 @@
+#include "auctionspage.h"
+#include "model/AuctionListModel.h"
+#include "ui_auctionspage.h"
+
+#include <QHeaderView>
+#include <QScrollBar>
+
+#include <utility>
+
+namespace {
+// Waits for scrolling to settle before changing subscriptions.
+constexpr int kWatchDelayMs = 150;
+} // namespace
+
+AuctionsPage::AuctionsPage(QWidget *parent)
+    : QWidget(parent)
+    , ui(new Ui::AuctionsPage)
+    , model(new AuctionListModel(this))
+    , watchTimer(this)
+{
+    ui->setupUi(this);
+
+    QTableView *table = ui->auctionTable;
+    table->setModel(model);
+
+    // Fixed, uniform row heights: the view never measures rows, so scrolling
+    // costs the same at row 50,000 as at row 50.
+    QHeaderView *rowHeader = table->verticalHeader();
+    rowHeader->setSectionResizeMode(QHeaderView::Fixed);
+    rowHeader->setDefaultSectionSize(fontMetrics().height() + 10);
+
+    // No ResizeToContents: that would scan every loaded row on each change.
+    QHeaderView *columnHeader = table->horizontalHeader();
+    columnHeader->setSectionResizeMode(QHeaderView::Interactive);
+    columnHeader->setSectionResizeMode(AuctionListModel::TitleColumn, QHeaderView::Stretch);
+    columnHeader->setSortIndicator(AuctionListModel::IdColumn, Qt::DescendingOrder);
+
+    watchTimer.setSingleShot(true);
+    watchTimer.setInterval(kWatchDelayMs);
+    connect(&watchTimer, &QTimer::timeout, this, &AuctionsPage::updateWatched);
+    const auto scheduleWatch = [this]() { watchTimer.start(); };
+    connect(table->verticalScrollBar(), &QScrollBar::valueChanged, this, scheduleWatch);
+    connect(model, &QAbstractItemModel::rowsInserted, this, scheduleWatch);
+    connect(model, &QAbstractItemModel::layoutChanged, this, scheduleWatch);
+    connect(model, &QAbstractItemModel::modelReset, this, scheduleWatch);
+
+    connect(model, &QAbstractItemModel::rowsInserted, this, &AuctionsPage::updateCount);
+    connect(model, &QAbstractItemModel::modelReset, this, &AuctionsPage::updateCount);
+
+    connect(model, &AuctionListModel::fetchRequested, this, &AuctionsPage::fetchRequested);
+    connect(ui->refreshButton, &QPushButton::clicked, this, &AuctionsPage::reload);
+}
+
+AuctionsPage::~AuctionsPage()
+{
+    delete ui;
+}
+
+void AuctionsPage::handlePage(const Protocol::AuctionPage &page)
+{
+    model->appendPage(page);
+    updateCount();
+}
+
+void AuctionsPage::handlePageFailed(qint64 beforeId, const QString &message)
+{
+    model->fetchFailed(beforeId);
+    ui->countLabel->setText(tr("Could not load auctions: %1").arg(message));
+}
+
+void AuctionsPage::handlePriceUpdates(const QVector<Protocol::PriceUpdate> &updates)
+{
+    model->applyPriceUpdates(updates);
+}
+
+void AuctionsPage::reload()
+{
+    model->reload();
+    ui->countLabel->setText(tr("Loading..."));
+    model->fetchMore(QModelIndex());
+}
+
+void AuctionsPage::updateWatched()
+{
+    QSet<qint64> wanted;
+    const QTableView *table = ui->auctionTable;
+    const int first = table->rowAt(0);
+    if (first >= 0) {
+        int last = table->rowAt(table->viewport()->height() - 1);
+        if (last < 0) {
+            last = model->rowCount() - 1;
+        }
+        last = qMin(last, first + kMaxWatched - 1);
+        for (int row = first; row <= last; ++row) {
+            wanted.insert(model->auctionIdAt(row));
+        }
+    }
+
+    for (const qint64 auctionId : std::as_const(watched)) {
+        if (!wanted.contains(auctionId)) {
+            emit unwatchRequested(auctionId);
+        }
+    }
+    for (const qint64 auctionId : std::as_const(wanted)) {
+        if (!watched.contains(auctionId)) {
+            emit watchRequested(auctionId);
+        }
+    }
+    watched = wanted;
+}
+
+void AuctionsPage::updateCount()
+{
+    const int count = model->rowCount();
+    ui->countLabel->setText(model->isComplete() ? tr("%n auction(s)", nullptr, count)
+                                                : tr("%n auction(s) loaded, scroll for more", nullptr, count));
+}
@@ -0,0 +1,51 @@
+#ifndef AUCTIONSPAGE_H
+#define AUCTIONSPAGE_H
+
+#include <QSet>
+#include <QTimer>
+#include <QWidget>
+
+#include "network/Protocol.h"
+
+namespace Ui {
+class AuctionsPage;
+}
+
+class AuctionListModel;
+
+// Live auction list. Rows arrive page by page from the model's fetchMore();
+// the auctions on screen are kept subscribed so their prices stay current.
+class AuctionsPage : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Most auctions watched at once, well under the server's 256 per connection.
+    static constexpr int kMaxWatched = 100;
+
+    explicit AuctionsPage(QWidget *parent = nullptr);
+    ~AuctionsPage();
+
+public slots:
+    void handlePage(const Protocol::AuctionPage &page);
+    void handlePageFailed(qint64 beforeId, const QString &message);
+    void handlePriceUpdates(const QVector<Protocol::PriceUpdate> &updates);
+
+signals:
+    void fetchRequested(qint64 beforeId, int limit);
+    void watchRequested(qint64 auctionId);
+    void unwatchRequested(qint64 auctionId);
+
+private:
+    void reload();
+    // Subscribes the visible rows and drops the ones scrolled away.
+    void updateWatched();
+    void updateCount();
+
+    Ui::AuctionsPage *ui;
+    AuctionListModel *model;
+    QSet<qint64> watched;
+    QTimer watchTimer;
+};
+
+#endif // AUCTIONSPAGE_H
@@ -0,0 +1,225 @@
+#include "AsyncLog.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QTimeZone>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+constexpr int kTextBytes = 22;
+constexpr quint64 kRingRecords = 4096;
+constexpr int kDrainIntervalMs = 5;
+
+struct Record
+{
+    qint64 timeNs;
+    const char *format;
+    qint64 args[3];
+    quint8 level;
+    quint8 textLength;
+    char text[kTextBytes];
+};
+static_assert(sizeof(Record) == 64, "one record per cache line");
+
+// Single producer (the owning thread), single consumer (the drain thread).
+struct Ring
+{
+    std::atomic<quint64> head{0};
+    std::atomic<quint64> tail{0};
+    std::atomic<quint64> dropped{0};
+    Record records[kRingRecords];
+};
+
+// Rings live for the whole process so a thread's cached pointer never dangles,
+// even across stop() / start().
+QMutex ringsMutex;
+std::vector<std::unique_ptr<Ring>> rings;
+thread_local Ring *localRing = nullptr;
+
+std::atomic<bool> running{false};
+QThread *drainThread = nullptr;
+std::FILE *output = nullptr;
+
+const char *levelName(quint8 level)
+{
+    static const char *const names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+    return level < 5 ? names[level] : "?";
+}
+
+Ring *ringForThisThread()
+{
+    if (!localRing) {
+        auto ring = std::make_unique<Ring>();
+        localRing = ring.get();
+        QMutexLocker locker(&ringsMutex);
+        rings.push_back(std::move(ring));
+    }
+    return localRing;
+}
+
+void formatRecord(const Record &record, QByteArray &line)
+{
+    const qint64 ms = record.timeNs / 1000000;
+    line += QDateTime::fromMSecsSinceEpoch(ms, QTimeZone::utc()).toString(Qt::ISODateWithMs).toLatin1();
+    line += ' ';
+    line += levelName(record.level);
+    line += ' ';
+
+    int nextArg = 0;
+    for (const char *p = record.format; *p; ++p) {
+        if (p[0] == '%' && p[1] == 's') {
+            line.append(record.text, record.textLength);
+            ++p;
+        } else if (p[0] == '%' && p[1] == 'd') {
+            line += QByteArray::number(nextArg < 3 ? record.args[nextArg] : 0);
+            ++nextArg;
+            ++p;
+        } else {
+            line += *p;
+        }
+    }
+    line += '\n';
+}
+
+// Called by the drain thread and by flush(); ringsMutex makes them take turns
+// as the single consumer, and keeps their output in order.
+void drainOnce()
+{
+    QByteArray out;
+    quint64 dropped = 0;
+    QMutexLocker locker(&ringsMutex);
+    for (const auto &ring : rings) {
+        const quint64 tail = ring->tail.load(std::memory_order_relaxed);
+        const quint64 head = ring->head.load(std::memory_order_acquire);
+        for (quint64 i = tail; i != head; ++i) {
+            formatRecord(ring->records[i % kRingRecords], out);
+        }
+        ring->tail.store(head, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    if (dropped > 0) {
+        out += "[LOG] dropped " + QByteArray::number(dropped) + " record(s), rings full\n";
+    }
+    if (!out.isEmpty() && output) {
+        std::fwrite(out.constData(), 1, static_cast<size_t>(out.size()), output);
+        std::fflush(output);
+    }
+}
+
+std::atomic<quint64> totalDropped{0};
+} // namespace
+
+namespace AsyncLog {
+
+bool start(const QString &path)
+{
+    if (running.load()) {
+        return true;
+    }
+    output = path.isEmpty() ? stdout : std::fopen(QFile::encodeName(path).constData(), "a");
+    if (!output) {
+        return false;
+    }
+
+    running.store(true);
+    drainThread = QThread::create([]() {
+        while (running.load(std::memory_order_relaxed)) {
+            drainOnce();
+            QThread::msleep(kDrainIntervalMs);
+        }
+        drainOnce();
+    });
+    drainThread->setObjectName(QStringLiteral("log-drain"));
+    drainThread->start();
+    return true;
+}
+
+void flush()
+{
+    if (running.load()) {
+        drainOnce();
+    }
+}
+
+void stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    drainThread->wait();
+    delete drainThread;
+    drainThread = nullptr;
+    if (output && output != stdout) {
+        std::fclose(output);
+    }
+    output = nullptr;
+}
+
+void setLevel(Level level)
+{
+    detail::minLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+Level level()
+{
+    return static_cast<Level>(detail::minLevel.load(std::memory_order_relaxed));
+}
+
+bool parseLevel(const QString &name, Level &level)
+{
+    static const char *const names[] = {"trace", "debug", "info", "warning", "error", "off"};
+    for (int i = 0; i <= static_cast<int>(Level::Off); ++i) {
+        if (name.compare(QLatin1String(names[i]), Qt::CaseInsensitive) == 0) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void setFrameSampling(quint32 every)
+{
+    detail::frameSampleEvery.store(qMax<quint32>(1, every), std::memory_order_relaxed);
+}
+
+quint64 droppedRecords()
+{
+    return totalDropped.load(std::memory_order_relaxed);
+}
+
+void write(Level level, const char *format, const char *text, int textLength, qint64 a, qint64 b, qint64 c)
+{
+    if (!running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Ring *ring = ringForThisThread();
+    const quint64 head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRingRecords) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        totalDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record &record = ring->records[head % kRingRecords];
+    record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.format = format;
+    record.args[0] = a;
+    record.args[1] = b;
+    record.args[2] = c;
+    record.level = static_cast<quint8>(level);
+    record.textLength = static_cast<quint8>(qBound(0, textLength, kTextBytes));
+    if (record.textLength > 0) {
+        std::memcpy(record.text, text, record.textLength);
+    }
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+} // namespace AsyncLog
@@ -0,0 +1,87 @@
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+
+// Asynchronous logger for hot paths. A log call copies a fixed-size binary
+// record (format pointer, up to three integers and a short string) into a
+// ring owned by the calling thread, without locks or formatting. A background
+// thread drains every ring and formats lines to stdout or a file. When a ring
+// is full, new records are dropped and counted rather than blocking the caller.
+//
+// Formats must be string literals: only the pointer is stored. "%s" stands for
+// the text argument (cut to 22 bytes), "%d" for the next integer.
+namespace AsyncLog {
+
+enum class Level : int
+{
+    Trace = 0,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off,
+};
+
+namespace detail {
+inline std::atomic<int> minLevel{static_cast<int>(Level::Info)};
+inline std::atomic<quint32> frameSampleEvery{1};
+inline thread_local quint32 frameCounter = 0;
+} // namespace detail
+
+// Starts the drain thread; an empty path logs to stdout. Records written
+// before start() are discarded.
+bool start(const QString &path = QString());
+// Drains what is left and stops the drain thread.
+void stop();
+// Writes out every record logged so far, on the calling thread.
+void flush();
+
+void setLevel(Level level);
+Level level();
+bool parseLevel(const QString &name, Level &level);
+// Keeps one per-frame trace in every `every` on each thread.
+void setFrameSampling(quint32 every);
+// Records lost to full rings since start.
+quint64 droppedRecords();
+
+void write(Level level, const char *format, const char *text, int textLength, qint64 a, qint64 b, qint64 c);
+
+inline bool enabled(Level level)
+{
+    return static_cast<int>(level) >= detail::minLevel.load(std::memory_order_relaxed);
+}
+
+inline void log(Level level, const char *format, qint64 a = 0, qint64 b = 0, qint64 c = 0)
+{
+    if (enabled(level)) {
+        write(level, format, nullptr, 0, a, b, c);
+    }
+}
+
+inline void log(Level level, const char *format, const QByteArray &text, qint64 a = 0, qint64 b = 0, qint64 c = 0)
+{
+    if (enabled(level)) {
+        write(level, format, text.constData(), static_cast<int>(text.size()), a, b, c);
+    }
+}
+
+// Per-frame trace at Debug level, subject to frame sampling.
+inline void frame(const char *format, const QByteArray &command, qint64 requestId, qint64 bytes)
+{
+    if (!enabled(Level::Debug)) {
+        return;
+    }
+    const quint32 every = detail::frameSampleEvery.load(std::memory_order_relaxed);
+    if (every > 1 && ++detail::frameCounter % every != 0) {
+        return;
+    }
+    write(Level::Debug, format, command.constData(), static_cast<int>(command.size()), requestId, bytes, 0);
+}
+
+} // namespace AsyncLog
+
+#endif // ASYNCLOG_H
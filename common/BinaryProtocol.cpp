@@ -0,0 +1,150 @@
+#include "BinaryProtocol.h"
+
+#include <QHash>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+struct CommandEntry
+{
+    BinaryProtocol::Command command;
+    const char *name;
+};
+
+using BinaryProtocol::Command;
+
+const CommandEntry kCommands[] = {
+    {Command::Error, "ERROR"},
+    {Command::Hello, "HELLO"},
+    {Command::HelloOk, "HELLO_OK"},
+    {Command::HelloFail, "HELLO_FAIL"},
+    {Command::Ping, "PING"},
+    {Command::Pong, "PONG"},
+    {Command::PingFail, "PING_FAIL"},
+    {Command::Login, "LOGIN"},
+    {Command::LoginOk, "LOGIN_OK"},
+    {Command::LoginFail, "LOGIN_FAIL"},
+    {Command::Register, "REGISTER"},
+    {Command::RegisterOk, "REGISTER_OK"},
+    {Command::RegisterFail, "REGISTER_FAIL"},
+    {Command::Logout, "LOGOUT"},
+    {Command::LogoutOk, "LOGOUT_OK"},
+    {Command::LogoutFail, "LOGOUT_FAIL"},
+    {Command::CreateAuction, "CREATE_AUCTION"},
+    {Command::CreateAuctionOk, "CREATE_AUCTION_OK"},
+    {Command::CreateAuctionFail, "CREATE_AUCTION_FAIL"},
+    {Command::PlaceBid, "PLACE_BID"},
+    {Command::PlaceBidOk, "PLACE_BID_OK"},
+    {Command::PlaceBidFail, "PLACE_BID_FAIL"},
+    {Command::GetAuction, "GET_AUCTION"},
+    {Command::GetAuctionOk, "GET_AUCTION_OK"},
+    {Command::GetAuctionFail, "GET_AUCTION_FAIL"},
+    {Command::Subscribe, "SUBSCRIBE"},
+    {Command::SubscribeOk, "SUBSCRIBE_OK"},
+    {Command::SubscribeFail, "SUBSCRIBE_FAIL"},
+    {Command::Unsubscribe, "UNSUBSCRIBE"},
+    {Command::UnsubscribeOk, "UNSUBSCRIBE_OK"},
+    {Command::UnsubscribeFail, "UNSUBSCRIBE_FAIL"},
+    {Command::PriceUpdate, "PRICE_UPDATE"},
+    {Command::Stats, "STATS"},
+    {Command::StatsOk, "STATS_OK"},
+    {Command::StatsFail, "STATS_FAIL"},
+    {Command::ServerShutdown, "SERVER_SHUTDOWN"},
+    {Command::Resume, "RESUME"},
+    {Command::ResumeOk, "RESUME_OK"},
+    {Command::ResumeFail, "RESUME_FAIL"},
+    {Command::ListAuctions, "LIST_AUCTIONS"},
+    {Command::ListAuctionsOk, "LIST_AUCTIONS_OK"},
+    {Command::ListAuctionsFail, "LIST_AUCTIONS_FAIL"},
+    {Command::SearchAuctions, "SEARCH_AUCTIONS"},
+    {Command::SearchAuctionsOk, "SEARCH_AUCTIONS_OK"},
+    {Command::SearchAuctionsFail, "SEARCH_AUCTIONS_FAIL"},
+};
+
+const QHash<QByteArray, Command> &commandsByName()
+{
+    static const QHash<QByteArray, Command> table = []() {
+        QHash<QByteArray, Command> byName;
+        for (const CommandEntry &entry : kCommands) {
+            byName.insert(QByteArray(entry.name), entry.command);
+        }
+        return byName;
+    }();
+    return table;
+}
+
+const QHash<quint16, QByteArray> &namesByCommand()
+{
+    static const QHash<quint16, QByteArray> table = []() {
+        QHash<quint16, QByteArray> byId;
+        for (const CommandEntry &entry : kCommands) {
+            byId.insert(static_cast<quint16>(entry.command), QByteArray(entry.name));
+        }
+        return byId;
+    }();
+    return table;
+}
+} // namespace
+
+namespace BinaryProtocol {
+
+Command commandFromName(const QByteArray &name)
+{
+    return commandsByName().value(name, Command::Unknown);
+}
+
+QByteArray commandName(Command command)
+{
+    return namesByCommand().value(static_cast<quint16>(command));
+}
+
+void writeHeader(char *out, Command command, quint64 requestId, quint32 payloadLength)
+{
+    out[0] = static_cast<char>(kMagic);
+    out[1] = static_cast<char>(kVersion);
+    qToBigEndian<quint16>(static_cast<quint16>(command), out + 2);
+    qToBigEndian<quint64>(requestId, out + 4);
+    qToBigEndian<quint32>(payloadLength, out + 12);
+}
+
+bool readHeader(const char *in, quint16 &command, quint64 &requestId, quint32 &payloadLength)
+{
+    if (static_cast<quint8>(in[0]) != kMagic || static_cast<quint8>(in[1]) != kVersion) {
+        return false;
+    }
+    command = qFromBigEndian<quint16>(in + 2);
+    requestId = qFromBigEndian<quint64>(in + 4);
+    payloadLength = qFromBigEndian<quint32>(in + 12);
+    return true;
+}
+
+QByteArray encodeFrame(Command command, quint64 requestId, const QByteArray &payload)
+{
+    QByteArray out(kHeaderBytes + payload.size(), Qt::Uninitialized);
+    writeHeader(out.data(), command, requestId, static_cast<quint32>(payload.size()));
+    std::memcpy(out.data() + kHeaderBytes, payload.constData(), static_cast<size_t>(payload.size()));
+    return out;
+}
+
+bool toInt64(const QCborValue &value, qint64 &out)
+{
+    if (value.isInteger()) {
+        out = value.toInteger();
+        return true;
+    }
+    if (!value.isDouble()) {
+        return false;
+    }
+    // -2^63 and 2^63 are exact doubles; every integral double in between fits.
+    constexpr double kLimit = 9223372036854775808.0;
+    const double number = value.toDouble();
+    if (!std::isfinite(number) || number < -kLimit || number >= kLimit || std::trunc(number) != number) {
+        return false;
+    }
+    out = static_cast<qint64>(number);
+    return true;
+}
+
+} // namespace BinaryProtocol
@@ -0,0 +1,104 @@
+#ifndef BINARYPROTOCOL_H
+#define BINARYPROTOCOL_H
+
+#include <QByteArray>
+#include <QCborValue>
+
+// Protocol v2: a fixed 16-byte big-endian header followed by a CBOR payload.
+//
+//   offset 0  u8   magic (0xA5)
+//   offset 1  u8   version (2)
+//   offset 2  u16  command id
+//   offset 4  u64  request id (0 = server push)
+//   offset 12 u32  payload length in bytes
+//
+// A connection starts in the text protocol; v2 is only used after a HELLO /
+// HELLO_OK exchange agreed on it (see common/protocol.txt).
+namespace BinaryProtocol {
+
+constexpr quint8 kMagic = 0xA5;
+constexpr quint8 kVersion = 2;
+constexpr int kHeaderBytes = 16;
+
+// Wire ids; values are part of the protocol and must never be renumbered.
+// A request verb N answers with N + 1 on success and N + 2 on failure.
+enum class Command : quint16
+{
+    Unknown = 0,
+    Error = 1,
+    Hello = 2,
+    HelloOk = 3,
+    HelloFail = 4,
+    Ping = 10,
+    Pong = 11,
+    PingFail = 12,
+    Login = 20,
+    LoginOk = 21,
+    LoginFail = 22,
+    Register = 30,
+    RegisterOk = 31,
+    RegisterFail = 32,
+    Logout = 40,
+    LogoutOk = 41,
+    LogoutFail = 42,
+    CreateAuction = 50,
+    CreateAuctionOk = 51,
+    CreateAuctionFail = 52,
+    PlaceBid = 60,
+    PlaceBidOk = 61,
+    PlaceBidFail = 62,
+    GetAuction = 70,
+    GetAuctionOk = 71,
+    GetAuctionFail = 72,
+    Subscribe = 80,
+    SubscribeOk = 81,
+    SubscribeFail = 82,
+    Unsubscribe = 90,
+    UnsubscribeOk = 91,
+    UnsubscribeFail = 92,
+    PriceUpdate = 100, // push only, REQ=0
+    Stats = 110,
+    StatsOk = 111,
+    StatsFail = 112,
+    ServerShutdown = 120, // push only, REQ=0
+    Resume = 130,
+    ResumeOk = 131,
+    ResumeFail = 132,
+    ListAuctions = 140,
+    ListAuctionsOk = 141,
+    ListAuctionsFail = 142,
+    SearchAuctions = 150,
+    SearchAuctionsOk = 151,
+    SearchAuctionsFail = 152,
+};
+
+constexpr Command okReply(Command request)
+{
+    return static_cast<Command>(static_cast<quint16>(request) + 1);
+}
+
+constexpr Command failReply(Command request)
+{
+    return static_cast<Command>(static_cast<quint16>(request) + 2);
+}
+
+// Exact, case-sensitive lookup; Unknown for names without a wire id.
+Command commandFromName(const QByteArray &name);
+// Text-protocol name, e.g. "LOGIN_OK"; empty for Unknown.
+QByteArray commandName(Command command);
+
+void writeHeader(char *out, Command command, quint64 requestId, quint32 payloadLength);
+// Returns false if the magic byte or version does not match.
+bool readHeader(const char *in, quint16 &command, quint64 &requestId, quint32 &payloadLength);
+
+QByteArray encodeFrame(Command command, quint64 requestId, const QByteArray &payload);
+
+// Reads an integer payload field of either protocol: CBOR integers, or JSON
+// numbers that arrive as doubles. False for any other type and for NaN,
+// infinities, fractions and values outside qint64, which a plain cast from
+// double would turn into undefined behaviour.
+bool toInt64(const QCborValue &value, qint64 &out);
+
+} // namespace BinaryProtocol
+
+#endif // BINARYPROTOCOL_H
@@ -0,0 +1,165 @@
+#include "FrameDecoder.h"
+
+#include "BinaryProtocol.h"
+
+#include <cstring>
+#include <limits>
+
+namespace {
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses an unsigned decimal; returns false on empty input, junk or overflow.
+bool parseUnsigned(const char *begin, const char *end, quint64 max, quint64 &value)
+{
+    if (begin == end) {
+        return false;
+    }
+    quint64 result = 0;
+    for (const char *p = begin; p < end; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        const quint64 digit = static_cast<quint64>(*p - '0');
+        if (result > (max - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+} // namespace
+
+void FrameDecoder::append(const QByteArray &data)
+{
+    // Views handed out by next() die here, so this is the one place the
+    // consumed prefix is dropped.
+    if (readPos > 0) {
+        buffer.remove(0, readPos);
+        readPos = 0;
+    }
+    buffer.append(data);
+}
+
+void FrameDecoder::setMode(Mode newMode)
+{
+    decodeMode = newMode;
+    scanPos = 0;
+    headerReady = false;
+}
+
+FrameDecoder::Status FrameDecoder::next(RawFrame &frame)
+{
+    if (!headerReady) {
+        const Status status = decodeMode == Mode::Binary ? readBinaryHeader() : readTextHeader();
+        if (status != Status::Ready) {
+            return status;
+        }
+        headerReady = true;
+    }
+
+    if (static_cast<qint64>(headerBytes) + payloadLength > buffer.size() - readPos) {
+        return Status::NeedMore;
+    }
+
+    const char *frameStart = buffer.constData() + readPos;
+    frame.binary = decodeMode == Mode::Binary;
+    frame.command = QByteArray::fromRawData(frameStart + commandOffset, commandLength);
+    frame.commandId = commandId;
+    frame.requestId = requestId;
+    frame.payload = QByteArray::fromRawData(frameStart + headerBytes, payloadLength);
+
+    readPos += headerBytes + payloadLength;
+    scanPos = 0;
+    headerReady = false;
+    return Status::Ready;
+}
+
+FrameDecoder::Status FrameDecoder::readTextHeader()
+{
+    const int available = buffer.size() - readPos;
+    const char *begin = buffer.constData() + readPos;
+    const void *newline = std::memchr(begin + scanPos, '\n', static_cast<size_t>(available - scanPos));
+    if (!newline) {
+        scanPos = available;
+        return available > kMaxHeaderBytes ? Status::Malformed : Status::NeedMore;
+    }
+    const char *lineEnd = static_cast<const char *>(newline);
+    if (!parseHeader(begin, lineEnd)) {
+        return Status::Malformed;
+    }
+    headerBytes = static_cast<int>(lineEnd - begin) + 1;
+    commandId = 0;
+    return Status::Ready;
+}
+
+FrameDecoder::Status FrameDecoder::readBinaryHeader()
+{
+    if (buffer.size() - readPos < BinaryProtocol::kHeaderBytes) {
+        return Status::NeedMore;
+    }
+    quint32 length = 0;
+    if (!BinaryProtocol::readHeader(buffer.constData() + readPos, commandId, requestId, length)
+        || length > static_cast<quint32>(std::numeric_limits<int>::max() - BinaryProtocol::kHeaderBytes)) {
+        return Status::Malformed;
+    }
+    headerBytes = BinaryProtocol::kHeaderBytes;
+    payloadLength = static_cast<int>(length);
+    commandOffset = 0;
+    commandLength = 0;
+    return Status::Ready;
+}
+
+void FrameDecoder::clear()
+{
+    buffer.clear();
+    decodeMode = Mode::Text;
+    readPos = 0;
+    scanPos = 0;
+    headerReady = false;
+}
+
+bool FrameDecoder::parseHeader(const char *begin, const char *end)
+{
+    const char *frameStart = begin;
+    while (begin < end && isSpace(*begin)) {
+        ++begin;
+    }
+    while (end > begin && isSpace(*(end - 1))) {
+        --end;
+    }
+
+    commandOffset = 0;
+    commandLength = 0;
+    requestId = 0;
+    payloadLength = 0;
+
+    const char *field = begin;
+    while (field < end) {
+        const void *separator = std::memchr(field, ';', static_cast<size_t>(end - field));
+        const char *fieldEnd = separator ? static_cast<const char *>(separator) : end;
+        const char *value = field + 4;
+
+        if (fieldEnd - field >= 4 && field[3] == '=') {
+            if (std::memcmp(field, "CMD", 3) == 0) {
+                commandOffset = static_cast<int>(value - frameStart);
+                commandLength = static_cast<int>(fieldEnd - value);
+            } else if (std::memcmp(field, "REQ", 3) == 0) {
+                quint64 id = 0;
+                // A garbled REQ degrades to 0 like the old toULongLong() parser did.
+                requestId = parseUnsigned(value, fieldEnd, std::numeric_limits<quint64>::max(), id) ? id : 0;
+            } else if (std::memcmp(field, "LEN", 3) == 0) {
+                quint64 len = 0;
+                if (!parseUnsigned(value, fieldEnd, std::numeric_limits<int>::max(), len)) {
+                    return false;
+                }
+                payloadLength = static_cast<int>(len);
+            }
+        }
+        field = fieldEnd + 1;
+    }
+    return true;
+}
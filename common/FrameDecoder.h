@@ -0,0 +1,62 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QByteArray>
+
+// A decoded frame whose command and payload are views into the decoder's
+// buffer. They stay valid until the next append() or clear() on the decoder,
+// so copy anything that has to outlive the current read.
+struct RawFrame
+{
+    QByteArray command;      // text frames only
+    quint16 commandId = 0;   // binary frames only, a BinaryProtocol::Command
+    quint64 requestId = 0;
+    QByteArray payload;
+    bool binary = false;
+};
+
+// Incremental decoder shared by the client and the server. It reads
+// "CMD=<cmd>;REQ=<id>;LEN=<n>\n<payload>" text frames, or BinaryProtocol
+// frames once switched to Mode::Binary. Consumed bytes are tracked with a read
+// cursor and only compacted on append(), so draining N pipelined frames costs
+// one memmove instead of one per frame.
+class FrameDecoder
+{
+public:
+    enum class Status { NeedMore, Ready, Malformed };
+    enum class Mode { Text, Binary };
+
+    // Takes effect for the next frame; bytes already buffered are reparsed.
+    void setMode(Mode newMode);
+    Mode mode() const { return decodeMode; }
+
+    void append(const QByteArray &data);
+    Status next(RawFrame &frame);
+    // Drops buffered bytes and returns to text mode, e.g. after a disconnect.
+    void clear();
+
+    // Bytes received but not yet handed out as frames.
+    int bufferedBytes() const { return buffer.size() - readPos; }
+
+    // Longest header line accepted before the stream is treated as malformed.
+    static constexpr int kMaxHeaderBytes = 1024;
+
+private:
+    Status readTextHeader();
+    Status readBinaryHeader();
+    bool parseHeader(const char *begin, const char *end);
+
+    Mode decodeMode = Mode::Text;
+    QByteArray buffer;
+    int readPos = 0;      // start of the current, not yet complete frame
+    int scanPos = 0;      // how far the current header has been searched for '\n'
+    bool headerReady = false;
+    int headerBytes = 0;  // header line length including '\n'
+    int commandOffset = 0;
+    int commandLength = 0;
+    quint16 commandId = 0;
+    quint64 requestId = 0;
+    int payloadLength = 0;
+};
+
+#endif // FRAMEDECODER_H
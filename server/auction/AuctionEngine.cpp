@@ -0,0 +1,307 @@
+#include "AuctionEngine.h"
+
+#include "db/WriteBatcher.h"
+#include "metrics/Metrics.h"
+
+#include <QCborArray>
+#include <QDateTime>
+#include <QDebug>
+
+#include <utility>
+
+namespace {
+// Bids kept in memory per auction for GET_AUCTION; the full history is in SQLite.
+constexpr int kRecentBids = 20;
+// Closed auctions stay in memory this long past their end, for the last
+// GET_AUCTION and SUBSCRIBE calls; after that they are read from SQLite.
+constexpr qint64 kClosedLingerMs = 60 * 1000;
+
+qint64 nowMs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+Metrics::Counter *writeFailures()
+{
+    static Metrics::Counter *const counter = Metrics::Registry::instance().counter(
+        "auction_write_failures_total", "Auction writes that failed to commit; each reloads its auction.");
+    return counter;
+}
+
+Database::Write closeWrite(qint64 auctionId)
+{
+    return [auctionId](Database &db) { return db.closeAuction(auctionId) ? WriteResult::Ok : WriteResult::Failed; };
+}
+} // namespace
+
+QCborMap AuctionSnapshot::toCbor() const
+{
+    QCborArray bids;
+    for (const BidRecord &bid : recentBids) {
+        QCborMap entry;
+        entry.insert(QStringLiteral("bidderId"), bid.bidderId);
+        entry.insert(QStringLiteral("amount"), bid.amount);
+        entry.insert(QStringLiteral("placedAt"), bid.placedAtMs);
+        bids.append(entry);
+    }
+
+    QCborMap map;
+    map.insert(QStringLiteral("auctionId"), auction.id);
+    map.insert(QStringLiteral("sellerId"), auction.sellerId);
+    map.insert(QStringLiteral("title"), auction.title);
+    map.insert(QStringLiteral("description"), auction.description);
+    map.insert(QStringLiteral("category"), auction.category);
+    map.insert(QStringLiteral("startPrice"), auction.startPrice);
+    map.insert(QStringLiteral("minIncrement"), auction.minIncrement);
+    map.insert(QStringLiteral("currentPrice"), auction.currentPrice);
+    map.insert(QStringLiteral("leaderId"), auction.leaderId);
+    map.insert(QStringLiteral("bidCount"), auction.bidCount);
+    map.insert(QStringLiteral("minimumBid"), auction.minimumBid());
+    map.insert(QStringLiteral("createdAt"), auction.createdAtMs);
+    map.insert(QStringLiteral("endsAt"), auction.endsAtMs);
+    map.insert(QStringLiteral("status"), auction.open ? QStringLiteral("open") : QStringLiteral("closed"));
+    map.insert(QStringLiteral("bids"), bids);
+    return map;
+}
+
+AuctionEngine::AuctionEngine(Database &db, WriteBatcher &writer, int shardCount, int maxQueueDepth)
+    : database(db)
+    , writeBatcher(writer)
+{
+    const int count = qMax(1, shardCount);
+    shards.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        shards.push_back(std::make_unique<Shard>(maxQueueDepth));
+    }
+}
+
+AuctionEngine::~AuctionEngine()
+{
+    drain();
+}
+
+void AuctionEngine::restore()
+{
+    lastId.store(database.maxAuctionId());
+    const QVector<AuctionRecord> open = database.loadOpenAuctions();
+    for (const AuctionRecord &auction : open) {
+        // Shard threads have not run anything yet, so filling their maps here is safe.
+        AuctionSnapshot state;
+        state.auction = auction;
+        track(shardFor(auction.id), state);
+    }
+    qInfo("[SERVER] Restored %d open auction(s) across %d shard(s)", static_cast<int>(open.size()), shardCount());
+}
+
+bool AuctionEngine::create(const AuctionRecord &auction, std::function<void(const AuctionSnapshot *)> done)
+{
+    AuctionSnapshot state;
+    state.auction = auction;
+    state.auction.id = lastId.fetch_add(1) + 1;
+    state.auction.currentPrice = auction.startPrice;
+    state.auction.leaderId = 0;
+    state.auction.bidCount = 0;
+    state.auction.open = true;
+
+    Shard &shard = shardFor(state.auction.id);
+    return shard.executor.submit([this, &shard, state, done = std::move(done)]() {
+        // Queued ahead of any bid on this id, so the row exists before its bids.
+        const AuctionRecord record = state.auction;
+        const bool queued = persist(shard, record.id, [record](Database &db) {
+            return db.insertAuction(record) ? WriteResult::Ok : WriteResult::Failed;
+        });
+        if (!queued) {
+            done(nullptr); // the id stays unused
+            return;
+        }
+        track(shard, state);
+        done(&state);
+    });
+}
+
+bool AuctionEngine::placeBid(const BidRecord &bid, std::function<void(const BidOutcome &)> done)
+{
+    Shard &shard = shardFor(bid.auctionId);
+    return shard.executor.submit([this, &shard, bid, done = std::move(done)]() {
+        BidOutcome outcome;
+        auto it = shard.auctions.find(bid.auctionId);
+        if (it == shard.auctions.end()) {
+            // Only closed auctions leave memory, so a stored one is closed.
+            if (loadStored(bid.auctionId, outcome.snapshot)) {
+                outcome.status = BidOutcome::Status::Closed;
+                outcome.minimumBid = outcome.snapshot.auction.minimumBid();
+            }
+            done(outcome);
+            return;
+        }
+
+        AuctionSnapshot &state = it.value();
+        AuctionRecord &auction = state.auction;
+        const qint64 now = nowMs();
+        outcome.minimumBid = auction.minimumBid();
+        if (!checkOpen(shard, state, now)) {
+            outcome.status = BidOutcome::Status::Closed;
+        } else if (bid.bidderId == auction.sellerId) {
+            outcome.status = BidOutcome::Status::OwnAuction;
+        } else if (bid.amount < outcome.minimumBid) {
+            outcome.status = BidOutcome::Status::TooLow;
+        } else {
+            BidRecord accepted = bid;
+            accepted.placedAtMs = now;
+            AuctionRecord after = auction;
+            after.currentPrice = accepted.amount;
+            after.leaderId = accepted.bidderId;
+            ++after.bidCount;
+
+            // Applied only once its write is queued, so memory never runs ahead of what will commit.
+            const bool queued = persist(shard, after.id, [accepted, after](Database &db) {
+                return db.recordBid(accepted, after) ? WriteResult::Ok : WriteResult::Failed;
+            });
+            if (!queued) {
+                outcome.status = BidOutcome::Status::Busy;
+            } else {
+                auction = after;
+                state.recentBids.append(accepted);
+                if (state.recentBids.size() > kRecentBids) {
+                    state.recentBids.removeFirst();
+                }
+                outcome.status = BidOutcome::Status::Accepted;
+                outcome.minimumBid = auction.minimumBid();
+            }
+        }
+        outcome.snapshot = state;
+        done(outcome);
+        if (outcome.status == BidOutcome::Status::Accepted && bidListener) {
+            bidListener(auction, outcome.minimumBid);
+        }
+    });
+}
+
+bool AuctionEngine::get(qint64 auctionId, std::function<void(const AuctionSnapshot *)> done)
+{
+    Shard &shard = shardFor(auctionId);
+    return shard.executor.submit([this, &shard, auctionId, done = std::move(done)]() {
+        auto it = shard.auctions.find(auctionId);
+        if (it == shard.auctions.end()) {
+            AuctionSnapshot stored;
+            done(loadStored(auctionId, stored) ? &stored : nullptr);
+            return;
+        }
+        checkOpen(shard, it.value(), nowMs());
+        done(&it.value());
+    });
+}
+
+void AuctionEngine::closeExpired()
+{
+    for (const auto &shard : shards) {
+        Shard *target = shard.get();
+        target->executor.submit([this, target]() {
+            // Closes whose write found the queue full go first, in case it has room now.
+            for (auto it = target->unsavedCloses.begin(); it != target->unsavedCloses.end();) {
+                if (!persist(*target, *it, closeWrite(*it))) {
+                    return;
+                }
+                it = target->unsavedCloses.erase(it);
+            }
+
+            // Entries re-added below are due after now, so the walk ends.
+            const qint64 now = nowMs();
+            auto it = target->deadlines.begin();
+            while (it != target->deadlines.end() && it->first <= now) {
+                const qint64 id = it->second;
+                it = target->deadlines.erase(it);
+                auto found = target->auctions.find(id);
+                if (found == target->auctions.end()) {
+                    continue;
+                }
+                checkOpen(*target, found.value(), now);
+                const qint64 evictAt = found.value().auction.endsAtMs + kClosedLingerMs;
+                if (now < evictAt || target->unsavedCloses.contains(id)) {
+                    target->deadlines.emplace(qMax(evictAt, now + 1), id);
+                } else {
+                    target->auctions.erase(found);
+                }
+            }
+        });
+    }
+}
+
+void AuctionEngine::drain()
+{
+    for (const auto &shard : shards) {
+        shard->executor.drain();
+    }
+    writeBatcher.drain();
+    // Failed writes may have queued reloads while the batcher drained.
+    for (const auto &shard : shards) {
+        shard->executor.drain();
+    }
+}
+
+void AuctionEngine::track(Shard &shard, const AuctionSnapshot &state)
+{
+    shard.auctions.insert(state.auction.id, state);
+    if (state.auction.open) {
+        shard.deadlines.emplace(state.auction.endsAtMs, state.auction.id);
+    }
+}
+
+bool AuctionEngine::loadStored(qint64 auctionId, AuctionSnapshot &state) const
+{
+    // Ids past the last one handed out cannot be stored, so they skip the read.
+    if (auctionId <= 0 || auctionId > lastId.load()) {
+        return false;
+    }
+    if (!database.loadAuction(auctionId, kRecentBids, state.auction, state.recentBids)) {
+        return false;
+    }
+    state.auction.open = state.auction.open && nowMs() < state.auction.endsAtMs;
+    return true;
+}
+
+bool AuctionEngine::checkOpen(Shard &shard, AuctionSnapshot &state, qint64 now)
+{
+    if (state.auction.open && now >= state.auction.endsAtMs) {
+        state.auction.open = false;
+        // If the queue is full, closeExpired() retries the write on its next round.
+        if (!persist(shard, state.auction.id, closeWrite(state.auction.id))) {
+            shard.unsavedCloses.insert(state.auction.id);
+        }
+    }
+    return state.auction.open;
+}
+
+bool AuctionEngine::persist(Shard &shard, qint64 auctionId, Database::Write write)
+{
+    // Runs on the writer thread; the reload hops back to the shard that owns the auction.
+    return writeBatcher.submit(std::move(write), [this, &shard, auctionId](WriteResult result) {
+        if (result == WriteResult::Ok) {
+            return;
+        }
+        writeFailures()->add();
+        qWarning("[SERVER] Write for auction %lld failed; reloading it", static_cast<long long>(auctionId));
+        if (!shard.executor.submit([this, &shard, auctionId]() { reload(shard, auctionId); })) {
+            qWarning("[SERVER] Shard queue full; auction %lld not reloaded", static_cast<long long>(auctionId));
+        }
+    });
+}
+
+void AuctionEngine::reload(Shard &shard, qint64 auctionId)
+{
+    auto it = shard.auctions.find(auctionId);
+    if (it == shard.auctions.end()) {
+        return;
+    }
+    AuctionSnapshot stored;
+    if (!database.loadAuction(auctionId, kRecentBids, stored.auction, stored.recentBids)) {
+        // The insert never committed: drop it as if the create had been refused.
+        shard.auctions.erase(it);
+        return;
+    }
+    if (stored.auction.open && nowMs() >= stored.auction.endsAtMs) {
+        stored.auction.open = false;
+        shard.unsavedCloses.insert(auctionId); // the close did not commit either
+    }
+    it.value() = stored;
+}
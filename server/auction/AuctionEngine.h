@@ -0,0 +1,133 @@
+#ifndef AUCTIONENGINE_H
+#define AUCTIONENGINE_H
+
+#include <QCborMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "db/Database.h"
+#include "protocol/WorkerPool.h"
+
+class WriteBatcher;
+
+struct AuctionSnapshot
+{
+    AuctionRecord auction;
+    QVector<BidRecord> recentBids; // oldest first
+
+    // The auction object of GET_AUCTION, SUBSCRIBE_OK and CREATE_AUCTION_OK.
+    QCborMap toCbor() const;
+};
+
+struct BidOutcome
+{
+    enum class Status
+    {
+        Accepted,
+        NotFound,
+        Closed,
+        TooLow,
+        OwnAuction,
+        Busy, // the write queue is full; the bid was not applied
+    };
+
+    Status status = Status::NotFound;
+    qint64 minimumBid = 0;    // smallest amount the next bid must reach
+    AuctionSnapshot snapshot; // state after the attempt; empty for NotFound
+};
+
+// In-memory order books for every open auction, and for closed ones for a
+// short while after they end; older auctions are read back from SQLite on
+// demand. Auctions are split across
+// shards by id, and each shard is owned by one thread: every read and write of
+// its auctions runs there, so bids need no locks and bidders on different
+// auctions never wait for each other. Accepted bids are handed to the
+// WriteBatcher and committed in groups after the reply has been decided, so
+// an OK means queued, not yet on disk; a write that then fails is logged and
+// its auction reloaded from SQLite.
+// When its queue is full, creates and bids are refused rather than applied,
+// so a slow disk pushes back on clients instead of on the shard threads.
+//
+// Callbacks run on the shard thread.
+class AuctionEngine
+{
+public:
+    // Called on the shard thread after each accepted bid with the new state.
+    using BidListener = std::function<void(const AuctionRecord &auction, qint64 minimumBid)>;
+
+    AuctionEngine(Database &db, WriteBatcher &writer, int shardCount, int maxQueueDepth);
+    ~AuctionEngine();
+
+    AuctionEngine(const AuctionEngine &) = delete;
+    AuctionEngine &operator=(const AuctionEngine &) = delete;
+
+    // Loads open auctions and the id sequence; call once before serving requests.
+    void restore();
+
+    // Each call returns false, without calling done, if the shard's queue is full.
+    // create() ignores auction.id and assigns the next free one; done receives
+    // nullptr if the write queue was full.
+    bool create(const AuctionRecord &auction, std::function<void(const AuctionSnapshot *)> done);
+    bool placeBid(const BidRecord &bid, std::function<void(const BidOutcome &)> done);
+    // done receives nullptr for an unknown id. Auctions no longer in memory
+    // are read from SQLite on the shard thread.
+    bool get(qint64 auctionId, std::function<void(const AuctionSnapshot *)> done);
+
+    // Set before serving requests; the shard threads read it without locking.
+    void setBidListener(BidListener listener) { bidListener = std::move(listener); }
+
+    // Queues a job on every shard that closes the auctions whose end time has
+    // passed and writes them out, and drops closed ones from memory once they
+    // have lingered. Call it periodically; a shard whose queue is full skips
+    // that round.
+    void closeExpired();
+
+    // Blocks until queued bids and their writes have finished.
+    void drain();
+
+    int shardCount() const { return static_cast<int>(shards.size()); }
+
+private:
+    struct Shard
+    {
+        explicit Shard(int maxQueueDepth)
+            : executor(1, maxQueueDepth)
+        {
+        }
+
+        // All but executor are touched by executor jobs only.
+        WorkerPool executor; // the shard's only thread
+        QHash<qint64, AuctionSnapshot> auctions;
+        std::multimap<qint64, qint64> deadlines; // due time -> id: close, then evict
+        QSet<qint64> unsavedCloses;              // closed in memory, write not queued yet
+    };
+
+    Shard &shardFor(qint64 auctionId) { return *shards[static_cast<size_t>(auctionId) % shards.size()]; }
+    // Adds state to the shard's map and, while it is open, its deadlines.
+    static void track(Shard &shard, const AuctionSnapshot &state);
+    // Reads an auction that is not in memory from SQLite; false if unknown.
+    bool loadStored(qint64 auctionId, AuctionSnapshot &state) const;
+    // Marks an expired auction closed; returns true if it is still open.
+    bool checkOpen(Shard &shard, AuctionSnapshot &state, qint64 now);
+    // Queues write on the WriteBatcher; false, without queueing, if it is full.
+    // If the write fails to commit, auctionId is reloaded on its shard.
+    bool persist(Shard &shard, qint64 auctionId, Database::Write write);
+    // Replaces the in-memory state with what SQLite holds after a failed write.
+    void reload(Shard &shard, qint64 auctionId);
+
+    Database &database;
+    WriteBatcher &writeBatcher;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<qint64> lastId{0};
+    BidListener bidListener;
+};
+
+#endif // AUCTIONENGINE_H
@@ -0,0 +1,185 @@
+#include "PriceFeed.h"
+
+#include "network/ClientSession.h"
+
+#include <QObject>
+#include <QSet>
+#include <QThread>
+
+// Lives on one I/O thread. The subscription maps are only touched there;
+// pending is filled by publishing threads and drained by flush().
+class PriceFeed::ThreadHub : public QObject
+{
+public:
+    explicit ThreadHub(PriceFeed *owner)
+        : feed(owner)
+    {
+    }
+
+    void post(const PriceUpdate &update)
+    {
+        QMutexLocker locker(&pendingMutex);
+        pending.insert(update.auctionId, update); // an older price still queued is dropped
+        if (flushScheduled) {
+            return;
+        }
+        flushScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() { flush(); }, Qt::QueuedConnection);
+    }
+
+    void flush()
+    {
+        QHash<qint64, PriceUpdate> batch;
+        {
+            QMutexLocker locker(&pendingMutex);
+            batch.swap(pending);
+            flushScheduled = false;
+        }
+        for (const PriceUpdate &update : std::as_const(batch)) {
+            const QSet<ClientSession *> targets = subscribers.value(update.auctionId);
+            for (ClientSession *session : targets) {
+                session->pushUpdate(update);
+            }
+        }
+    }
+
+    bool add(ClientSession *session, qint64 auctionId)
+    {
+        auto it = subscriptions.find(session);
+        if (it == subscriptions.end()) {
+            it = subscriptions.insert(session, QSet<qint64>());
+            connect(session, &QObject::destroyed, this, [this, session]() { removeSession(session); },
+                    Qt::DirectConnection);
+        }
+        if (it->contains(auctionId)) {
+            return true;
+        }
+        if (it->size() >= kMaxSubscriptionsPerSession) {
+            return false;
+        }
+        it->insert(auctionId);
+
+        QSet<ClientSession *> &sessions = subscribers[auctionId];
+        sessions.insert(session);
+        if (sessions.size() == 1) {
+            feed->setInterested(this, auctionId, true);
+        }
+        return true;
+    }
+
+    void remove(ClientSession *session, qint64 auctionId)
+    {
+        auto it = subscriptions.find(session);
+        if (it == subscriptions.end() || !it->remove(auctionId)) {
+            return;
+        }
+        dropSubscriber(session, auctionId);
+    }
+
+private:
+    void removeSession(ClientSession *session)
+    {
+        const QSet<qint64> auctions = subscriptions.take(session);
+        for (qint64 auctionId : auctions) {
+            dropSubscriber(session, auctionId);
+        }
+    }
+
+    void dropSubscriber(ClientSession *session, qint64 auctionId)
+    {
+        auto it = subscribers.find(auctionId);
+        if (it == subscribers.end()) {
+            return;
+        }
+        it->remove(session);
+        if (it->isEmpty()) {
+            subscribers.erase(it);
+            feed->setInterested(this, auctionId, false);
+        }
+    }
+
+    PriceFeed *const feed;
+    QHash<qint64, QSet<ClientSession *>> subscribers;
+    QHash<ClientSession *, QSet<qint64>> subscriptions;
+
+    QMutex pendingMutex;
+    QHash<qint64, PriceUpdate> pending;
+    bool flushScheduled = false;
+};
+
+PriceFeed::PriceFeed()
+{
+}
+
+PriceFeed::~PriceFeed()
+{
+    // The I/O threads are gone by now, so nothing else touches the hubs.
+    qDeleteAll(hubs);
+}
+
+bool PriceFeed::subscribe(ClientSession *session, qint64 auctionId)
+{
+    return hubForCurrentThread()->add(session, auctionId);
+}
+
+void PriceFeed::unsubscribe(ClientSession *session, qint64 auctionId)
+{
+    hubForCurrentThread()->remove(session, auctionId);
+}
+
+void PriceFeed::publish(const AuctionRecord &auction, qint64 minimumBid)
+{
+    QVector<ThreadHub *> targets;
+    {
+        QMutexLocker locker(&mutex);
+        targets = interestedHubs.value(auction.id);
+    }
+    if (targets.isEmpty()) {
+        return;
+    }
+
+    QCborMap payload;
+    payload.insert(QStringLiteral("auctionId"), auction.id);
+    payload.insert(QStringLiteral("currentPrice"), auction.currentPrice);
+    payload.insert(QStringLiteral("leaderId"), auction.leaderId);
+    payload.insert(QStringLiteral("bidCount"), auction.bidCount);
+    payload.insert(QStringLiteral("minimumBid"), minimumBid);
+    payload.insert(QStringLiteral("endsAt"), auction.endsAtMs);
+
+    const Response push{BinaryProtocol::Command::PriceUpdate, 0, payload};
+    PriceUpdate update;
+    update.auctionId = auction.id;
+    update.text = encodeResponse(push, ProtocolVersion::Text);
+    update.binary = encodeResponse(push, ProtocolVersion::Binary);
+
+    for (ThreadHub *hub : std::as_const(targets)) {
+        hub->post(update);
+    }
+}
+
+PriceFeed::ThreadHub *PriceFeed::hubForCurrentThread()
+{
+    QThread *thread = QThread::currentThread();
+    QMutexLocker locker(&mutex);
+    ThreadHub *&hub = hubs[thread];
+    if (!hub) {
+        hub = new ThreadHub(this); // created here, so it lives on this thread
+    }
+    return hub;
+}
+
+void PriceFeed::setInterested(ThreadHub *hub, qint64 auctionId, bool interested)
+{
+    QMutexLocker locker(&mutex);
+    if (interested) {
+        interestedHubs[auctionId].append(hub);
+        return;
+    }
+    auto it = interestedHubs.find(auctionId);
+    if (it != interestedHubs.end()) {
+        it->removeOne(hub);
+        if (it->isEmpty()) {
+            interestedHubs.erase(it);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef PRICEFEED_H
+#define PRICEFEED_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "db/Database.h"
+#include "protocol/Protocol.h"
+
+class ClientSession;
+class QThread;
+
+// One PRICE_UPDATE push, encoded once per wire format and shared (not copied)
+// by every subscriber that writes it.
+struct PriceUpdate
+{
+    qint64 auctionId = 0;
+    QByteArray text;
+    QByteArray binary;
+
+    const QByteArray &frame(ProtocolVersion version) const
+    {
+        return version == ProtocolVersion::Binary ? binary : text;
+    }
+};
+
+// Fans accepted bids out to the sessions subscribed to their auction.
+//
+// Subscriptions are kept per I/O thread, so publishing takes the feed's mutex
+// only to find which threads care about an auction and then posts one event to
+// each of them. Updates for the same auction that pile up before a thread gets
+// to them are merged, so a hot auction costs each thread at most one delivery
+// per event-loop pass, carrying the newest price.
+class PriceFeed
+{
+public:
+    static constexpr int kMaxSubscriptionsPerSession = 256;
+
+    PriceFeed();
+    ~PriceFeed();
+
+    PriceFeed(const PriceFeed &) = delete;
+    PriceFeed &operator=(const PriceFeed &) = delete;
+
+    // Call on the session's thread. Returns false once the session has
+    // kMaxSubscriptionsPerSession subscriptions. Sessions are dropped
+    // automatically when they are destroyed.
+    bool subscribe(ClientSession *session, qint64 auctionId);
+    void unsubscribe(ClientSession *session, qint64 auctionId);
+
+    // Safe from any thread; does nothing if no one is subscribed to auction.
+    void publish(const AuctionRecord &auction, qint64 minimumBid);
+
+private:
+    class ThreadHub;
+
+    ThreadHub *hubForCurrentThread();
+    void setInterested(ThreadHub *hub, qint64 auctionId, bool interested);
+
+    QMutex mutex;
+    QHash<QThread *, ThreadHub *> hubs;
+    QHash<qint64, QVector<ThreadHub *>> interestedHubs;
+};
+
+#endif // PRICEFEED_H
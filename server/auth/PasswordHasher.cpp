@@ -0,0 +1,116 @@
+#include "PasswordHasher.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QStringList>
+
+namespace {
+constexpr char kAlgorithm[] = "pbkdf2-sha256";
+constexpr int kSaltBytes = 16;
+constexpr int kKeyBytes = 32;
+
+// RFC 8018 PBKDF2 with HMAC-SHA256; one block is enough for a 32-byte key.
+QByteArray pbkdf2Sha256(const QByteArray &password, const QByteArray &salt, int iterations)
+{
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, password);
+    mac.addData(salt);
+    mac.addData(QByteArray::fromHex("00000001"));
+    QByteArray u = mac.result();
+    QByteArray key = u;
+    for (int i = 1; i < iterations; ++i) {
+        mac.reset();
+        mac.addData(u);
+        u = mac.result();
+        for (int j = 0; j < kKeyBytes; ++j) {
+            key[j] = static_cast<char>(key[j] ^ u[j]);
+        }
+    }
+    return key.left(kKeyBytes);
+}
+
+// Fixed salt and an all-zero key: verifying against it runs the full KDF and fails.
+QString decoyRecordWithCost(int iterations)
+{
+    return QStringLiteral("%1$%2$%3$%4")
+        .arg(QLatin1String(kAlgorithm))
+        .arg(iterations)
+        .arg(QString::fromLatin1(QByteArrayLiteral("auction-decoy-16").toBase64()))
+        .arg(QString::fromLatin1(QByteArray(kKeyBytes, '\0').toBase64()));
+}
+
+bool constantTimeEquals(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    char diff = 0;
+    for (int i = 0; i < a.size(); ++i) {
+        diff = static_cast<char>(diff | (a[i] ^ b[i]));
+    }
+    return diff == 0;
+}
+} // namespace
+
+PasswordHasher::PasswordHasher(int iterations, int threadCount, int maxQueueDepth)
+    : cost(qMax(1, iterations))
+    , decoy(decoyRecordWithCost(cost))
+    , pool(threadCount, maxQueueDepth)
+{
+}
+
+QString PasswordHasher::hashWithCost(const QString &password, int iterations)
+{
+    QByteArray salt(kSaltBytes, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(salt.data()), kSaltBytes / 4);
+    const QByteArray key = pbkdf2Sha256(password.toUtf8(), salt, iterations);
+    return QStringLiteral("%1$%2$%3$%4")
+        .arg(QLatin1String(kAlgorithm))
+        .arg(iterations)
+        .arg(QString::fromLatin1(salt.toBase64()))
+        .arg(QString::fromLatin1(key.toBase64()));
+}
+
+QString PasswordHasher::hash(const QString &password) const
+{
+    return hashWithCost(password, cost);
+}
+
+PasswordHasher::Verdict PasswordHasher::verify(const QString &password, const QString &record) const
+{
+    Verdict verdict;
+    const QStringList parts = record.split(QLatin1Char('$'));
+    if (parts.size() != 4 || parts.at(0) != QLatin1String(kAlgorithm)) {
+        // Rows written before hashing existed hold the plain password.
+        verdict.matches = constantTimeEquals(password.toUtf8(), record.toUtf8());
+        verdict.needsRehash = true;
+        return verdict;
+    }
+
+    bool ok = false;
+    const int iterations = parts.at(1).toInt(&ok);
+    if (!ok || iterations < 1) {
+        return verdict;
+    }
+    const QByteArray salt = QByteArray::fromBase64(parts.at(2).toLatin1());
+    const QByteArray expected = QByteArray::fromBase64(parts.at(3).toLatin1());
+    verdict.matches = constantTimeEquals(pbkdf2Sha256(password.toUtf8(), salt, iterations), expected);
+    verdict.needsRehash = iterations != cost;
+    return verdict;
+}
+
+bool PasswordHasher::hashAsync(const QString &password, std::function<void(const QString &)> done)
+{
+    return pool.submit([this, password, done = std::move(done)]() {
+        done(hash(password));
+    });
+}
+
+bool PasswordHasher::verifyAsync(const QString &password, const QString &record,
+                                 std::function<void(const Verdict &)> done)
+{
+    return pool.submit([this, password, record, done = std::move(done)]() {
+        done(verify(password, record));
+    });
+}
@@ -0,0 +1,52 @@
+#ifndef PASSWORDHASHER_H
+#define PASSWORDHASHER_H
+
+#include <QString>
+
+#include <functional>
+
+#include "protocol/WorkerPool.h"
+
+// Salted PBKDF2-HMAC-SHA256 password records of the form
+//   pbkdf2-sha256$<iterations>$<salt base64>$<hash base64>
+// stored in users.password. Hashing is CPU-bound, so it runs on the hasher's
+// own bounded pool instead of the I/O or database threads.
+class PasswordHasher
+{
+public:
+    struct Verdict
+    {
+        bool matches = false;
+        // The record uses another algorithm or cost than the current one.
+        bool needsRehash = false;
+    };
+
+    PasswordHasher(int iterations, int threadCount, int maxQueueDepth);
+
+    int iterations() const { return cost; }
+
+    QString hash(const QString &password) const;
+    Verdict verify(const QString &password, const QString &record) const;
+
+    // Run hash()/verify() on the hasher pool; false if its queue is full.
+    bool hashAsync(const QString &password, std::function<void(const QString &record)> done);
+    bool verifyAsync(const QString &password, const QString &record, std::function<void(const Verdict &)> done);
+
+    // Blocks until every queued hash or verification has run.
+    void drain() { pool.drain(); }
+
+    static QString hashWithCost(const QString &password, int iterations);
+
+    // A well-formed record at the current cost that no password matches.
+    // LOGIN verifies against it when the email is unknown, so a miss costs
+    // the same KDF run as a wrong password and timing does not reveal
+    // which accounts exist.
+    const QString &decoyRecord() const { return decoy; }
+
+private:
+    const int cost;
+    const QString decoy;
+    WorkerPool pool;
+};
+
+#endif // PASSWORDHASHER_H
@@ -0,0 +1,179 @@
+#include "SessionStore.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QRandomGenerator>
+#include <QSaveFile>
+
+namespace {
+constexpr quint32 kSnapshotMagic = 0x53455353; // "SESS"
+// 1 stored raw tokens; 2 stores their SHA-256.
+constexpr quint32 kSnapshotVersion = 2;
+constexpr int kTokenWords = 8; // 256 bits
+
+qint64 nowMs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+// Sessions are keyed by the token's hash, so neither the map nor a snapshot
+// holds a usable bearer token. Tokens are 256 random bits, so a plain SHA-256
+// is enough: there is nothing to brute-force.
+QByteArray keyFor(const QByteArray &token)
+{
+    return QCryptographicHash::hash(token, QCryptographicHash::Sha256);
+}
+} // namespace
+
+SessionStore::SessionStore(qint64 ttlSeconds)
+    : ttlMs(qMax<qint64>(1, ttlSeconds) * 1000)
+{
+}
+
+SessionStore::Shard &SessionStore::shardFor(const QByteArray &key)
+{
+    return shards[qHash(key) % kShardCount];
+}
+
+QByteArray SessionStore::issue(qint64 userId, const QString &username)
+{
+    quint32 words[kTokenWords];
+    QRandomGenerator::system()->fillRange(words, kTokenWords);
+    const QByteArray token = QByteArray(reinterpret_cast<const char *>(words), sizeof(words)).toHex();
+
+    SessionInfo info;
+    info.userId = userId;
+    info.username = username;
+    info.expiresAtMs = nowMs() + ttlMs;
+
+    const QByteArray key = keyFor(token);
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    shard.sessions.insert(key, info);
+    return token;
+}
+
+bool SessionStore::validate(const QByteArray &token, SessionInfo *info)
+{
+    if (token.isEmpty()) {
+        return false;
+    }
+
+    const qint64 now = nowMs();
+    const QByteArray key = keyFor(token);
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.sessions.find(key);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    if (it->expiresAtMs <= now) {
+        shard.sessions.erase(it);
+        return false;
+    }
+    it->expiresAtMs = now + ttlMs;
+    if (info) {
+        *info = *it;
+    }
+    return true;
+}
+
+void SessionStore::revoke(const QByteArray &token)
+{
+    const QByteArray key = keyFor(token);
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    shard.sessions.remove(key);
+}
+
+void SessionStore::sweep()
+{
+    Shard &shard = shards[nextSweepShard];
+    nextSweepShard = (nextSweepShard + 1) % kShardCount;
+
+    const qint64 now = nowMs();
+    QMutexLocker locker(&shard.mutex);
+    for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+        if (it->expiresAtMs <= now) {
+            it = shard.sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int SessionStore::size() const
+{
+    int total = 0;
+    for (const Shard &shard : shards) {
+        QMutexLocker locker(&shard.mutex);
+        total += shard.sessions.size();
+    }
+    return total;
+}
+
+bool SessionStore::saveSnapshot(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write session snapshot" << path << ":" << file.errorString();
+        return false;
+    }
+    // Owner only, whatever the umask; set on the temporary file before commit() renames it.
+    if (!file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner)) {
+        qWarning() << "Could not restrict session snapshot permissions" << path;
+        file.cancelWriting();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << kSnapshotMagic << kSnapshotVersion;
+    const qint64 now = nowMs();
+    for (const Shard &shard : shards) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto it = shard.sessions.cbegin(); it != shard.sessions.cend(); ++it) {
+            if (it->expiresAtMs > now) {
+                out << true << it.key() << it->userId << it->username << it->expiresAtMs;
+            }
+        }
+    }
+    out << false;
+    return file.commit();
+}
+
+bool SessionStore::loadSnapshot(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kSnapshotMagic || version < 1 || version > kSnapshotVersion) {
+        qWarning() << "Ignoring session snapshot with unknown format:" << path;
+        return false;
+    }
+
+    const qint64 now = nowMs();
+    bool more = false;
+    in >> more;
+    while (more && in.status() == QDataStream::Ok) {
+        QByteArray key;
+        SessionInfo info;
+        in >> key >> info.userId >> info.username >> info.expiresAtMs >> more;
+        if (in.status() == QDataStream::Ok && info.expiresAtMs > now) {
+            if (version == 1) {
+                key = keyFor(key); // raw token from an older server
+            }
+            Shard &shard = shardFor(key);
+            QMutexLocker locker(&shard.mutex);
+            shard.sessions.insert(key, info);
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
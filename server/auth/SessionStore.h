@@ -0,0 +1,59 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+
+struct SessionInfo
+{
+    qint64 userId = 0;
+    QString username;
+    qint64 expiresAtMs = 0; // wall clock, so snapshots survive a restart
+};
+
+// Login sessions keyed by the SHA-256 of a random bearer token; the token
+// itself is only ever held by the client. The map is split into shards
+// with their own mutex, so token checks from different I/O threads rarely
+// contend. Expired entries are dropped lazily on lookup and by sweep(), which
+// walks one shard per call so a periodic timer spreads the cost.
+class SessionStore
+{
+public:
+    explicit SessionStore(qint64 ttlSeconds);
+
+    // Creates a session and returns its token (64 hex characters).
+    QByteArray issue(qint64 userId, const QString &username);
+    // Checks token and slides its expiry forward; false if unknown or expired.
+    bool validate(const QByteArray &token, SessionInfo *info = nullptr);
+    void revoke(const QByteArray &token);
+    // Drops expired sessions from the next shard; call from a single thread.
+    void sweep();
+
+    int size() const;
+
+    // Live sessions are written to / restored from path; expired ones are
+    // skipped. The file is readable by the owner only and holds token hashes.
+    bool saveSnapshot(const QString &path) const;
+    bool loadSnapshot(const QString &path);
+
+private:
+    static constexpr int kShardCount = 16;
+
+    struct Shard
+    {
+        mutable QMutex mutex;
+        QHash<QByteArray, SessionInfo> sessions; // keyed by SHA-256(token)
+    };
+
+    Shard &shardFor(const QByteArray &key);
+
+    const qint64 ttlMs;
+    std::array<Shard, kShardCount> shards;
+    int nextSweepShard = 0;
+};
+
+#endif // SESSIONSTORE_H
@@ -0,0 +1,131 @@
+// Decodes one million pipelined frames delivered in socket-sized chunks, once
+// with FrameDecoder and once with the remove()-per-frame loop it replaced.
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTextStream>
+
+#include "FrameDecoder.h"
+
+namespace {
+constexpr int kFrames = 1000000;
+constexpr int kChunkBytes = 64 * 1024;
+
+QByteArray buildStream()
+{
+    QByteArray stream;
+    stream.reserve(kFrames * 64);
+    for (int i = 0; i < kFrames; ++i) {
+        const QByteArray payload = QByteArrayLiteral("{\"auctionId\":42,\"amount\":") + QByteArray::number(i) + '}';
+        stream.append("CMD=PLACE_BID;REQ=");
+        stream.append(QByteArray::number(i + 1));
+        stream.append(";LEN=");
+        stream.append(QByteArray::number(payload.size()));
+        stream.append('\n');
+        stream.append(payload);
+    }
+    return stream;
+}
+
+qint64 decodeWithFrameDecoder(const QByteArray &stream, quint64 &checksum)
+{
+    FrameDecoder decoder;
+    RawFrame frame;
+    qint64 frames = 0;
+    for (int offset = 0; offset < stream.size(); offset += kChunkBytes) {
+        decoder.append(QByteArray::fromRawData(stream.constData() + offset, qMin(kChunkBytes, stream.size() - offset)));
+        while (decoder.next(frame) == FrameDecoder::Status::Ready) {
+            checksum += frame.requestId + static_cast<quint64>(frame.payload.size());
+            ++frames;
+        }
+    }
+    return frames;
+}
+
+// The framing loop ClientSession and TcpClient used before FrameDecoder.
+qint64 decodeLegacy(const QByteArray &stream, quint64 &checksum)
+{
+    auto parseLen = [](const QByteArray &header) -> int {
+        const QList<QByteArray> parts = header.trimmed().split(';');
+        for (const QByteArray &p : parts) {
+            if (p.startsWith("LEN=")) {
+                bool ok = false;
+                int len = p.mid(4).toInt(&ok);
+                if (ok) return len;
+            }
+        }
+        return 0;
+    };
+    auto parseReq = [](const QByteArray &header) -> quint64 {
+        const QList<QByteArray> parts = header.trimmed().split(';');
+        for (const QByteArray &p : parts) {
+            if (p.startsWith("REQ=")) {
+                return p.mid(4).toULongLong();
+            }
+        }
+        return 0;
+    };
+
+    QByteArray buffer;
+    QByteArray currentHeader;
+    int expectedPayloadLen = -1;
+    qint64 frames = 0;
+    for (int offset = 0; offset < stream.size(); offset += kChunkBytes) {
+        buffer.append(stream.constData() + offset, qMin(kChunkBytes, stream.size() - offset));
+        while (true) {
+            if (currentHeader.isEmpty()) {
+                const int newlineIndex = buffer.indexOf('\n');
+                if (newlineIndex == -1) {
+                    break;
+                }
+                currentHeader = buffer.left(newlineIndex + 1);
+                buffer.remove(0, newlineIndex + 1);
+                expectedPayloadLen = parseLen(currentHeader);
+            }
+            if (expectedPayloadLen > buffer.size()) {
+                break;
+            }
+            const QByteArray payload = buffer.left(expectedPayloadLen);
+            buffer.remove(0, expectedPayloadLen);
+            checksum += parseReq(currentHeader) + static_cast<quint64>(payload.size());
+            ++frames;
+            currentHeader.clear();
+            expectedPayloadLen = -1;
+        }
+    }
+    return frames;
+}
+
+void report(QTextStream &out, const char *name, qint64 frames, qint64 elapsedNs, quint64 checksum)
+{
+    out << QStringLiteral("{\"decoder\":\"%1\",\"frames\":%2,\"ms\":%3,\"ns_per_frame\":%4,\"checksum\":%5}\n")
+               .arg(QLatin1String(name))
+               .arg(frames)
+               .arg(elapsedNs / 1000000.0, 0, 'f', 1)
+               .arg(static_cast<double>(elapsedNs) / qMax<qint64>(1, frames), 0, 'f', 1)
+               .arg(checksum);
+    out.flush();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QByteArray stream = buildStream();
+    QElapsedTimer timer;
+
+    quint64 checksum = 0;
+    timer.start();
+    qint64 frames = decodeWithFrameDecoder(stream, checksum);
+    report(out, "FrameDecoder", frames, timer.nsecsElapsed(), checksum);
+
+    checksum = 0;
+    timer.restart();
+    frames = decodeLegacy(stream, checksum);
+    report(out, "legacy", frames, timer.nsecsElapsed(), checksum);
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Measures PING round trips per second against an in-process TcpServer while
+// varying the number of I/O worker threads. Each client thread keeps a fixed
+// number of requests pipelined on its own connection.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "auction/AuctionEngine.h"
+#include "auction/PriceFeed.h"
+#include "auth/PasswordHasher.h"
+#include "auth/SessionStore.h"
+#include "db/Database.h"
+#include "db/WriteBatcher.h"
+#include "network/TcpServer.h"
+#include "protocol/CommandHandler.h"
+
+namespace {
+QByteArray pingFrame(quint64 reqId)
+{
+    return QByteArrayLiteral("CMD=PING;REQ=") + QByteArray::number(reqId) + QByteArrayLiteral(";LEN=2\n{}");
+}
+
+// Consumes complete response frames from the front of buffer, returns how many.
+int consumeFrames(QByteArray &buffer)
+{
+    int frames = 0;
+    int offset = 0;
+    while (true) {
+        const int newline = buffer.indexOf('\n', offset);
+        if (newline == -1) {
+            break;
+        }
+        const int lenPos = buffer.lastIndexOf("LEN=", newline);
+        if (lenPos < offset) {
+            break;
+        }
+        const int len = buffer.mid(lenPos + 4, newline - lenPos - 4).toInt();
+        if (newline + 1 + len > buffer.size()) {
+            break;
+        }
+        offset = newline + 1 + len;
+        ++frames;
+    }
+    buffer.remove(0, offset);
+    return frames;
+}
+
+void runClient(quint16 port, int depth, qint64 durationMs, std::atomic<qint64> &completed)
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    if (!socket.waitForConnected(3000)) {
+        return;
+    }
+
+    quint64 nextReq = 1;
+    int inFlight = 0;
+    qint64 done = 0;
+    QByteArray buffer;
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < durationMs || inFlight > 0) {
+        if (timer.elapsed() < durationMs) {
+            QByteArray batch;
+            while (inFlight < depth) {
+                batch.append(pingFrame(nextReq++));
+                ++inFlight;
+            }
+            if (!batch.isEmpty()) {
+                socket.write(batch);
+            }
+        }
+        if (!socket.waitForReadyRead(1000)) {
+            break;
+        }
+        buffer.append(socket.readAll());
+        const int frames = consumeFrames(buffer);
+        inFlight -= frames;
+        done += frames;
+    }
+    completed.fetch_add(done);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption maxWorkersOption(QStringLiteral("max-workers"), QStringLiteral("Largest worker count to test."),
+                                              QStringLiteral("n"), QString::number(QThread::idealThreadCount()));
+    const QCommandLineOption clientsOption(QStringLiteral("clients"), QStringLiteral("Concurrent client connections."),
+                                           QStringLiteral("n"), QStringLiteral("64"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"), QStringLiteral("Pipelined requests per connection."),
+                                         QStringLiteral("n"), QStringLiteral("16"));
+    const QCommandLineOption secondsOption(QStringLiteral("seconds"), QStringLiteral("Duration of each run."),
+                                           QStringLiteral("s"), QStringLiteral("3"));
+    parser.addOption(maxWorkersOption);
+    parser.addOption(clientsOption);
+    parser.addOption(depthOption);
+    parser.addOption(secondsOption);
+    parser.process(app);
+
+    const int maxWorkers = qMax(1, parser.value(maxWorkersOption).toInt());
+    const int clients = qMax(1, parser.value(clientsOption).toInt());
+    const int depth = qMax(1, parser.value(depthOption).toInt());
+    const qint64 durationMs = qMax(1, parser.value(secondsOption).toInt()) * 1000;
+
+    // PING never reaches the database or the hasher, so idle ones are enough.
+    Database database;
+    PasswordHasher hasher(1, 1, 1);
+    SessionStore sessions(60);
+    WriteBatcher writeBatcher(database);
+    AuctionEngine auctions(database, writeBatcher, 1, 1);
+    PriceFeed priceFeed;
+    CommandHandler handler(database, hasher, sessions, auctions, priceFeed, writeBatcher);
+    QTextStream out(stdout);
+
+    QVector<int> workerCounts;
+    for (int w = 1; w < maxWorkers; w *= 2) {
+        workerCounts.append(w);
+    }
+    workerCounts.append(maxWorkers);
+
+    for (const int workers : std::as_const(workerCounts)) {
+        TcpServer server(&handler);
+        server.setWorkerCount(workers);
+        if (!server.start(0, QHostAddress::LocalHost)) {
+            return 1;
+        }
+
+        std::atomic<qint64> completed{0};
+        std::atomic<int> running{clients};
+        QEventLoop loop;
+        std::vector<QThread *> threads;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < clients; ++i) {
+            QThread *thread = QThread::create([&]() {
+                runClient(server.serverPort(), depth, durationMs, completed);
+            });
+            QObject::connect(thread, &QThread::finished, &loop, [&]() {
+                if (--running == 0) {
+                    loop.quit();
+                }
+            }, Qt::QueuedConnection);
+            threads.push_back(thread);
+            thread->start();
+        }
+        loop.exec();
+        const double seconds = timer.elapsed() / 1000.0;
+
+        for (QThread *thread : threads) {
+            thread->wait();
+            delete thread;
+        }
+
+        out << QStringLiteral("{\"workers\":%1,\"clients\":%2,\"depth\":%3,\"requests\":%4,\"seconds\":%5,\"rps\":%6}\n")
+                   .arg(workers)
+                   .arg(clients)
+                   .arg(depth)
+                   .arg(completed.load())
+                   .arg(seconds, 0, 'f', 2)
+                   .arg(completed.load() / seconds, 0, 'f', 0);
+        out.flush();
+    }
+    return 0;
+}
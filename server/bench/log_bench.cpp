@@ -0,0 +1,131 @@
+// Measures what a per-frame log call costs the calling thread: a disabled
+// level, an enabled AsyncLog record, a sampled frame trace and, for
+// comparison, a synchronous fprintf. Log output goes to /dev/null.
+//
+// Calls are timed in bursts well below the ring size, and the rings are
+// flushed between bursts outside the timed section, so the enabled cases
+// measure real enqueues rather than the drop path. Each row reports the
+// records dropped during that run; it should stay 0.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "AsyncLog.h"
+
+namespace {
+// A quarter of AsyncLog's 4096-record ring per thread.
+constexpr qint64 kBurstCalls = 1024;
+
+// Runs body on `threads` threads and returns the mean ns per call, counting
+// only the time spent inside the bursts.
+double measure(int threads, qint64 callsPerThread, const std::function<void(qint64)> &body)
+{
+    std::vector<QThread *> pool;
+    std::atomic<qint64> timedNs{0};
+    for (int t = 0; t < threads; ++t) {
+        pool.push_back(QThread::create([&body, &timedNs, callsPerThread]() {
+            QElapsedTimer timer;
+            qint64 spentNs = 0;
+            for (qint64 i = 0; i < callsPerThread;) {
+                const qint64 end = qMin(callsPerThread, i + kBurstCalls);
+                timer.start();
+                for (; i < end; ++i) {
+                    body(i);
+                }
+                spentNs += timer.nsecsElapsed();
+                AsyncLog::flush();
+            }
+            timedNs.fetch_add(spentNs);
+        }));
+        pool.back()->start();
+    }
+    for (QThread *thread : pool) {
+        thread->wait();
+        delete thread;
+    }
+    return static_cast<double>(timedNs.load()) / threads / callsPerThread;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption threadsOption(QStringLiteral("threads"), QStringLiteral("Logging threads."),
+                                           QStringLiteral("count"), QStringLiteral("1,4"));
+    const QCommandLineOption callsOption(QStringLiteral("calls"), QStringLiteral("Log calls per thread."),
+                                         QStringLiteral("n"), QStringLiteral("1000000"));
+    const QCommandLineOption sampleOption(QStringLiteral("sample"), QStringLiteral("Frame sampling for the sampled case."),
+                                          QStringLiteral("n"), QStringLiteral("64"));
+    parser.addOption(threadsOption);
+    parser.addOption(callsOption);
+    parser.addOption(sampleOption);
+    parser.process(app);
+
+    const qint64 calls = qMax(1ll, parser.value(callsOption).toLongLong());
+    const quint32 sample = qMax(1u, parser.value(sampleOption).toUInt());
+    const QByteArray command("PLACE_BID");
+    QTextStream out(stdout);
+
+    if (!AsyncLog::start(QStringLiteral("/dev/null"))) {
+        return 1;
+    }
+    std::FILE *devNull = std::fopen("/dev/null", "w");
+    if (!devNull) {
+        return 1;
+    }
+
+    for (const QString &threadsText : parser.value(threadsOption).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const int threads = threadsText.toInt();
+        if (threads < 1) {
+            continue;
+        }
+        // Called after each measure(): the dropped count covers that run only.
+        quint64 droppedBefore = AsyncLog::droppedRecords();
+        auto report = [&](const char *name, double nsPerCall) {
+            const quint64 dropped = AsyncLog::droppedRecords();
+            out << QStringLiteral("{\"case\":\"%1\",\"threads\":%2,\"ns_per_call\":%3,\"dropped\":%4}\n")
+                       .arg(QLatin1String(name))
+                       .arg(threads)
+                       .arg(nsPerCall, 0, 'f', 1)
+                       .arg(dropped - droppedBefore);
+            out.flush();
+            droppedBefore = dropped;
+        };
+
+        AsyncLog::setLevel(AsyncLog::Level::Info);
+        AsyncLog::setFrameSampling(1);
+        report("disabled", measure(threads, calls, [&command](qint64 i) {
+                   AsyncLog::frame("[CLIENT->SERVER] %s (req=%d, bytes=%d)", command, i, 42);
+               }));
+
+        AsyncLog::setLevel(AsyncLog::Level::Debug);
+        report("async", measure(threads, calls, [&command](qint64 i) {
+                   AsyncLog::frame("[CLIENT->SERVER] %s (req=%d, bytes=%d)", command, i, 42);
+               }));
+
+        AsyncLog::setFrameSampling(sample);
+        report("sampled", measure(threads, calls, [&command](qint64 i) {
+                   AsyncLog::frame("[CLIENT->SERVER] %s (req=%d, bytes=%d)", command, i, 42);
+               }));
+
+        report("fprintf", measure(threads, calls, [&command, devNull](qint64 i) {
+                   std::fprintf(devNull, "[CLIENT->SERVER] %s (req=%lld, bytes=%d)\n", command.constData(),
+                                static_cast<long long>(i), 42);
+               }));
+    }
+
+    std::fclose(devNull);
+    AsyncLog::stop();
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Reports how many LOGIN password checks one core sustains at each PBKDF2
+// cost, to pick --kdf-iterations against the expected login rate.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+#include "auth/PasswordHasher.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption costsOption(QStringLiteral("costs"), QStringLiteral("Comma-separated iteration counts."),
+                                         QStringLiteral("list"), QStringLiteral("10000,50000,100000,200000,600000"));
+    const QCommandLineOption secondsOption(QStringLiteral("seconds"), QStringLiteral("Time spent on each cost."),
+                                           QStringLiteral("s"), QStringLiteral("2"));
+    parser.addOption(costsOption);
+    parser.addOption(secondsOption);
+    parser.process(app);
+
+    const qint64 budgetMs = qMax(1, parser.value(secondsOption).toInt()) * 1000;
+    const QString password = QStringLiteral("correct horse battery staple");
+    QTextStream out(stdout);
+
+    for (const QString &costText : parser.value(costsOption).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const int cost = costText.toInt();
+        if (cost < 1) {
+            continue;
+        }
+        PasswordHasher hasher(cost, 1, 1);
+        const QString record = hasher.hash(password);
+
+        qint64 logins = 0;
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < budgetMs) {
+            if (!hasher.verify(password, record).matches) {
+                return 1;
+            }
+            ++logins;
+        }
+        const double seconds = timer.nsecsElapsed() / 1e9;
+
+        out << QStringLiteral("{\"iterations\":%1,\"logins\":%2,\"logins_per_sec_per_core\":%3,\"ms_per_login\":%4}\n")
+                   .arg(cost)
+                   .arg(logins)
+                   .arg(logins / seconds, 0, 'f', 1)
+                   .arg(seconds * 1000.0 / qMax<qint64>(1, logins), 0, 'f', 2);
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+// Seeds an auctions table with millions of rows and times SEARCH_AUCTIONS
+// pages deep into each sort order, next to the LIMIT/OFFSET query it
+// replaces. Keyset pages should cost the same at page 1 and page 1,000;
+// OFFSET pages grow with the number of rows skipped.
+//
+// The database file is kept, so later runs against the same --db skip the
+// seeding (a few minutes for 2M rows) unless --rows grows.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTextStream>
+#include <QVariant>
+
+#include <algorithm>
+#include <vector>
+
+#include "db/Database.h"
+
+namespace {
+const char *const kWords[] = {
+    "lamp",   "clock",  "vase",   "chair",  "table",  "watch",   "ring",   "coin",   "stamp",  "book",
+    "poster", "guitar", "camera", "phone",  "laptop", "bicycle", "sofa",   "rug",    "mirror", "bowl",
+    "plate",  "teapot", "jar",    "bell",   "sword",  "helmet",  "map",    "vinyl",  "radio",  "desk",
+    "shelf",  "quilt",  "jacket", "boots",  "bag",    "hat",     "scarf",  "toy",    "doll",   "puzzle",
+    "silver", "brass",  "oak",    "antique", "signed", "vintage", "rare",  "boxed",  "mint",   "restored",
+};
+constexpr int kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+const char *const kCategories[] = {
+    "art",   "books",  "cameras", "clocks", "coins",  "fashion", "furniture", "garden", "jewellery", "music",
+    "phones", "sports", "stamps", "toys",   "tools",  "vehicles", "watches",  "wine",   "computers", "other",
+};
+constexpr int kCategoryCount = sizeof(kCategories) / sizeof(kCategories[0]);
+
+constexpr qint64 kDayMs = 24 * 60 * 60 * 1000LL;
+constexpr int kSeedBatch = 50000;
+constexpr int kRepeats = 5;
+
+QString words(QRandomGenerator &random, int count)
+{
+    QStringList picked;
+    picked.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        picked.append(QLatin1String(kWords[random.bounded(kWordCount)]));
+    }
+    return picked.join(QLatin1Char(' '));
+}
+
+qint64 countAuctions(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    return query.exec(QStringLiteral("SELECT COALESCE(MAX(id), 0) FROM auctions")) && query.next()
+               ? query.value(0).toLongLong()
+               : -1;
+}
+
+// Appends auctions until the table holds `rows`. Goes through its own
+// connection with synchronous=OFF: the bench does not need the data to
+// survive a crash, only to exist.
+bool seed(QSqlDatabase &db, qint64 rows, qint64 nowMs, QTextStream &out)
+{
+    const qint64 existing = countAuctions(db);
+    if (existing < 0) {
+        return false;
+    }
+    if (existing >= rows) {
+        return true;
+    }
+
+    QSqlQuery pragma(db);
+    pragma.exec(QStringLiteral("PRAGMA synchronous=OFF"));
+    pragma.exec(QStringLiteral("INSERT OR IGNORE INTO users(id, full_name, email, password, phone) "
+                               "VALUES(1, 'Bench Seller', 'seller@bench', '', '')"));
+
+    QSqlQuery insert(db);
+    if (!insert.prepare(QStringLiteral(
+            "INSERT INTO auctions(id, seller_id, title, description, category, start_price, min_increment, "
+            "current_price, bid_count, status, created_at, ends_at) VALUES(?, 1, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"))) {
+        out << "prepare failed: " << insert.lastError().text() << '\n';
+        return false;
+    }
+
+    // Fixed seed: the same --rows gives the same catalog on every machine.
+    QRandomGenerator random(static_cast<quint32>(existing) + 1);
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 id = existing + 1; id <= rows;) {
+        db.transaction();
+        for (int n = 0; n < kSeedBatch && id <= rows; ++n, ++id) {
+            const qint64 startPrice = 1000 * (1 + random.bounded(500));
+            const int bids = random.bounded(20);
+            // A fifth have already ended; the rest end within a month.
+            const qint64 endsAt = nowMs + 1000LL * random.bounded(-7 * 86400, 30 * 86400);
+            insert.addBindValue(id);
+            insert.addBindValue(words(random, 3) + QStringLiteral(" #") + QString::number(id));
+            insert.addBindValue(words(random, 12));
+            insert.addBindValue(QLatin1String(kCategories[random.bounded(kCategoryCount)]));
+            insert.addBindValue(startPrice);
+            insert.addBindValue(100);
+            insert.addBindValue(startPrice + bids * 100);
+            insert.addBindValue(bids);
+            insert.addBindValue(endsAt > nowMs ? QStringLiteral("open") : QStringLiteral("closed"));
+            insert.addBindValue(nowMs - 30 * kDayMs + id);
+            insert.addBindValue(endsAt);
+            if (!insert.exec()) {
+                out << "insert failed: " << insert.lastError().text() << '\n';
+                db.rollback();
+                return false;
+            }
+        }
+        db.commit();
+    }
+    out << QStringLiteral("{\"seeded\":%1,\"seconds\":%2}\n")
+               .arg(rows - existing)
+               .arg(timer.nsecsElapsed() / 1e9, 0, 'f', 1);
+    out.flush();
+    return true;
+}
+
+struct Scenario
+{
+    QString name;
+    AuctionSearch search;
+    // The same query without a cursor; pages are cut with LIMIT/OFFSET.
+    QString offsetSql;
+};
+
+double medianMs(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples.empty() ? 0.0 : samples[samples.size() / 2];
+}
+
+double timeSearch(const Database &database, const AuctionSearch &search, QVector<AuctionRecord> &page)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < kRepeats; ++i) {
+        page.clear();
+        QElapsedTimer timer;
+        timer.start();
+        if (!database.searchAuctions(search, page)) {
+            return -1.0;
+        }
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    return medianMs(samples);
+}
+
+double timeOffset(QSqlDatabase &db, const QString &sql)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < kRepeats; ++i) {
+        QSqlQuery query(db);
+        QElapsedTimer timer;
+        timer.start();
+        if (!query.exec(sql)) {
+            return -1.0;
+        }
+        while (query.next()) {
+        }
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    return medianMs(samples);
+}
+
+bool isCheckpoint(int page, int lastPage)
+{
+    return page == 1 || page == 10 || page == 100 || page == 1000 || page == lastPage;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption dbOption(QStringLiteral("db"), QStringLiteral("SQLite file, reused between runs."),
+                                      QStringLiteral("path"), QStringLiteral("search_bench.sqlite"));
+    const QCommandLineOption rowsOption(QStringLiteral("rows"), QStringLiteral("Auctions to seed."),
+                                        QStringLiteral("n"), QStringLiteral("2000000"));
+    const QCommandLineOption pagesOption(QStringLiteral("pages"), QStringLiteral("Pages walked per scenario."),
+                                         QStringLiteral("n"), QStringLiteral("1000"));
+    const QCommandLineOption limitOption(QStringLiteral("limit"), QStringLiteral("Rows per page."),
+                                         QStringLiteral("n"), QStringLiteral("50"));
+    parser.addOption(dbOption);
+    parser.addOption(rowsOption);
+    parser.addOption(pagesOption);
+    parser.addOption(limitOption);
+    parser.process(app);
+
+    const QString path = parser.value(dbOption);
+    const qint64 rows = qMax<qint64>(1, parser.value(rowsOption).toLongLong());
+    const int pages = qMax(1, parser.value(pagesOption).toInt());
+    const int limit = qBound(1, parser.value(limitOption).toInt(), 100);
+    QTextStream out(stdout);
+
+    Database database;
+    if (!database.open(path) || !database.migrate()) {
+        out << "cannot open " << path << '\n';
+        return 1;
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("search_bench"));
+    db.setDatabaseName(path);
+    if (!db.open()) {
+        out << "cannot open " << path << ": " << db.lastError().text() << '\n';
+        return 1;
+    }
+    // ends_at is relative to the first seeding, so reruns keep the same open/closed split.
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    {
+        QSqlQuery query(db);
+        if (query.exec(QStringLiteral("SELECT MIN(created_at) FROM auctions")) && query.next()
+            && !query.value(0).isNull()) {
+            nowMs = query.value(0).toLongLong() + 30 * kDayMs - 1;
+        }
+    }
+    if (!seed(db, rows, nowMs, out)) {
+        return 1;
+    }
+    QSqlQuery(db).exec(QStringLiteral("ANALYZE"));
+
+    const QString columns = QStringLiteral("id, title, category, start_price, min_increment, current_price, "
+                                           "leader_id, bid_count, ends_at, status");
+    std::vector<Scenario> scenarios;
+    {
+        Scenario newest;
+        newest.name = QStringLiteral("newest");
+        newest.offsetSql = QStringLiteral("SELECT %1 FROM auctions WHERE status = 'open' ORDER BY id DESC")
+                               .arg(columns);
+        scenarios.push_back(newest);
+
+        Scenario category = newest;
+        category.name = QStringLiteral("category_newest");
+        category.search.category = QStringLiteral("clocks");
+        category.offsetSql = QStringLiteral("SELECT %1 FROM auctions WHERE category = 'clocks' AND status = 'open' "
+                                            "ORDER BY id DESC")
+                                 .arg(columns);
+        scenarios.push_back(category);
+
+        Scenario ending;
+        ending.name = QStringLiteral("ending_soon");
+        ending.search.order = AuctionSearch::Order::EndingSoon;
+        ending.offsetSql = QStringLiteral("SELECT %1 FROM auctions WHERE status = 'open' ORDER BY ends_at, id")
+                               .arg(columns);
+        scenarios.push_back(ending);
+
+        Scenario text = newest;
+        text.name = QStringLiteral("text");
+        text.search.match = QStringLiteral("\"lamp\"*");
+        text.offsetSql = QStringLiteral("SELECT a.%1 FROM auctions_fts CROSS JOIN auctions AS a "
+                                        "ON a.id = auctions_fts.rowid WHERE auctions_fts MATCH '\"lamp\"*' "
+                                        "AND a.status = 'open' ORDER BY auctions_fts.rowid DESC")
+                            .arg(QString(columns).replace(QStringLiteral(", "), QStringLiteral(", a.")));
+        scenarios.push_back(text);
+    }
+
+    for (Scenario &scenario : scenarios) {
+        scenario.search.limit = limit;
+        AuctionSearch search = scenario.search;
+        QVector<AuctionRecord> page;
+        for (int number = 1; number <= pages; ++number) {
+            double keysetMs = 0.0;
+            if (isCheckpoint(number, pages)) {
+                keysetMs = timeSearch(database, search, page);
+            } else {
+                page.clear();
+                keysetMs = database.searchAuctions(search, page) ? 0.0 : -1.0;
+            }
+            if (keysetMs < 0) {
+                out << "search failed in " << scenario.name << '\n';
+                return 1;
+            }
+            if (isCheckpoint(number, pages)) {
+                const QString sql = scenario.offsetSql
+                                    + QStringLiteral(" LIMIT %1 OFFSET %2").arg(limit).arg(qint64(number - 1) * limit);
+                out << QStringLiteral("{\"scenario\":\"%1\",\"rows\":%2,\"page\":%3,\"keyset_ms\":%4,\"offset_ms\":%5}\n")
+                           .arg(scenario.name)
+                           .arg(rows)
+                           .arg(number)
+                           .arg(keysetMs, 0, 'f', 3)
+                           .arg(timeOffset(db, sql), 0, 'f', 3);
+                out.flush();
+            }
+            if (page.size() < limit) {
+                break; // ran out of matches; the last full page was reported if it was a checkpoint
+            }
+            // The next page starts after this one's last row.
+            search.afterId = page.constLast().id;
+            search.afterEndsAtMs = page.constLast().endsAtMs;
+        }
+    }
+    return 0;
+}
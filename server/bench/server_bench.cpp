@@ -0,0 +1,599 @@
+// Load generator for a running server_app. Opens many connections spread over
+// a few client threads, sends a weighted mix of PING / LOGIN / REGISTER / bid
+// requests with the client's own frame builders, and prints one JSON object
+// with throughput, latency percentiles and error counts.
+//
+// closed loop: every connection keeps --depth requests outstanding and sends
+//   the next one as soon as a reply arrives. Measures capacity.
+// open loop: requests go out on a fixed schedule (--rate per second across all
+//   connections) whether or not earlier ones were answered, and latency is
+//   taken from the scheduled send time, so a stalled server shows up in the
+//   tail instead of quietly lowering the offered load.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "network/Protocol.h"
+
+namespace {
+enum class Kind
+{
+    Ping,
+    Login,
+    Register,
+    Bid,
+    Count
+};
+
+constexpr int kKindCount = static_cast<int>(Kind::Count);
+const char *const kKindNames[kKindCount] = {"PING", "LOGIN", "REGISTER", "PLACE_BID"};
+
+struct Config
+{
+    QString host;
+    quint16 port = 5555;
+    bool openLoop = false;
+    int connections = 1000;
+    int threads = 1;
+    double rate = 10000;
+    int depth = 1;
+    qint64 durationNs = 0;
+    qint64 warmupNs = 0;
+    int protocol = 2;
+    std::array<int, kKindCount> weights{};
+    int totalWeight = 0;
+
+    // Filled in by setup().
+    QString email;
+    QString password;
+    QString bidderToken;
+    std::vector<qint64> auctionIds;
+    qint64 runId = 0;
+};
+
+struct Stats
+{
+    std::vector<qint64> latenciesNs;
+    std::array<qint64, kKindCount> sent{};
+    std::array<qint64, kKindCount> ok{};
+    std::array<qint64, kKindCount> failed{};
+    qint64 completed = 0;
+    qint64 transportErrors = 0;
+    qint64 timedOut = 0;
+    int connected = 0;
+};
+
+struct Pending
+{
+    Kind kind;
+    qint64 startNs;
+};
+
+struct Connection
+{
+    QTcpSocket *socket = nullptr;
+    FrameDecoder decoder;
+    int version = 1;
+    quint64 helloId = 0;
+    quint64 nextRequestId = 1;
+    bool ready = false;
+    bool dead = false;
+    QHash<quint64, Pending> pending;
+};
+
+std::atomic<qint64> nextBidAmount{1};
+
+// Blocking request/response on a fresh text-protocol socket, used for setup only.
+bool roundTrip(QTcpSocket &socket, FrameDecoder &decoder, const Protocol::Frame &request, Protocol::Frame &reply)
+{
+    socket.write(Protocol::encodeFrame(request, 1));
+    RawFrame raw;
+    while (true) {
+        const FrameDecoder::Status status = decoder.next(raw);
+        if (status == FrameDecoder::Status::Ready) {
+            reply = Protocol::parseFrame(raw);
+            if (reply.requestId == request.requestId) {
+                return true;
+            }
+            continue; // a push
+        }
+        if (status == FrameDecoder::Status::Malformed || !socket.waitForReadyRead(10000)) {
+            return false;
+        }
+        decoder.append(socket.readAll());
+    }
+}
+
+QString replyToken(const Protocol::Frame &reply)
+{
+    return Protocol::parseLoginResponse(reply).token;
+}
+
+// Creates the bench accounts and auctions the LOGIN and bid mixes need.
+bool setup(Config &config, int auctionCount)
+{
+    QTcpSocket socket;
+    socket.connectToHost(config.host, config.port);
+    if (!socket.waitForConnected(5000)) {
+        qWarning("setup: cannot connect to %s:%hu", qPrintable(config.host), config.port);
+        return false;
+    }
+
+    if (config.weights[static_cast<int>(Kind::Login)] == 0 && config.weights[static_cast<int>(Kind::Bid)] == 0) {
+        return true;
+    }
+
+    FrameDecoder decoder;
+    Protocol::Frame reply;
+    quint64 reqId = 1;
+
+    // Registering an existing account just fails, which is fine on reruns.
+    const QString sellerEmail = QStringLiteral("seller+") + config.email;
+    for (const QString &email : {sellerEmail, config.email}) {
+        User user;
+        user.fullName = QStringLiteral("bench");
+        user.email = email;
+        user.password = config.password;
+        if (!roundTrip(socket, decoder, Protocol::makeRegisterRequest(reqId++, user), reply)) {
+            return false;
+        }
+    }
+
+    if (!roundTrip(socket, decoder, Protocol::makeLoginRequest(reqId++, config.email, config.password), reply)) {
+        return false;
+    }
+    config.bidderToken = replyToken(reply);
+    if (config.bidderToken.isEmpty()) {
+        qWarning("setup: login as %s failed", qPrintable(config.email));
+        return false;
+    }
+    if (config.weights[static_cast<int>(Kind::Bid)] == 0) {
+        return true;
+    }
+
+    if (!roundTrip(socket, decoder, Protocol::makeLoginRequest(reqId++, sellerEmail, config.password), reply)) {
+        return false;
+    }
+    const QString sellerToken = replyToken(reply);
+    for (int i = 0; i < auctionCount; ++i) {
+        const QString title = QStringLiteral("bench %1 #%2").arg(config.runId).arg(i);
+        const Protocol::Frame create = Protocol::makeCreateAuctionRequest(reqId++, sellerToken, title, 1, 1,
+                                                                          30ll * 24 * 3600);
+        if (!roundTrip(socket, decoder, create, reply) || reply.command != QLatin1String("CREATE_AUCTION_OK")) {
+            qWarning("setup: CREATE_AUCTION failed: %s", qPrintable(reply.payload.toCborValue().toDiagnosticNotation()));
+            return false;
+        }
+        config.auctionIds.push_back(reply.payload.value(QStringLiteral("auctionId")).toInteger());
+    }
+    return true;
+}
+
+// Runs one thread's share of the connections until the test ends.
+class LoadWorker
+{
+public:
+    LoadWorker(const Config &config, int index, int connectionCount, std::atomic<int> &readyThreads, int threadCount)
+        : config(config)
+        , index(index)
+        , readyThreads(readyThreads)
+        , threadCount(threadCount)
+        , rng(static_cast<quint32>(index + 1))
+        , connections(static_cast<size_t>(connectionCount))
+        , ratePerThread(config.rate / threadCount)
+    {
+    }
+
+    Stats run()
+    {
+        QEventLoop loop;
+        for (Connection &connection : connections) {
+            open(connection);
+        }
+
+        // Wait for every connection (on every thread) to finish HELLO.
+        QElapsedTimer setupTimer;
+        setupTimer.start();
+        while (readyCount < static_cast<int>(connections.size()) && setupTimer.elapsed() < 15000) {
+            loop.processEvents(QEventLoop::WaitForMoreEvents, 50);
+        }
+        stats.connected = readyCount;
+        readyThreads.fetch_add(1);
+        while (readyThreads.load() < threadCount) {
+            loop.processEvents(QEventLoop::AllEvents, 1);
+        }
+
+        clock.start();
+        if (!config.openLoop) {
+            for (Connection &connection : connections) {
+                for (int i = 0; i < config.depth; ++i) {
+                    send(connection, clock.nsecsElapsed());
+                }
+            }
+        }
+
+        QTimer ticker;
+        ticker.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&ticker, &QTimer::timeout, [&]() { tick(loop); });
+        ticker.start(1);
+        loop.exec();
+
+        for (Connection &connection : connections) {
+            stats.timedOut += connection.pending.size();
+            delete connection.socket;
+        }
+        return stats;
+    }
+
+private:
+    void open(Connection &connection)
+    {
+        connection.socket = new QTcpSocket();
+        Connection *c = &connection;
+        QObject::connect(c->socket, &QTcpSocket::connected, [this, c]() {
+            c->helloId = c->nextRequestId++;
+            c->socket->write(Protocol::encodeFrame(Protocol::makeHello(c->helloId, config.protocol), 1));
+        });
+        QObject::connect(c->socket, &QTcpSocket::readyRead, [this, c]() { onReadyRead(*c); });
+        QObject::connect(c->socket, &QTcpSocket::errorOccurred, [this, c]() {
+            if (!c->dead) {
+                c->dead = true;
+                ++stats.transportErrors;
+            }
+        });
+        c->socket->connectToHost(config.host, config.port);
+    }
+
+    void onReadyRead(Connection &c)
+    {
+        c.decoder.append(c.socket->readAll());
+        RawFrame raw;
+        FrameDecoder::Status status;
+        while ((status = c.decoder.next(raw)) == FrameDecoder::Status::Ready) {
+            const quint64 requestId = raw.requestId;
+            if (requestId == 0) {
+                continue; // PRICE_UPDATE and other pushes
+            }
+            if (!c.ready && requestId == c.helloId) {
+                const Protocol::Frame reply = Protocol::parseFrame(raw);
+                if (reply.command == QLatin1String("HELLO_OK") && config.protocol >= 2) {
+                    c.version = 2;
+                    c.decoder.setMode(FrameDecoder::Mode::Binary);
+                }
+                c.ready = true;
+                ++readyCount;
+                continue;
+            }
+            complete(c, raw);
+        }
+        if (status == FrameDecoder::Status::Malformed) {
+            c.dead = true;
+            ++stats.transportErrors;
+            c.socket->abort();
+        }
+    }
+
+    void complete(Connection &c, const RawFrame &raw)
+    {
+        const auto it = c.pending.constFind(raw.requestId);
+        if (it == c.pending.cend()) {
+            return;
+        }
+        const Pending request = it.value();
+        c.pending.erase(it);
+
+        const qint64 now = clock.nsecsElapsed();
+        const int kind = static_cast<int>(request.kind);
+        // Only the command name is needed to classify the reply.
+        const QByteArray name = raw.binary
+            ? BinaryProtocol::commandName(static_cast<BinaryProtocol::Command>(raw.commandId))
+            : QByteArray(raw.command.constData(), raw.command.size());
+        if (name.endsWith("_OK") || name == "PONG") {
+            ++stats.ok[kind];
+        } else {
+            ++stats.failed[kind];
+        }
+        if (request.startNs >= config.warmupNs && request.startNs < config.durationNs) {
+            stats.latenciesNs.push_back(now - request.startNs);
+            ++stats.completed;
+        }
+
+        if (!config.openLoop && now < config.durationNs) {
+            send(c, now);
+        }
+    }
+
+    void tick(QEventLoop &loop)
+    {
+        const qint64 now = clock.nsecsElapsed();
+        if (now >= config.durationNs) {
+            bool idle = true;
+            for (const Connection &connection : connections) {
+                if (!connection.dead && !connection.pending.isEmpty()) {
+                    idle = false;
+                    break;
+                }
+            }
+            // Give stragglers two seconds, then count them as timeouts.
+            if (idle || now >= config.durationNs + 2000000000ll) {
+                loop.quit();
+            }
+            return;
+        }
+        if (!config.openLoop) {
+            return;
+        }
+
+        const qint64 due = static_cast<qint64>(now / 1e9 * ratePerThread);
+        while (issued < due) {
+            const qint64 scheduledNs = static_cast<qint64>(issued * 1e9 / ratePerThread);
+            ++issued;
+            Connection *target = nextReadyConnection();
+            if (!target) {
+                break;
+            }
+            send(*target, scheduledNs);
+        }
+    }
+
+    Connection *nextReadyConnection()
+    {
+        for (size_t tries = 0; tries < connections.size(); ++tries) {
+            Connection &connection = connections[roundRobin++ % connections.size()];
+            if (connection.ready && !connection.dead) {
+                return &connection;
+            }
+        }
+        return nullptr;
+    }
+
+    Kind pickKind()
+    {
+        int roll = static_cast<int>(rng.bounded(config.totalWeight));
+        for (int i = 0; i < kKindCount; ++i) {
+            roll -= config.weights[i];
+            if (roll < 0) {
+                return static_cast<Kind>(i);
+            }
+        }
+        return Kind::Ping;
+    }
+
+    void send(Connection &c, qint64 startNs)
+    {
+        if (!c.ready || c.dead) {
+            return;
+        }
+        const Kind kind = pickKind();
+        const quint64 reqId = c.nextRequestId++;
+        Protocol::Frame frame;
+        switch (kind) {
+        case Kind::Ping:
+            frame = Protocol::makePing(reqId);
+            break;
+        case Kind::Login:
+            frame = Protocol::makeLoginRequest(reqId, config.email, config.password);
+            break;
+        case Kind::Register: {
+            User user;
+            user.fullName = QStringLiteral("bench");
+            user.email = QStringLiteral("bench-%1-%2-%3@load.test").arg(config.runId).arg(index).arg(++registered);
+            user.password = config.password;
+            frame = Protocol::makeRegisterRequest(reqId, user);
+            break;
+        }
+        case Kind::Bid: {
+            const qint64 auctionId = config.auctionIds[rng.bounded(static_cast<quint32>(config.auctionIds.size()))];
+            frame = Protocol::makePlaceBidRequest(reqId, config.bidderToken, auctionId, nextBidAmount.fetch_add(1));
+            break;
+        }
+        case Kind::Count:
+            return;
+        }
+
+        c.pending.insert(reqId, Pending{kind, startNs});
+        ++stats.sent[static_cast<int>(kind)];
+        c.socket->write(Protocol::encodeFrame(frame, c.version));
+    }
+
+    const Config &config;
+    const int index;
+    std::atomic<int> &readyThreads;
+    const int threadCount;
+    QRandomGenerator rng;
+    std::vector<Connection> connections;
+    const double ratePerThread;
+    QElapsedTimer clock;
+    Stats stats;
+    int readyCount = 0;
+    qint64 issued = 0;
+    size_t roundRobin = 0;
+    qint64 registered = 0;
+};
+
+bool parseMix(const QString &text, Config &config)
+{
+    for (const QString &part : text.split(',', Qt::SkipEmptyParts)) {
+        const QStringList pair = part.split(':');
+        bool ok = false;
+        const int weight = pair.value(1).toInt(&ok);
+        if (pair.size() != 2 || !ok || weight < 0) {
+            return false;
+        }
+        const QString name = pair.at(0).trimmed().toLower();
+        const int kind = name == QLatin1String("ping")       ? 0
+                         : name == QLatin1String("login")    ? 1
+                         : name == QLatin1String("register") ? 2
+                         : name == QLatin1String("bid")      ? 3
+                                                             : -1;
+        if (kind < 0) {
+            return false;
+        }
+        config.weights[kind] = weight;
+    }
+    config.totalWeight = 0;
+    for (int weight : config.weights) {
+        config.totalWeight += weight;
+    }
+    return config.totalWeight > 0;
+}
+
+double percentileUs(const std::vector<qint64> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[rank] / 1000.0;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption hostOption(QStringLiteral("host"), QStringLiteral("Server address."),
+                                        QStringLiteral("host"), QStringLiteral("127.0.0.1"));
+    const QCommandLineOption portOption(QStringLiteral("port"), QStringLiteral("Server port."),
+                                        QStringLiteral("port"), QStringLiteral("5555"));
+    const QCommandLineOption modeOption(QStringLiteral("mode"), QStringLiteral("closed or open loop."),
+                                        QStringLiteral("mode"), QStringLiteral("closed"));
+    const QCommandLineOption connectionsOption(QStringLiteral("connections"), QStringLiteral("Concurrent connections."),
+                                               QStringLiteral("n"), QStringLiteral("1000"));
+    const QCommandLineOption threadsOption(QStringLiteral("threads"), QStringLiteral("Client threads."),
+                                           QStringLiteral("n"), QString::number(qMax(1, QThread::idealThreadCount() / 2)));
+    const QCommandLineOption rateOption(QStringLiteral("rate"), QStringLiteral("Open loop: requests per second in total."),
+                                        QStringLiteral("n"), QStringLiteral("10000"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"), QStringLiteral("Closed loop: outstanding requests per connection."),
+                                         QStringLiteral("n"), QStringLiteral("1"));
+    const QCommandLineOption secondsOption(QStringLiteral("seconds"), QStringLiteral("Measured duration."),
+                                           QStringLiteral("s"), QStringLiteral("10"));
+    const QCommandLineOption warmupOption(QStringLiteral("warmup"), QStringLiteral("Seconds excluded from the results."),
+                                          QStringLiteral("s"), QStringLiteral("1"));
+    const QCommandLineOption mixOption(QStringLiteral("mix"), QStringLiteral("Request weights, e.g. ping:50,bid:40,login:8,register:2."),
+                                       QStringLiteral("mix"), QStringLiteral("ping:50,bid:40,login:8,register:2"));
+    const QCommandLineOption auctionsOption(QStringLiteral("auctions"), QStringLiteral("Auctions the bid mix spreads over."),
+                                            QStringLiteral("n"), QStringLiteral("16"));
+    const QCommandLineOption protocolOption(QStringLiteral("protocol"), QStringLiteral("1 = text, 2 = binary (negotiated)."),
+                                            QStringLiteral("n"), QStringLiteral("2"));
+    const QCommandLineOption userOption(QStringLiteral("user"), QStringLiteral("Account used by LOGIN and bids."),
+                                        QStringLiteral("email"), QStringLiteral("bench@load.test"));
+    for (const QCommandLineOption *option : {&hostOption, &portOption, &modeOption, &connectionsOption, &threadsOption,
+                                             &rateOption, &depthOption, &secondsOption, &warmupOption, &mixOption,
+                                             &auctionsOption, &protocolOption, &userOption}) {
+        parser.addOption(*option);
+    }
+    parser.process(app);
+
+    Config config;
+    config.host = parser.value(hostOption);
+    config.port = static_cast<quint16>(parser.value(portOption).toUInt());
+    config.openLoop = parser.value(modeOption) == QLatin1String("open");
+    config.connections = qMax(1, parser.value(connectionsOption).toInt());
+    config.threads = qBound(1, parser.value(threadsOption).toInt(), config.connections);
+    config.rate = qMax(1.0, parser.value(rateOption).toDouble());
+    config.depth = qMax(1, parser.value(depthOption).toInt());
+    config.warmupNs = qMax(0ll, parser.value(warmupOption).toLongLong()) * 1000000000ll;
+    config.durationNs = config.warmupNs + qMax(1ll, parser.value(secondsOption).toLongLong()) * 1000000000ll;
+    config.protocol = parser.value(protocolOption).toInt();
+    config.email = parser.value(userOption);
+    config.password = QStringLiteral("bench-password");
+    config.runId = QDateTime::currentMSecsSinceEpoch();
+    if (!parseMix(parser.value(mixOption), config)) {
+        qCritical("Invalid --mix");
+        return 1;
+    }
+    if (!setup(config, qMax(1, parser.value(auctionsOption).toInt()))) {
+        return 1;
+    }
+
+    std::atomic<int> readyThreads{0};
+    std::vector<Stats> results(static_cast<size_t>(config.threads));
+    std::vector<QThread *> threads;
+    for (int i = 0; i < config.threads; ++i) {
+        const int share = config.connections / config.threads + (i < config.connections % config.threads ? 1 : 0);
+        threads.push_back(QThread::create([&config, &readyThreads, &results, i, share]() {
+            LoadWorker worker(config, i, share, readyThreads, config.threads);
+            results[static_cast<size_t>(i)] = worker.run();
+        }));
+        threads.back()->start();
+    }
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    Stats total;
+    for (Stats &stats : results) {
+        total.latenciesNs.insert(total.latenciesNs.end(), stats.latenciesNs.begin(), stats.latenciesNs.end());
+        for (int i = 0; i < kKindCount; ++i) {
+            total.sent[i] += stats.sent[i];
+            total.ok[i] += stats.ok[i];
+            total.failed[i] += stats.failed[i];
+        }
+        total.completed += stats.completed;
+        total.transportErrors += stats.transportErrors;
+        total.timedOut += stats.timedOut;
+        total.connected += stats.connected;
+    }
+    std::sort(total.latenciesNs.begin(), total.latenciesNs.end());
+
+    const double seconds = (config.durationNs - config.warmupNs) / 1e9;
+    QJsonObject commands;
+    qint64 failed = 0;
+    for (int i = 0; i < kKindCount; ++i) {
+        if (total.sent[i] == 0) {
+            continue;
+        }
+        QJsonObject row;
+        row.insert(QStringLiteral("sent"), total.sent[i]);
+        row.insert(QStringLiteral("ok"), total.ok[i]);
+        row.insert(QStringLiteral("failed"), total.failed[i]);
+        commands.insert(QString::fromLatin1(kKindNames[i]), row);
+        failed += total.failed[i];
+    }
+
+    QJsonObject result;
+    result.insert(QStringLiteral("mode"), config.openLoop ? QStringLiteral("open") : QStringLiteral("closed"));
+    result.insert(QStringLiteral("connections"), config.connections);
+    result.insert(QStringLiteral("connected"), total.connected);
+    result.insert(QStringLiteral("threads"), config.threads);
+    if (config.openLoop) {
+        result.insert(QStringLiteral("rate"), config.rate);
+    } else {
+        result.insert(QStringLiteral("depth"), config.depth);
+    }
+    result.insert(QStringLiteral("protocol"), config.protocol);
+    result.insert(QStringLiteral("seconds"), seconds);
+    result.insert(QStringLiteral("requests"), total.completed);
+    result.insert(QStringLiteral("rps"), qRound64(total.completed / seconds));
+    result.insert(QStringLiteral("p50Us"), percentileUs(total.latenciesNs, 0.50));
+    result.insert(QStringLiteral("p99Us"), percentileUs(total.latenciesNs, 0.99));
+    result.insert(QStringLiteral("p999Us"), percentileUs(total.latenciesNs, 0.999));
+    result.insert(QStringLiteral("maxUs"), total.latenciesNs.empty() ? 0.0 : total.latenciesNs.back() / 1000.0);
+    result.insert(QStringLiteral("failed"), failed);
+    result.insert(QStringLiteral("transportErrors"), total.transportErrors);
+    result.insert(QStringLiteral("timeouts"), total.timedOut);
+    result.insert(QStringLiteral("commands"), commands);
+
+    QTextStream out(stdout);
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include "ConnectionPool.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QSqlError>
+#include <QStringList>
+#include <QThread>
+
+#include <utility>
+
+namespace {
+QAtomicInt nextPoolId;
+
+// Indexed by Statement.
+const char *const kStatementSql[] = {
+    "SELECT COUNT(1) FROM users WHERE email = :email",
+    "INSERT INTO users(full_name, email, password, phone) VALUES(:full_name, :email, :password, :phone)",
+    "SELECT id, password FROM users WHERE email = :email LIMIT 1",
+    "UPDATE users SET password = :password WHERE id = :id",
+    "INSERT INTO auctions(id, seller_id, title, description, category, start_price, min_increment, current_price, "
+    "created_at, ends_at) VALUES(:id, :seller_id, :title, :description, :category, :start_price, :min_increment, "
+    ":current_price, :created_at, :ends_at)",
+    "INSERT INTO bids(auction_id, bidder_id, amount, placed_at) VALUES(:auction_id, :bidder_id, :amount, :placed_at)",
+    "UPDATE auctions SET current_price = :current_price, leader_id = :leader_id, bid_count = :bid_count "
+    "WHERE id = :id",
+    "UPDATE auctions SET status = 'closed' WHERE id = :id",
+    "SELECT id, seller_id, title, description, start_price, min_increment, current_price, leader_id, bid_count, "
+    "created_at, ends_at, category, status FROM auctions WHERE id = :id",
+    "SELECT bidder_id, amount, placed_at FROM bids WHERE auction_id = :auction_id ORDER BY id DESC LIMIT :limit",
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions WHERE id < :before_id ORDER BY id DESC LIMIT :limit",
+    // Search: INDEXED BY pins each order to its keyset index (see 0002_auction_search.sql).
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_status_newest WHERE status = :status AND id < :before_id "
+    "AND ends_at >= :ends_after AND ends_at < :ends_before ORDER BY id DESC LIMIT :limit",
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_category_newest WHERE category = :category AND status = :status "
+    "AND id < :before_id AND ends_at >= :ends_after AND ends_at < :ends_before ORDER BY id DESC LIMIT :limit",
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_status_ending WHERE status = :status "
+    "AND (ends_at, id) > (:after_ends_at, :after_id) AND ends_at < :ends_before ORDER BY ends_at, id LIMIT :limit",
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_category_ending WHERE category = :category AND status = :status "
+    "AND (ends_at, id) > (:after_ends_at, :after_id) AND ends_at < :ends_before ORDER BY ends_at, id LIMIT :limit",
+    // CROSS JOIN keeps the FTS table outermost: it walks matches by rowid from the cursor.
+    "SELECT a.id, a.title, a.category, a.start_price, a.min_increment, a.current_price, a.leader_id, a.bid_count, "
+    "a.ends_at, a.status "
+    "FROM auctions_fts CROSS JOIN auctions AS a ON a.id = auctions_fts.rowid WHERE auctions_fts MATCH :query "
+    "AND auctions_fts.rowid < :before_id AND a.status = :status AND a.ends_at >= :ends_after "
+    "AND a.ends_at < :ends_before ORDER BY auctions_fts.rowid DESC LIMIT :limit",
+    "SELECT a.id, a.title, a.category, a.start_price, a.min_increment, a.current_price, a.leader_id, a.bid_count, "
+    "a.ends_at, a.status "
+    "FROM auctions_fts CROSS JOIN auctions AS a ON a.id = auctions_fts.rowid WHERE auctions_fts MATCH :query "
+    "AND auctions_fts.rowid < :before_id AND a.category = :category AND a.status = :status "
+    "AND a.ends_at >= :ends_after AND a.ends_at < :ends_before ORDER BY auctions_fts.rowid DESC LIMIT :limit",
+    // Newest order over the few open rows already past their end: the ending
+    // index seeks to just those, where the newest one would walk every open row.
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_status_ending WHERE status = :status "
+    "AND ends_at >= :ends_after AND ends_at < :ends_before AND id < :before_id ORDER BY id DESC LIMIT :limit",
+    "SELECT id, title, category, start_price, min_increment, current_price, leader_id, bid_count, ends_at, status "
+    "FROM auctions INDEXED BY idx_auctions_category_ending WHERE category = :category AND status = :status "
+    "AND ends_at >= :ends_after AND ends_at < :ends_before AND id < :before_id ORDER BY id DESC LIMIT :limit",
+    "BEGIN IMMEDIATE",
+    "COMMIT",
+    "ROLLBACK",
+    "SAVEPOINT write_item",
+    "RELEASE write_item",
+    "ROLLBACK TO write_item",
+};
+static_assert(sizeof(kStatementSql) / sizeof(kStatementSql[0]) == static_cast<size_t>(Statement::Count),
+              "every Statement needs its SQL");
+
+// Indexed by Statement.
+const char *const kStatementNames[] = {
+    "UserExists",
+    "InsertUser",
+    "FindCredentials",
+    "UpdatePassword",
+    "InsertAuction",
+    "InsertBid",
+    "UpdateAuctionPrice",
+    "CloseAuction",
+    "LoadAuction",
+    "LoadRecentBids",
+    "ListAuctions",
+    "SearchNewest",
+    "SearchNewestInCategory",
+    "SearchEndingSoon",
+    "SearchEndingSoonInCategory",
+    "SearchText",
+    "SearchTextInCategory",
+    "SearchEndedNewest",
+    "SearchEndedNewestInCategory",
+    "BeginBatch",
+    "CommitBatch",
+    "RollbackBatch",
+    "Savepoint",
+    "ReleaseSavepoint",
+    "RollbackToSavepoint",
+};
+static_assert(sizeof(kStatementNames) / sizeof(kStatementNames[0]) == static_cast<size_t>(Statement::Count),
+              "every Statement needs a name");
+
+// Per-thread fast path so acquire() only takes the pool mutex on first use.
+thread_local int cachedPoolId = -1;
+thread_local PooledConnection *cachedConnection = nullptr;
+} // namespace
+
+const char *statementName(Statement id)
+{
+    return kStatementNames[static_cast<size_t>(id)];
+}
+
+QSqlQuery *PooledConnection::statement(Statement id)
+{
+    const size_t index = static_cast<size_t>(id);
+    if (!statements[index]) {
+        auto *query = new QSqlQuery(db);
+        if (!query->prepare(QString::fromLatin1(kStatementSql[index]))) {
+            qWarning() << "prepare failed:" << query->lastError() << "for statement:" << kStatementSql[index];
+            delete query;
+            return nullptr;
+        }
+        statements[index] = query;
+    }
+    return statements[index];
+}
+
+ConnectionPool::ConnectionPool(const QString &path, const SqliteOptions &options)
+    : databasePath(path)
+    , sqliteOptions(options)
+    , poolId(nextPoolId.fetchAndAddRelaxed(1))
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    QThread *self = QThread::currentThread();
+    QMutexLocker locker(&mutex);
+    for (const QMetaObject::Connection &hook : std::as_const(finishedHooks)) {
+        QObject::disconnect(hook);
+    }
+    // Qt only lets the opening thread use or remove a connection, so the
+    // destroying thread closes its own and every other one must already be
+    // gone: those threads finished and released theirs through the hook.
+    Q_ASSERT_X(connections.size() == (connections.contains(self) ? 1 : 0), "~ConnectionPool",
+               "threads that used the pool must finish before it is destroyed");
+    closeConnection(connections.take(self));
+    if (!connections.isEmpty()) {
+        // Release builds leak them rather than touch another thread's connection.
+        qCritical("ConnectionPool destroyed while %d thread(s) still hold a connection",
+                  static_cast<int>(connections.size()));
+    }
+    connections.clear();
+    finishedHooks.clear();
+    if (cachedPoolId == poolId) {
+        cachedPoolId = -1;
+        cachedConnection = nullptr;
+    }
+}
+
+PooledConnection *ConnectionPool::acquire()
+{
+    if (cachedPoolId == poolId) {
+        return cachedConnection;
+    }
+
+    QThread *thread = QThread::currentThread();
+    {
+        QMutexLocker locker(&mutex);
+        if (PooledConnection *existing = connections.value(thread)) {
+            cachedPoolId = poolId;
+            cachedConnection = existing;
+            return existing;
+        }
+    }
+
+    PooledConnection *connection = openConnection();
+    if (!connection) {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&mutex);
+    connections.insert(thread, connection);
+    // finished is emitted on the thread itself, so the connection is closed where it was opened.
+    finishedHooks.insert(thread, QObject::connect(thread, &QThread::finished, thread, [this, thread]() {
+        release(thread);
+    }, Qt::DirectConnection));
+    cachedPoolId = poolId;
+    cachedConnection = connection;
+    return connection;
+}
+
+PooledConnection *ConnectionPool::openConnection()
+{
+    static QAtomicInt nextConnectionId;
+
+    auto *connection = new PooledConnection;
+    connection->name = QStringLiteral("pool%1_conn%2").arg(poolId).arg(nextConnectionId.fetchAndAddRelaxed(1));
+    connection->db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection->name);
+    connection->db.setDatabaseName(databasePath);
+    // Connections on different threads share the file; wait instead of failing with SQLITE_BUSY.
+    connection->db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(sqliteOptions.busyTimeoutMs));
+    if (!connection->db.open()) {
+        qWarning() << "Failed to open database:" << connection->db.lastError();
+        closeConnection(connection);
+        return nullptr;
+    }
+
+    const QStringList pragmas = {
+        QStringLiteral("PRAGMA journal_mode=%1").arg(sqliteOptions.journalMode),
+        QStringLiteral("PRAGMA synchronous=%1").arg(sqliteOptions.synchronous),
+        QStringLiteral("PRAGMA mmap_size=%1").arg(sqliteOptions.mmapSizeBytes),
+        // Negative cache_size is interpreted by SQLite as KiB rather than pages.
+        QStringLiteral("PRAGMA cache_size=-%1").arg(sqliteOptions.cacheSizeKb),
+        QStringLiteral("PRAGMA temp_store=MEMORY"),
+    };
+    QSqlQuery query(connection->db);
+    for (const QString &pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            qWarning() << "pragma failed:" << query.lastError() << "for statement:" << pragma;
+        }
+    }
+    return connection;
+}
+
+void ConnectionPool::release(QThread *thread)
+{
+    PooledConnection *connection = nullptr;
+    {
+        QMutexLocker locker(&mutex);
+        connection = connections.take(thread);
+        QObject::disconnect(finishedHooks.take(thread));
+    }
+    if (cachedPoolId == poolId) {
+        cachedPoolId = -1;
+        cachedConnection = nullptr;
+    }
+    closeConnection(connection);
+}
+
+void ConnectionPool::closeConnection(PooledConnection *connection)
+{
+    if (!connection) {
+        return;
+    }
+    for (QSqlQuery *&query : connection->statements) {
+        delete query;
+        query = nullptr;
+    }
+    const QString name = connection->name;
+    connection->db.close();
+    delete connection; // drops the last QSqlDatabase handle before removal
+    QSqlDatabase::removeDatabase(name);
+}
@@ -0,0 +1,105 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QHash>
+#include <QMetaObject>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+#include <array>
+
+class QThread;
+
+// Every SQL statement the server runs on the hot path. Each pooled connection
+// prepares them once and reuses the compiled statement for its lifetime.
+enum class Statement
+{
+    UserExists,
+    InsertUser,
+    FindCredentials,
+    UpdatePassword,
+    InsertAuction,
+    InsertBid,
+    UpdateAuctionPrice,
+    CloseAuction,
+    LoadAuction,
+    LoadRecentBids,
+    ListAuctions,
+    SearchNewest,
+    SearchNewestInCategory,
+    SearchEndingSoon,
+    SearchEndingSoonInCategory,
+    SearchText,
+    SearchTextInCategory,
+    SearchEndedNewest,
+    SearchEndedNewestInCategory,
+    BeginBatch,
+    CommitBatch,
+    RollbackBatch,
+    Savepoint,
+    ReleaseSavepoint,
+    RollbackToSavepoint,
+    Count
+};
+
+// Stable name for metrics and logs, e.g. "InsertUser".
+const char *statementName(Statement id);
+
+struct SqliteOptions
+{
+    QString journalMode = QStringLiteral("WAL");
+    QString synchronous = QStringLiteral("NORMAL");
+    qint64 mmapSizeBytes = 256ll * 1024 * 1024;
+    int cacheSizeKb = 64 * 1024;
+    int busyTimeoutMs = 5000;
+};
+
+class PooledConnection
+{
+public:
+    QSqlDatabase database() const { return db; }
+
+    // Returns the long-lived prepared query for id, or nullptr if preparing it failed.
+    QSqlQuery *statement(Statement id);
+
+private:
+    friend class ConnectionPool;
+
+    QString name;
+    QSqlDatabase db;
+    std::array<QSqlQuery *, static_cast<size_t>(Statement::Count)> statements{};
+};
+
+// One named SQLite connection per thread that touches the database. A
+// connection is opened lazily on first use and closed on the owning thread
+// when that thread finishes.
+class ConnectionPool
+{
+public:
+    ConnectionPool(const QString &path, const SqliteOptions &options);
+    // Closes the calling thread's connection. Every other thread that used
+    // the pool must have finished first (asserted).
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+    // Connection for the calling thread; nullptr if it could not be opened.
+    PooledConnection *acquire();
+
+private:
+    PooledConnection *openConnection();
+    void release(QThread *thread);
+    static void closeConnection(PooledConnection *connection);
+
+    const QString databasePath;
+    const SqliteOptions sqliteOptions;
+    const int poolId;
+    QMutex mutex;
+    QHash<QThread *, PooledConnection *> connections;
+    QHash<QThread *, QMetaObject::Connection> finishedHooks;
+};
+
+#endif // CONNECTIONPOOL_H
@@ -1,10 +1,163 @@
 #include "Database.h"
 
+#include "UserCache.h"
+#include "metrics/Metrics.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
+#include <QStringList>
 #include <QVariant>
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <utility>
+
+// Resources of a static library must be registered by hand; the macro only
+// works outside a namespace.
+static void initSchemaResource()
+{
+    Q_INIT_RESOURCE(schema);
+}
+
+namespace {
+bool isUniqueViolation(const QSqlError &error)
+{
+    // SQLITE_CONSTRAINT, or its extended UNIQUE / PRIMARYKEY codes, depending on the driver.
+    const QString code = error.nativeErrorCode();
+    return code == QLatin1String("2067") || code == QLatin1String("1555")
+           || (code == QLatin1String("19") && error.databaseText().contains(QLatin1String("UNIQUE")));
+}
+
+// Splits a script into single statements for QSqlQuery, which runs only the
+// first one it is given. A ';' inside quotes, comments or a CREATE TRIGGER
+// ... BEGIN ... END body does not end a statement. Comments are dropped.
+QStringList splitStatements(const QString &sql)
+{
+    QStringList statements;
+    QString current;
+    QString word;
+    bool inTrigger = false;
+    int blockDepth = 0; // BEGIN / CASE ... END nesting inside a trigger body
+
+    auto endWord = [&]() {
+        if (word.isEmpty()) {
+            return;
+        }
+        if (!inTrigger) {
+            inTrigger = word.compare(QLatin1String("TRIGGER"), Qt::CaseInsensitive) == 0
+                        && current.trimmed().startsWith(QLatin1String("CREATE"), Qt::CaseInsensitive);
+        } else if (word.compare(QLatin1String("BEGIN"), Qt::CaseInsensitive) == 0
+                   || word.compare(QLatin1String("CASE"), Qt::CaseInsensitive) == 0) {
+            ++blockDepth;
+        } else if (word.compare(QLatin1String("END"), Qt::CaseInsensitive) == 0) {
+            --blockDepth;
+        }
+        word.clear();
+    };
+
+    for (int i = 0; i < sql.size(); ++i) {
+        const QChar c = sql.at(i);
+        const QChar next = i + 1 < sql.size() ? sql.at(i + 1) : QChar();
+        if (c == QLatin1Char('\'') || c == QLatin1Char('"') || c == QLatin1Char('`') || c == QLatin1Char('[')) {
+            endWord();
+            const QChar close = c == QLatin1Char('[') ? QLatin1Char(']') : c;
+            const int end = sql.indexOf(close, i + 1);
+            const int stop = end < 0 ? sql.size() - 1 : end;
+            current += sql.mid(i, stop - i + 1); // a doubled quote simply reopens
+            i = stop;
+        } else if (c == QLatin1Char('-') && next == QLatin1Char('-')) {
+            endWord();
+            const int end = sql.indexOf(QLatin1Char('\n'), i);
+            i = end < 0 ? sql.size() : end;
+            current += QLatin1Char(' ');
+        } else if (c == QLatin1Char('/') && next == QLatin1Char('*')) {
+            endWord();
+            const int end = sql.indexOf(QLatin1String("*/"), i + 2);
+            i = end < 0 ? sql.size() : end + 1;
+            current += QLatin1Char(' ');
+        } else if (c.isLetterOrNumber() || c == QLatin1Char('_')) {
+            word += c;
+            current += c;
+        } else {
+            endWord();
+            if (c == QLatin1Char(';') && blockDepth <= 0) {
+                if (!current.trimmed().isEmpty()) {
+                    statements.append(current.trimmed());
+                }
+                current.clear();
+                inTrigger = false;
+                blockDepth = 0;
+            } else {
+                current += c;
+            }
+        }
+    }
+    endWord();
+    if (!current.trimmed().isEmpty()) {
+        statements.append(current.trimmed());
+    }
+    return statements;
+}
+
+Metrics::Histogram *statementLatency(Statement id)
+{
+    using Histograms = std::array<Metrics::Histogram *, static_cast<size_t>(Statement::Count)>;
+    static const Histograms histograms = []() {
+        Histograms out{};
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = Metrics::Registry::instance().histogram("auction_db_statement_seconds",
+                                                             "Execution time of each prepared SQL statement.",
+                                                             "statement", statementName(static_cast<Statement>(i)));
+        }
+        return out;
+    }();
+    return histograms[static_cast<size_t>(id)];
+}
+
+// The leading columns of loadOpenAuctions() and LoadAuction.
+AuctionRecord auctionRow(const QSqlQuery &query)
+{
+    AuctionRecord auction;
+    auction.id = query.value(0).toLongLong();
+    auction.sellerId = query.value(1).toLongLong();
+    auction.title = query.value(2).toString();
+    auction.description = query.value(3).toString();
+    auction.startPrice = query.value(4).toLongLong();
+    auction.minIncrement = query.value(5).toLongLong();
+    auction.currentPrice = query.value(6).toLongLong();
+    auction.leaderId = query.value(7).toLongLong();
+    auction.bidCount = query.value(8).toInt();
+    auction.createdAtMs = query.value(9).toLongLong();
+    auction.endsAtMs = query.value(10).toLongLong();
+    auction.category = query.value(11).toString();
+    return auction;
+}
+
+// The column list shared by ListAuctions and the Search* statements. Rows
+// ending at or before now count as closed whatever their status says.
+AuctionRecord summaryRow(const QSqlQuery &query, qint64 now)
+{
+    AuctionRecord auction;
+    auction.id = query.value(0).toLongLong();
+    auction.title = query.value(1).toString();
+    auction.category = query.value(2).toString();
+    auction.startPrice = query.value(3).toLongLong();
+    auction.minIncrement = query.value(4).toLongLong();
+    auction.currentPrice = query.value(5).toLongLong();
+    auction.leaderId = query.value(6).toLongLong();
+    auction.bidCount = query.value(7).toInt();
+    auction.endsAtMs = query.value(8).toLongLong();
+    auction.open = query.value(9).toString() == QLatin1String("open") && auction.endsAtMs > now;
+    return auction;
+}
+} // namespace
+
 Database::Database()
 {
 }
@@ -14,16 +167,15 @@ Database::~Database()
     close();
 }
 
-bool Database::open(const QString &path)
+bool Database::open(const QString &path, const SqliteOptions &options)
 {
-    if (db.isOpen()) {
+    if (pool) {
         return true;
     }
 
-    db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
-    db.setDatabaseName(path);
-    if (!db.open()) {
-        qWarning() << "Failed to open database:" << db.lastError();
+    pool = std::make_unique<ConnectionPool>(path, options);
+    if (!pool->acquire()) {
+        pool.reset();
         return false;
     }
     return true;
@@ -31,81 +183,570 @@ bool Database::open(const QString &path)
 
 void Database::close()
 {
-    if (db.isOpen()) {
-        db.close();
+    userCache.reset();
+    pool.reset();
+}
+
+bool Database::enableUserCache(int capacity)
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection) {
+        return false;
+    }
+
+    QSqlQuery query(connection->database());
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT COUNT(1) FROM users")) || !query.next()) {
+        qWarning() << "enableUserCache failed:" << query.lastError();
+        return false;
+    }
+    // Headroom so signups after startup rarely need another filter layer.
+    const qint64 users = query.value(0).toLongLong();
+    auto cache = std::make_unique<UserCache>(capacity, qMax<qint64>(users * 2, 1 << 20));
+
+    if (!query.exec(QStringLiteral("SELECT email FROM users"))) {
+        qWarning() << "enableUserCache failed:" << query.lastError();
+        return false;
     }
+    while (query.next()) {
+        cache->noteInserted(query.value(0).toString());
+    }
+    userCache = std::move(cache);
+    qInfo("[SERVER] User cache: %lld account(s) indexed, %d cached", users, capacity);
+    return true;
+}
+
+QSqlQuery *Database::statement(Statement id) const
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    return connection ? connection->statement(id) : nullptr;
 }
 
 bool Database::userExists(const QString &email) const
 {
-    QSqlQuery query(db);
-    if (!query.prepare(QStringLiteral("SELECT COUNT(1) FROM users WHERE email = :email"))) {
-        qWarning() << "userExists prepare failed:" << query.lastError();
+    if (userCache) {
+        CachedCredentials cached;
+        if (!userCache->mightExist(email)) {
+            return false;
+        }
+        if (userCache->lookup(email, cached)) {
+            return true;
+        }
+    }
+
+    QSqlQuery *query = statement(Statement::UserExists);
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":email", email);
+    if (!exec(Statement::UserExists, query)) {
+        qWarning() << "userExists failed:" << query->lastError();
+        return false;
+    }
+    const bool exists = query->next() && query->value(0).toInt() > 0;
+    query->finish();
+    return exists;
+}
+
+bool Database::exec(Statement id, QSqlQuery *query) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = query->exec();
+    statementLatency(id)->record(static_cast<quint64>(timer.nsecsElapsed()));
+    return ok;
+}
+
+bool Database::runSearch(Statement id, const AuctionSearch &search, const QString &status,
+                         QVector<AuctionRecord> &auctions) const
+{
+    QSqlQuery *query = statement(id);
+    if (!query) {
+        return false;
+    }
+    // Each statement names only the placeholders it uses.
+    if (!search.match.isEmpty()) {
+        query->bindValue(":query", search.match);
+    }
+    if (!search.category.isEmpty()) {
+        query->bindValue(":category", search.category);
+    }
+    query->bindValue(":status", status);
+    query->bindValue(":ends_before", search.endsBeforeMs);
+    query->bindValue(":limit", search.limit);
+    if (id == Statement::SearchEndingSoon || id == Statement::SearchEndingSoonInCategory) {
+        // endsAfter folds into the cursor, so the index range has one lower bound.
+        qint64 afterEndsAt = search.afterEndsAtMs;
+        qint64 afterId = search.afterId;
+        if (search.afterId <= 0 || afterEndsAt < search.endsAfterMs) {
+            afterEndsAt = search.endsAfterMs;
+            afterId = 0; // ids start at 1
+        }
+        query->bindValue(":after_ends_at", afterEndsAt);
+        query->bindValue(":after_id", afterId);
+    } else {
+        query->bindValue(":before_id", search.afterId > 0 ? search.afterId : std::numeric_limits<qint64>::max());
+        query->bindValue(":ends_after", search.endsAfterMs);
+    }
+
+    if (!exec(id, query)) {
+        qWarning() << "searchAuctions failed:" << query->lastError();
+        return false;
+    }
+
+    auctions.reserve(search.limit);
+    while (query->next()) {
+        auctions.append(summaryRow(*query, search.nowMs));
+    }
+    query->finish();
+    return true;
+}
+
+bool Database::run(Statement id)
+{
+    QSqlQuery *query = statement(id);
+    if (!query) {
+        return false;
+    }
+    const bool ok = exec(id, query);
+    if (!ok) {
+        qWarning() << "statement failed:" << query->lastError();
+    }
+    query->finish();
+    return ok;
+}
+
+WriteResult Database::insertUser(const UserRecord &user)
+{
+    QSqlQuery *query = statement(Statement::InsertUser);
+    if (!query) {
+        return WriteResult::Failed;
+    }
+    if (userCache) {
+        // Before the row can commit, so a lookup never sees the row but not the filter entry.
+        userCache->noteInserted(user.email);
+    }
+    query->bindValue(":full_name", user.fullName);
+    query->bindValue(":email", user.email);
+    query->bindValue(":password", user.password);
+    query->bindValue(":phone", user.phone);
+    if (!exec(Statement::InsertUser, query)) {
+        const QSqlError error = query->lastError();
+        query->finish();
+        if (isUniqueViolation(error)) {
+            return WriteResult::Duplicate;
+        }
+        qWarning() << "insertUser failed:" << error;
+        return WriteResult::Failed;
+    }
+    query->finish();
+    return WriteResult::Ok;
+}
+
+bool Database::findCredentials(const QString &email, qint64 &userId, QString &passwordRecord) const
+{
+    quint64 generation = 0;
+    if (userCache) {
+        CachedCredentials cached;
+        if (!userCache->mightExist(email)) {
+            return false;
+        }
+        if (userCache->lookup(email, cached)) {
+            userId = cached.userId;
+            passwordRecord = cached.passwordRecord;
+            return true;
+        }
+        generation = userCache->generation(email);
+    }
+
+    QSqlQuery *query = statement(Statement::FindCredentials);
+    if (!query) {
         return false;
     }
-    query.bindValue(":email", email);
-    if (!query.exec()) {
-        qWarning() << "userExists failed:" << query.lastError();
+    query->bindValue(":email", email);
+    if (!exec(Statement::FindCredentials, query)) {
+        qWarning() << "findCredentials failed:" << query->lastError();
         return false;
     }
-    if (query.next()) {
-        return query.value(0).toInt() > 0;
+
+    const bool found = query->next();
+    if (found) {
+        userId = query->value(0).toLongLong();
+        passwordRecord = query->value(1).toString();
     }
-    return false;
+    query->finish();
+    if (found && userCache) {
+        userCache->store(email, CachedCredentials{userId, passwordRecord}, generation);
+    }
+    return found;
 }
 
-bool Database::insertUser(const UserRecord &user)
+bool Database::updatePassword(qint64 userId, const QString &email, const QString &passwordRecord)
 {
-    QSqlQuery query(db);
-    if (!query.prepare(QStringLiteral("INSERT INTO users(full_name, email, password, phone) "
-                                      "VALUES(:full_name, :email, :password, :phone)"))) {
-        qWarning() << "insertUser prepare failed:" << query.lastError();
+    QSqlQuery *query = statement(Statement::UpdatePassword);
+    if (!query) {
         return false;
     }
-    query.bindValue(":full_name", user.fullName);
-    query.bindValue(":email", user.email);
-    query.bindValue(":password", user.password);
-    query.bindValue(":phone", user.phone);
-    if (!query.exec()) {
-        qWarning() << "insertUser failed:" << query.lastError();
+    query->bindValue(":password", passwordRecord);
+    query->bindValue(":id", userId);
+    if (!exec(Statement::UpdatePassword, query)) {
+        qWarning() << "updatePassword failed:" << query->lastError();
         return false;
     }
+    query->finish();
+    if (userCache) {
+        userCache->invalidate(email);
+    }
     return true;
 }
 
-bool Database::verifyLogin(const QString &email, const QString &password) const
+bool Database::insertAuction(const AuctionRecord &auction)
 {
-    QSqlQuery query(db);
-    if (!query.prepare(QStringLiteral("SELECT password FROM users WHERE email = :email LIMIT 1"))) {
-        qWarning() << "verifyLogin prepare failed:" << query.lastError();
+    QSqlQuery *query = statement(Statement::InsertAuction);
+    if (!query) {
         return false;
     }
-    query.bindValue(":email", email);
-    if (!query.exec()) {
-        qWarning() << "verifyLogin failed:" << query.lastError();
+    query->bindValue(":id", auction.id);
+    query->bindValue(":seller_id", auction.sellerId);
+    query->bindValue(":title", auction.title);
+    query->bindValue(":description", auction.description);
+    query->bindValue(":category", auction.category);
+    query->bindValue(":start_price", auction.startPrice);
+    query->bindValue(":min_increment", auction.minIncrement);
+    query->bindValue(":current_price", auction.currentPrice);
+    query->bindValue(":created_at", auction.createdAtMs);
+    query->bindValue(":ends_at", auction.endsAtMs);
+    if (!exec(Statement::InsertAuction, query)) {
+        qWarning() << "insertAuction failed:" << query->lastError();
         return false;
     }
+    query->finish();
+    return true;
+}
 
-    if (query.next()) {
-        const QString storedPass = query.value(0).toString();
-        return storedPass == password;
+bool Database::recordBid(const BidRecord &bid, const AuctionRecord &auction)
+{
+    QSqlQuery *insert = statement(Statement::InsertBid);
+    QSqlQuery *update = statement(Statement::UpdateAuctionPrice);
+    // A savepoint rather than BEGIN, so this also nests inside writeBatch().
+    if (!insert || !update || !run(Statement::Savepoint)) {
+        return false;
+    }
+
+    insert->bindValue(":auction_id", bid.auctionId);
+    insert->bindValue(":bidder_id", bid.bidderId);
+    insert->bindValue(":amount", bid.amount);
+    insert->bindValue(":placed_at", bid.placedAtMs);
+    update->bindValue(":current_price", auction.currentPrice);
+    update->bindValue(":leader_id", auction.leaderId);
+    update->bindValue(":bid_count", auction.bidCount);
+    update->bindValue(":id", auction.id);
+
+    const bool ok = exec(Statement::InsertBid, insert) && exec(Statement::UpdateAuctionPrice, update);
+    if (!ok) {
+        qWarning() << "recordBid failed:" << insert->lastError() << update->lastError();
+    }
+    insert->finish();
+    update->finish();
+    if (!ok) {
+        run(Statement::RollbackToSavepoint);
     }
-    return false;
+    return run(Statement::ReleaseSavepoint) && ok;
 }
 
-bool Database::execBatch(const QString &sql)
+bool Database::closeAuction(qint64 auctionId)
+{
+    QSqlQuery *query = statement(Statement::CloseAuction);
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":id", auctionId);
+    if (!exec(Statement::CloseAuction, query)) {
+        qWarning() << "closeAuction failed:" << query->lastError();
+        return false;
+    }
+    query->finish();
+    return true;
+}
+
+QVector<AuctionRecord> Database::loadOpenAuctions() const
+{
+    QVector<AuctionRecord> auctions;
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection) {
+        return auctions;
+    }
+
+    // Startup only, so no prepared statement is kept for it.
+    QSqlQuery query(connection->database());
+    if (!query.exec(QStringLiteral("SELECT id, seller_id, title, description, start_price, min_increment, "
+                                   "current_price, leader_id, bid_count, created_at, ends_at, category "
+                                   "FROM auctions WHERE status = 'open'"))) {
+        qWarning() << "loadOpenAuctions failed:" << query.lastError();
+        return auctions;
+    }
+    while (query.next()) {
+        auctions.append(auctionRow(query));
+    }
+    return auctions;
+}
+
+bool Database::loadAuction(qint64 auctionId, int bidLimit, AuctionRecord &auction,
+                           QVector<BidRecord> &recentBids) const
+{
+    QSqlQuery *query = statement(Statement::LoadAuction);
+    QSqlQuery *bids = statement(Statement::LoadRecentBids);
+    if (!query || !bids) {
+        return false;
+    }
+    query->bindValue(":id", auctionId);
+    if (!exec(Statement::LoadAuction, query)) {
+        qWarning() << "loadAuction failed:" << query->lastError();
+        return false;
+    }
+    if (!query->next()) {
+        query->finish();
+        return false;
+    }
+    auction = auctionRow(*query);
+    auction.open = query->value(12).toString() == QLatin1String("open");
+    query->finish();
+
+    bids->bindValue(":auction_id", auctionId);
+    bids->bindValue(":limit", bidLimit);
+    if (!exec(Statement::LoadRecentBids, bids)) {
+        qWarning() << "loadAuction failed:" << bids->lastError();
+        return false;
+    }
+    recentBids.clear();
+    while (bids->next()) {
+        BidRecord bid;
+        bid.auctionId = auctionId;
+        bid.bidderId = bids->value(0).toLongLong();
+        bid.amount = bids->value(1).toLongLong();
+        bid.placedAtMs = bids->value(2).toLongLong();
+        recentBids.prepend(bid); // newest first from the query
+    }
+    bids->finish();
+    return true;
+}
+
+bool Database::listAuctions(qint64 beforeId, int limit, qint64 nowMs, QVector<AuctionRecord> &auctions) const
+{
+    QSqlQuery *query = statement(Statement::ListAuctions);
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":before_id", beforeId);
+    query->bindValue(":limit", limit);
+    if (!exec(Statement::ListAuctions, query)) {
+        qWarning() << "listAuctions failed:" << query->lastError();
+        return false;
+    }
+
+    auctions.reserve(limit);
+    while (query->next()) {
+        auctions.append(summaryRow(*query, nowMs));
+    }
+    query->finish();
+    return true;
+}
+
+bool Database::searchAuctions(const AuctionSearch &search, QVector<AuctionRecord> &auctions) const
+{
+    const bool anyCategory = search.category.isEmpty();
+    Statement id;
+    if (!search.match.isEmpty()) {
+        id = anyCategory ? Statement::SearchText : Statement::SearchTextInCategory;
+    } else if (search.order == AuctionSearch::Order::Newest) {
+        id = anyCategory ? Statement::SearchNewest : Statement::SearchNewestInCategory;
+    } else {
+        id = anyCategory ? Statement::SearchEndingSoon : Statement::SearchEndingSoonInCategory;
+    }
+
+    if (search.open) {
+        // now folds into the lower end bound, so the index range still has one.
+        AuctionSearch live = search;
+        live.endsAfterMs = qMax(search.endsAfterMs, search.nowMs + 1);
+        return runSearch(id, live, QStringLiteral("open"), auctions);
+    }
+
+    if (!runSearch(id, search, QStringLiteral("closed"), auctions)) {
+        return false;
+    }
+    // The complement also holds open rows past their end, which the engine
+    // closes within a second or so; merge the few there are into the page.
+    AuctionSearch ended = search;
+    ended.endsBeforeMs = qMin(search.endsBeforeMs, search.nowMs + 1);
+    if (ended.endsAfterMs >= ended.endsBeforeMs) {
+        return true;
+    }
+    if (id == Statement::SearchNewest || id == Statement::SearchNewestInCategory) {
+        id = anyCategory ? Statement::SearchEndedNewest : Statement::SearchEndedNewestInCategory;
+    }
+    QVector<AuctionRecord> late;
+    if (!runSearch(id, ended, QStringLiteral("open"), late)) {
+        return false;
+    }
+    if (late.isEmpty()) {
+        return true;
+    }
+
+    const bool ending = search.order == AuctionSearch::Order::EndingSoon;
+    QVector<AuctionRecord> page;
+    page.reserve(auctions.size() + late.size());
+    std::merge(auctions.cbegin(), auctions.cend(), late.cbegin(), late.cend(), std::back_inserter(page),
+               [ending](const AuctionRecord &a, const AuctionRecord &b) {
+                   return ending ? std::make_pair(a.endsAtMs, a.id) < std::make_pair(b.endsAtMs, b.id) : a.id > b.id;
+               });
+    if (page.size() > search.limit) {
+        page.resize(search.limit);
+    }
+    auctions = page;
+    return true;
+}
+
+qint64 Database::maxAuctionId() const
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection) {
+        return 0;
+    }
+    QSqlQuery query(connection->database());
+    if (!query.exec(QStringLiteral("SELECT COALESCE(MAX(id), 0) FROM auctions")) || !query.next()) {
+        qWarning() << "maxAuctionId failed:" << query.lastError();
+        return 0;
+    }
+    return query.value(0).toLongLong();
+}
+
+void Database::writeBatch(const QVector<Write> &writes, QVector<WriteResult> &results)
 {
-    const QStringList statements = sql.split(';', Qt::SkipEmptyParts);
-    QSqlQuery query(db);
-    for (const QString &statement : statements) {
-        const QString trimmed = statement.trimmed();
-        if (trimmed.isEmpty()) {
+    results.fill(WriteResult::Failed, writes.size());
+    if (!run(Statement::BeginBatch)) {
+        return;
+    }
+
+    for (int i = 0; i < writes.size(); ++i) {
+        if (!run(Statement::Savepoint)) {
             continue;
         }
-        if (!query.exec(trimmed)) {
-            qWarning() << "execBatch failed:" << query.lastError() << "for statement:" << trimmed;
+        results[i] = writes[i](*this);
+        if (results[i] != WriteResult::Ok) {
+            run(Statement::RollbackToSavepoint);
+        }
+        run(Statement::ReleaseSavepoint);
+    }
+
+    if (!run(Statement::CommitBatch)) {
+        run(Statement::RollbackBatch);
+        results.fill(WriteResult::Failed);
+    }
+}
+
+bool Database::migrate(const QString &migrationsDir)
+{
+    initSchemaResource();
+    const int current = schemaVersion();
+    if (current < 0) {
+        return false;
+    }
+
+    QMap<int, QString> scripts;
+    const QFileInfoList files =
+        QDir(migrationsDir).entryInfoList({QStringLiteral("*.sql")}, QDir::Files, QDir::Name);
+    for (const QFileInfo &file : files) {
+        bool ok = false;
+        const int version = file.fileName().section(QLatin1Char('_'), 0, 0).toInt(&ok);
+        if (!ok || version <= 0) {
+            qWarning() << "Skipping migration without a version prefix:" << file.fileName();
+            continue;
+        }
+        scripts.insert(version, file.filePath());
+    }
+    const int latest = scripts.isEmpty() ? 0 : scripts.lastKey();
+    if (current > latest) {
+        qCritical("Database schema version %d is newer than this server (%d).", current, latest);
+        return false;
+    }
+    if (current == latest) {
+        return true;
+    }
+
+    QString script;
+    for (auto it = scripts.upperBound(current); it != scripts.end(); ++it) {
+        QFile file(it.value());
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qCritical() << "Cannot read migration" << it.value();
+            return false;
+        }
+        script += QString::fromUtf8(file.readAll());
+        script += QStringLiteral("\n;\n");
+    }
+    // Written in the same transaction, so a failed migration leaves the old version.
+    script += QStringLiteral("PRAGMA user_version = %1;").arg(latest);
+    if (!execBatch(script)) {
+        qCritical("Schema migration from version %d to %d failed.", current, latest);
+        return false;
+    }
+    qInfo("[SERVER] Schema migrated from version %d to %d", current, latest);
+    return true;
+}
+
+int Database::schemaVersion() const
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection) {
+        return -1;
+    }
+    QSqlQuery query(connection->database());
+    if (!query.exec(QStringLiteral("PRAGMA user_version")) || !query.next()) {
+        qWarning() << "schemaVersion failed:" << query.lastError();
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+bool Database::checkpoint()
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection) {
+        return false;
+    }
+    // Columns: busy flag, WAL frames, frames checkpointed. Outside WAL mode the
+    // pragma is a no-op that reports -1 frames.
+    QSqlQuery query(connection->database());
+    if (!query.exec(QStringLiteral("PRAGMA wal_checkpoint(TRUNCATE)")) || !query.next()) {
+        qWarning() << "checkpoint failed:" << query.lastError();
+        return false;
+    }
+    if (query.value(0).toInt() != 0) {
+        qWarning("checkpoint incomplete: a reader still holds the WAL.");
+        return false;
+    }
+    return true;
+}
+
+bool Database::execBatch(const QString &sql)
+{
+    PooledConnection *connection = pool ? pool->acquire() : nullptr;
+    if (!connection || !run(Statement::BeginBatch)) {
+        return false;
+    }
+
+    QSqlQuery query(connection->database());
+    for (const QString &statement : splitStatements(sql)) {
+        if (!query.exec(statement)) {
+            qWarning() << "execBatch failed:" << query.lastError() << "for statement:" << statement;
+            query.finish();
+            run(Statement::RollbackBatch);
             return false;
         }
     }
+    query.finish();
+    if (!run(Statement::CommitBatch)) {
+        run(Statement::RollbackBatch);
+        return false;
+    }
     return true;
 }
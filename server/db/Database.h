@@ -1,8 +1,16 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
-#include <QSqlDatabase>
 #include <QString>
+#include <QVector>
+
+#include <functional>
+#include <limits>
+#include <memory>
+
+#include "ConnectionPool.h"
+
+class UserCache;
 
 struct UserRecord
 {
@@ -12,23 +20,143 @@ struct UserRecord
     QString phone;
 };
 
+enum class WriteResult
+{
+    Ok,
+    Duplicate, // a UNIQUE constraint rejected the row
+    Failed,
+};
+
+// Amounts are integers in the smallest currency unit; times are ms since epoch.
+struct AuctionRecord
+{
+    // Upper bound for prices, increments and bids accepted from clients, so
+    // currentPrice + minIncrement in minimumBid() cannot overflow.
+    static constexpr qint64 kMaxAmount = 1000000000000000ll; // 10^15
+
+    qint64 id = 0;
+    qint64 sellerId = 0;
+    QString title;
+    QString description;
+    QString category; // empty when uncategorised
+    qint64 startPrice = 0;
+    qint64 minIncrement = 1;
+    qint64 currentPrice = 0;
+    qint64 leaderId = 0; // 0 until the first bid
+    int bidCount = 0;
+    qint64 createdAtMs = 0;
+    qint64 endsAtMs = 0;
+    bool open = true;
+
+    // Smallest amount the next bid must reach.
+    qint64 minimumBid() const { return bidCount == 0 ? startPrice : currentPrice + minIncrement; }
+};
+
+// One SEARCH_AUCTIONS page. Every combination maps to a prepared statement
+// that seeks an index to the cursor, so no page reads the rows before it.
+struct AuctionSearch
+{
+    enum class Order
+    {
+        Newest,     // id descending
+        EndingSoon, // (endsAt, id) ascending
+    };
+
+    QString match;    // FTS5 query over title and description; empty = any (Newest only)
+    QString category; // empty = any
+    bool open = true; // open or closed, as of nowMs
+    qint64 endsAfterMs = 0;                                   // inclusive
+    qint64 endsBeforeMs = std::numeric_limits<qint64>::max(); // exclusive
+    Order order = Order::Newest;
+    // Keyset cursor: the last row of the previous page, afterId 0 for the first.
+    qint64 afterId = 0;
+    qint64 afterEndsAtMs = 0; // EndingSoon only
+    int limit = 50;
+    // Open means status 'open' and ending after nowMs. Everything else is
+    // closed, including open rows the engine has not closed yet.
+    qint64 nowMs = 0;
+};
+
+struct BidRecord
+{
+    qint64 auctionId = 0;
+    qint64 bidderId = 0;
+    qint64 amount = 0;
+    qint64 placedAtMs = 0;
+};
+
 class Database
 {
 public:
     Database();
     ~Database();
 
-    bool open(const QString &path);
+    bool open(const QString &path, const SqliteOptions &options = SqliteOptions());
+    // Call (or destroy) on the thread that opened the database, once every
+    // other thread that used it has finished.
     void close();
+    // Brings the schema up to date: runs every numbered script in
+    // migrationsDir (NNNN_name.sql) newer than PRAGMA user_version, all in one
+    // transaction, then records the new version. The scripts are compiled in
+    // as Qt resources, so startup does not depend on the working directory.
+    bool migrate(const QString &migrationsDir = QStringLiteral(":/db/migrations"));
+    // PRAGMA user_version, or -1 if it cannot be read.
+    int schemaVersion() const;
+    // Copies the WAL back into the database file and truncates it, so a
+    // cleanly stopped server leaves a single self-contained file. Call once
+    // every writer has drained.
+    bool checkpoint();
+
+    // Puts a UserCache of capacity accounts in front of the user lookups and
+    // indexes every existing email; call after migrate().
+    bool enableUserCache(int capacity);
 
     bool userExists(const QString &email) const;
-    bool insertUser(const UserRecord &user);
-    bool verifyLogin(const QString &email, const QString &password) const;
+    WriteResult insertUser(const UserRecord &user);
+    // Looks up the stored password record; false if there is no such user.
+    bool findCredentials(const QString &email, qint64 &userId, QString &passwordRecord) const;
+    bool updatePassword(qint64 userId, const QString &email, const QString &passwordRecord);
+
+    bool insertAuction(const AuctionRecord &auction);
+    // Stores bid and the auction's new price / leader / count atomically.
+    bool recordBid(const BidRecord &bid, const AuctionRecord &auction);
+    bool closeAuction(qint64 auctionId);
+    QVector<AuctionRecord> loadOpenAuctions() const;
+    // One auction with its latest bidLimit bids, oldest first. False for an
+    // unknown id or on an SQL error.
+    bool loadAuction(qint64 auctionId, int bidLimit, AuctionRecord &auction, QVector<BidRecord> &recentBids) const;
+    // Newest first, ids below beforeId; a page walks the primary key, so its
+    // cost does not grow with how far the caller has scrolled. Summary
+    // fields only: no seller, description or creation time. Rows ending at or
+    // before nowMs are reported closed.
+    bool listAuctions(qint64 beforeId, int limit, qint64 nowMs, QVector<AuctionRecord> &auctions) const;
+    // Fills auctions with up to search.limit rows in search.order. Summary
+    // fields and category only. False on an SQL error, including an invalid
+    // FTS5 expression in search.match.
+    bool searchAuctions(const AuctionSearch &search, QVector<AuctionRecord> &auctions) const;
+    qint64 maxAuctionId() const;
 
+    using Write = std::function<WriteResult(Database &)>;
+    // Runs writes in one transaction, each inside its own savepoint so a failed
+    // write is undone without touching the others. results gets one entry per
+    // write; if the commit itself fails, every entry is Failed.
+    void writeBatch(const QVector<Write> &writes, QVector<WriteResult> &results);
+
+    // Runs a multi-statement script in one transaction: all of it or none.
     bool execBatch(const QString &sql);
 
 private:
-    QSqlDatabase db;
+    // Prepared statement for the calling thread's pooled connection.
+    QSqlQuery *statement(Statement id) const;
+    bool run(Statement id);
+    // query->exec(), timed into auction_db_statement_seconds{statement=...}.
+    bool exec(Statement id, QSqlQuery *query) const;
+    // Runs one Search* statement for rows with the given status.
+    bool runSearch(Statement id, const AuctionSearch &search, const QString &status,
+                   QVector<AuctionRecord> &auctions) const;
+
+    std::unique_ptr<ConnectionPool> pool;
+    std::unique_ptr<UserCache> userCache;
 };
 
 #endif // DATABASE_H
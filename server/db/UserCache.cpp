@@ -0,0 +1,147 @@
+#include "UserCache.h"
+
+#include <QtGlobal>
+
+namespace {
+constexpr int kBitsPerItem = 10; // ~1% false positives with 7 hashes
+
+quint64 fnv1a(const QByteArray &key)
+{
+    quint64 hash = 14695981039346656037ull;
+    for (const char c : key) {
+        hash ^= static_cast<quint8>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+quint64 mix(quint64 x)
+{
+    // splitmix64 finalizer, gives the second independent hash.
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+} // namespace
+
+BloomFilter::BloomFilter(quint64 expectedItems)
+    : expected(qMax<quint64>(1, expectedItems))
+    , bitCount(qMax<quint64>(64, expectedItems * kBitsPerItem))
+    , words((bitCount + 63) / 64)
+{
+}
+
+void BloomFilter::add(const QByteArray &key)
+{
+    const quint64 h1 = fnv1a(key);
+    const quint64 h2 = mix(h1) | 1;
+    for (int i = 0; i < kHashes; ++i) {
+        const quint64 bit = (h1 + i * h2) % bitCount;
+        words[bit / 64].fetch_or(quint64(1) << (bit % 64), std::memory_order_release);
+    }
+    items.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BloomFilter::mightContain(const QByteArray &key) const
+{
+    const quint64 h1 = fnv1a(key);
+    const quint64 h2 = mix(h1) | 1;
+    for (int i = 0; i < kHashes; ++i) {
+        const quint64 bit = (h1 + i * h2) % bitCount;
+        if (!(words[bit / 64].load(std::memory_order_acquire) & (quint64(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+UserCache::UserCache(int capacity, quint64 expectedUsers)
+{
+    ownedLayers.push_back(std::make_unique<BloomFilter>(expectedUsers));
+    bloomLayers[0].store(ownedLayers.back().get(), std::memory_order_relaxed);
+    bloomLayerCount.store(1, std::memory_order_release);
+
+    const int perShard = qMax(1, capacity / kShardCount);
+    for (Shard &shard : shards) {
+        shard.entries.setMaxCost(perShard);
+    }
+}
+
+bool UserCache::mightExist(const QString &email) const
+{
+    const QByteArray key = email.toUtf8();
+    const int count = bloomLayerCount.load(std::memory_order_acquire);
+    // Newest first: recent signups are the likeliest to be looked up.
+    for (int i = count - 1; i >= 0; --i) {
+        if (bloomLayers[i].load(std::memory_order_relaxed)->mightContain(key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void UserCache::noteInserted(const QString &email)
+{
+    const int count = bloomLayerCount.load(std::memory_order_acquire);
+    BloomFilter *layer = bloomLayers[count - 1].load(std::memory_order_relaxed);
+    if (layer->full()) {
+        layer = growBloom(layer);
+    }
+    layer->add(email.toUtf8());
+}
+
+BloomFilter *UserCache::growBloom(BloomFilter *full)
+{
+    QMutexLocker locker(&growMutex);
+    const int count = bloomLayerCount.load(std::memory_order_relaxed);
+    BloomFilter *newest = bloomLayers[count - 1].load(std::memory_order_relaxed);
+    if (newest != full || count == kMaxBloomLayers) {
+        return newest; // grown by another thread, or out of layers: keep filling the last one
+    }
+    ownedLayers.push_back(std::make_unique<BloomFilter>(full->capacity() * 2));
+    bloomLayers[count].store(ownedLayers.back().get(), std::memory_order_relaxed);
+    bloomLayerCount.store(count + 1, std::memory_order_release);
+    qInfo("[SERVER] User filter grown to %d layer(s), newest holds %llu emails", count + 1,
+          static_cast<unsigned long long>(full->capacity() * 2));
+    return ownedLayers.back().get();
+}
+
+bool UserCache::lookup(const QString &email, CachedCredentials &out)
+{
+    Shard &shard = shardFor(email);
+    QMutexLocker locker(&shard.mutex);
+    const CachedCredentials *cached = shard.entries.object(email);
+    if (!cached) {
+        return false;
+    }
+    out = *cached;
+    return true;
+}
+
+quint64 UserCache::generation(const QString &email) const
+{
+    const Shard &shard = shardFor(email);
+    QMutexLocker locker(&shard.mutex);
+    return shard.generation;
+}
+
+void UserCache::store(const QString &email, const CachedCredentials &credentials, quint64 generationSeen)
+{
+    Shard &shard = shardFor(email);
+    QMutexLocker locker(&shard.mutex);
+    if (shard.generation != generationSeen) {
+        return;
+    }
+    shard.entries.insert(email, new CachedCredentials(credentials));
+}
+
+void UserCache::invalidate(const QString &email)
+{
+    Shard &shard = shardFor(email);
+    QMutexLocker locker(&shard.mutex);
+    shard.entries.remove(email);
+    ++shard.generation;
+}
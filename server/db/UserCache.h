@@ -0,0 +1,94 @@
+#ifndef USERCACHE_H
+#define USERCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Fixed-size Bloom filter over byte strings. add() and mightContain() are
+// lock-free and may run concurrently; there are no false negatives.
+class BloomFilter
+{
+public:
+    // Sized for roughly 1% false positives at expectedItems.
+    explicit BloomFilter(quint64 expectedItems);
+
+    void add(const QByteArray &key);
+    bool mightContain(const QByteArray &key) const;
+
+    quint64 capacity() const { return expected; }
+    // Past capacity the false-positive rate climbs quickly.
+    bool full() const { return items.load(std::memory_order_relaxed) >= expected; }
+
+private:
+    static constexpr int kHashes = 7;
+
+    const quint64 expected;
+    const quint64 bitCount;
+    std::vector<std::atomic<quint64>> words;
+    std::atomic<quint64> items{0};
+};
+
+struct CachedCredentials
+{
+    qint64 userId = 0;
+    QString passwordRecord;
+};
+
+// Lookup cache in front of the users table. "Not registered" is answered by a
+// Bloom filter of every known email, which is filled before an insert commits
+// and so never misses a real user. A filter cannot be resized in place, so
+// when the newest one reaches its capacity a layer twice its size is added
+// and takes the new emails; lookups check every layer. Known accounts are
+// kept in a bounded, sharded LRU of credentials. A write that changes an
+// account invalidates it, and bumping the shard generation means a slower
+// reader cannot put the old value back.
+class UserCache
+{
+public:
+    UserCache(int capacity, quint64 expectedUsers);
+
+    bool mightExist(const QString &email) const;
+    // Call before inserting, so the filter is never behind the table.
+    void noteInserted(const QString &email);
+
+    bool lookup(const QString &email, CachedCredentials &out);
+    // Read before querying the database and pass to store() afterwards.
+    quint64 generation(const QString &email) const;
+    // Dropped if email was invalidated after generationSeen was read.
+    void store(const QString &email, const CachedCredentials &credentials, quint64 generationSeen);
+    void invalidate(const QString &email);
+
+private:
+    static constexpr int kShardCount = 16;
+    // Each layer doubles the last, so this is never reached in practice.
+    static constexpr int kMaxBloomLayers = 32;
+
+    struct Shard
+    {
+        mutable QMutex mutex;
+        QCache<QString, CachedCredentials> entries;
+        quint64 generation = 0;
+    };
+
+    Shard &shardFor(const QString &email) { return shards[qHash(email) % kShardCount]; }
+    const Shard &shardFor(const QString &email) const { return shards[qHash(email) % kShardCount]; }
+
+    // Adds a layer after full unless another thread already did; returns the newest.
+    BloomFilter *growBloom(BloomFilter *full);
+
+    // Published with release once built, read without locks; never removed.
+    std::array<std::atomic<BloomFilter *>, kMaxBloomLayers> bloomLayers{};
+    std::atomic<int> bloomLayerCount{0};
+    QMutex growMutex;
+    std::vector<std::unique_ptr<BloomFilter>> ownedLayers; // guarded by growMutex
+    std::array<Shard, kShardCount> shards;
+};
+
+#endif // USERCACHE_H
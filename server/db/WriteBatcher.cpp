@@ -0,0 +1,106 @@
+#include "WriteBatcher.h"
+
+#include <QDeadlineTimer>
+#include <QThread>
+
+#include <utility>
+
+WriteBatcher::WriteBatcher(Database &db, const WriteBatchOptions &options)
+    : database(db)
+    , options(options)
+{
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName(QStringLiteral("write-batcher"));
+    thread->start();
+}
+
+WriteBatcher::~WriteBatcher()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        wakeWriter.wakeAll();
+    }
+    // Finishing the thread also closes its pooled connection.
+    thread->wait();
+    delete thread;
+}
+
+bool WriteBatcher::submit(Database::Write write, Done done)
+{
+    QMutexLocker locker(&mutex);
+    if (queue.size() >= options.maxPending) {
+        return false;
+    }
+    queue.append(Item{std::move(write), std::move(done)});
+    if (queue.size() == 1 || queue.size() >= options.maxBatch) {
+        wakeWriter.wakeOne();
+    }
+    return true;
+}
+
+void WriteBatcher::drain()
+{
+    QMutexLocker locker(&mutex);
+    while (!queue.isEmpty() || writing) {
+        idle.wait(&mutex);
+    }
+}
+
+int WriteBatcher::pendingWrites() const
+{
+    QMutexLocker locker(&mutex);
+    return queue.size();
+}
+
+void WriteBatcher::run()
+{
+    const int maxBatch = qMax(1, options.maxBatch);
+    QVector<Item> batch;
+    QVector<Database::Write> writes;
+    QVector<WriteResult> results;
+
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (queue.isEmpty() && !stopping) {
+            wakeWriter.wait(&mutex);
+        }
+        if (queue.isEmpty()) {
+            break; // stopping and nothing left
+        }
+
+        // Give other sessions a short window to join this transaction.
+        QDeadlineTimer window(options.windowMs);
+        while (queue.size() < maxBatch && !stopping && !window.hasExpired()) {
+            wakeWriter.wait(&mutex, window);
+        }
+
+        const int count = qMin(maxBatch, static_cast<int>(queue.size()));
+        batch.clear();
+        for (int i = 0; i < count; ++i) {
+            batch.append(std::move(queue[i]));
+        }
+        queue.remove(0, count);
+        writing = true;
+        locker.unlock();
+
+        writes.clear();
+        for (const Item &item : std::as_const(batch)) {
+            writes.append(item.write);
+        }
+        database.writeBatch(writes, results);
+        for (int i = 0; i < batch.size(); ++i) {
+            if (batch[i].done) {
+                batch[i].done(results[i]);
+            }
+        }
+
+        locker.relock();
+        writing = false;
+        if (queue.isEmpty()) {
+            idle.wakeAll();
+        }
+    }
+    writing = false;
+    idle.wakeAll();
+}
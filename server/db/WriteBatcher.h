@@ -0,0 +1,66 @@
+#ifndef WRITEBATCHER_H
+#define WRITEBATCHER_H
+
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <functional>
+
+#include "Database.h"
+
+class QThread;
+
+struct WriteBatchOptions
+{
+    int maxBatch = 256; // writes per transaction
+    int windowMs = 2;   // how long the first write of a batch waits for company
+    int maxPending = 65536;
+};
+
+// Group commit for inserts. Writes from any thread are queued and run on one
+// writer thread, many per transaction, so a burst of registrations or bids
+// costs one sync instead of one per row. A batch is flushed once it is full or
+// its window has passed. Each write still gets its own result, and writes run
+// in submission order.
+class WriteBatcher
+{
+public:
+    using Done = std::function<void(WriteResult)>;
+
+    WriteBatcher(Database &db, const WriteBatchOptions &options = WriteBatchOptions());
+    // Flushes everything queued, then stops the writer thread.
+    ~WriteBatcher();
+
+    WriteBatcher(const WriteBatcher &) = delete;
+    WriteBatcher &operator=(const WriteBatcher &) = delete;
+
+    // Returns false, without queueing, once maxPending writes are waiting.
+    // done (optional) runs on the writer thread after the batch has committed.
+    bool submit(Database::Write write, Done done = Done());
+    // Blocks until every queued write has committed.
+    void drain();
+
+    int pendingWrites() const;
+
+private:
+    struct Item
+    {
+        Database::Write write;
+        Done done;
+    };
+
+    void run();
+
+    Database &database;
+    const WriteBatchOptions options;
+    mutable QMutex mutex;
+    QWaitCondition wakeWriter;
+    QWaitCondition idle;
+    QVector<Item> queue;
+    bool writing = false;
+    bool stopping = false;
+    QThread *thread = nullptr;
+};
+
+#endif // WRITEBATCHER_H
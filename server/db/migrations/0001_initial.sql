@@ -0,0 +1,33 @@
+CREATE TABLE IF NOT EXISTS users (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    full_name TEXT NOT NULL,
+    email TEXT NOT NULL UNIQUE,
+    password TEXT NOT NULL,
+    phone TEXT
+);
+
+-- Prices are integers in the smallest currency unit.
+CREATE TABLE IF NOT EXISTS auctions (
+    id INTEGER PRIMARY KEY,
+    seller_id INTEGER NOT NULL REFERENCES users(id),
+    title TEXT NOT NULL,
+    description TEXT,
+    start_price INTEGER NOT NULL,
+    min_increment INTEGER NOT NULL,
+    current_price INTEGER NOT NULL,
+    leader_id INTEGER REFERENCES users(id),
+    bid_count INTEGER NOT NULL DEFAULT 0,
+    status TEXT NOT NULL DEFAULT 'open',
+    created_at INTEGER NOT NULL,
+    ends_at INTEGER NOT NULL
+);
+
+CREATE TABLE IF NOT EXISTS bids (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    auction_id INTEGER NOT NULL REFERENCES auctions(id),
+    bidder_id INTEGER NOT NULL REFERENCES users(id),
+    amount INTEGER NOT NULL,
+    placed_at INTEGER NOT NULL
+);
+
+CREATE INDEX IF NOT EXISTS idx_bids_auction ON bids(auction_id, id);
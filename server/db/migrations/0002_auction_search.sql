@@ -0,0 +1,40 @@
+-- Auction search: categories, keyset-friendly indexes and full-text search.
+
+ALTER TABLE auctions ADD COLUMN category TEXT NOT NULL DEFAULT '';
+
+-- One index per SEARCH_AUCTIONS order, each holding every column the WHERE,
+-- ORDER BY and cursor need. A page seeks straight to the cursor and filters
+-- inside the index; the table is only read for the rows it returns, so page
+-- 1,000 costs the same as page 1.
+CREATE INDEX IF NOT EXISTS idx_auctions_status_newest ON auctions(status, id, ends_at);
+CREATE INDEX IF NOT EXISTS idx_auctions_status_ending ON auctions(status, ends_at, id);
+CREATE INDEX IF NOT EXISTS idx_auctions_category_newest ON auctions(category, status, id, ends_at);
+CREATE INDEX IF NOT EXISTS idx_auctions_category_ending ON auctions(category, status, ends_at, id);
+
+-- Title and description words; external content, so the text is stored once.
+-- remove_diacritics lets "ho co" match "hồ cổ" (though not "d" for "đ").
+CREATE VIRTUAL TABLE IF NOT EXISTS auctions_fts USING fts5(
+    title,
+    description,
+    content = 'auctions',
+    content_rowid = 'id',
+    tokenize = 'unicode61 remove_diacritics 2'
+);
+
+INSERT INTO auctions_fts(auctions_fts) VALUES('rebuild');
+
+CREATE TRIGGER IF NOT EXISTS auctions_fts_insert AFTER INSERT ON auctions BEGIN
+    INSERT INTO auctions_fts(rowid, title, description) VALUES (new.id, new.title, new.description);
+END;
+
+CREATE TRIGGER IF NOT EXISTS auctions_fts_delete AFTER DELETE ON auctions BEGIN
+    INSERT INTO auctions_fts(auctions_fts, rowid, title, description)
+    VALUES ('delete', old.id, old.title, old.description);
+END;
+
+-- Only text edits touch the index; price updates from bids do not.
+CREATE TRIGGER IF NOT EXISTS auctions_fts_update AFTER UPDATE OF title, description ON auctions BEGIN
+    INSERT INTO auctions_fts(auctions_fts, rowid, title, description)
+    VALUES ('delete', old.id, old.title, old.description);
+    INSERT INTO auctions_fts(rowid, title, description) VALUES (new.id, new.title, new.description);
+END;
@@ -1,52 +1,530 @@
+#include <QCommandLineParser>
 #include <QCoreApplication>
-#include <QDir>
+#include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QTextStream>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVariant>
 
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "auction/AuctionEngine.h"
+#include "auction/PriceFeed.h"
+#include "auth/PasswordHasher.h"
+#include "auth/SessionStore.h"
 #include "db/Database.h"
+#include "db/WriteBatcher.h"
+#include "metrics/Metrics.h"
+#include "network/MetricsEndpoint.h"
 #include "network/TcpServer.h"
 #include "protocol/CommandHandler.h"
+#include "protocol/WorkerPool.h"
+
+#include "AsyncLog.h"
 
 namespace {
-void loadSchema(Database &db)
+// "rate:burst" in requests per second; a bare rate gets a burst of twice that.
+bool parseRateLimit(const QString &text, RateLimit &limit)
 {
-    const QString baseDir = QCoreApplication::applicationDirPath();
-    const QString schemaPath = QDir(baseDir).filePath(QStringLiteral("../db/schema.sql"));
+    const QStringList parts = text.split(QLatin1Char(':'));
+    bool rateOk = false;
+    bool burstOk = true;
+    limit.perSecond = parts.value(0).toDouble(&rateOk);
+    limit.burst = parts.size() > 1 ? parts.at(1).toDouble(&burstOk) : limit.perSecond * 2;
+    limit.burst = qMax(1.0, limit.burst);
+    return rateOk && burstOk && parts.size() <= 2;
+}
 
-    QFile schemaFile(schemaPath);
-    if (!schemaFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open schema file at" << schemaPath << ", continuing without.";
-        return;
+// A TCP port, 1 .. 65535; 0 too when allowZero (an optional listener that is off).
+bool parsePort(const QString &text, bool allowZero, quint16 &port)
+{
+    bool ok = false;
+    const uint value = text.toUInt(&ok);
+    if (!ok || value > 65535 || (value == 0 && !allowZero)) {
+        return false;
     }
+    port = static_cast<quint16>(value);
+    return true;
+}
+
+#ifdef Q_OS_UNIX
+// Self-pipe: the handler only writes the signal number to one end of a socket
+// pair, and the event loop reads the other end.
+int signalPipe[2] = {-1, -1};
 
-    QTextStream in(&schemaFile);
-    const QString sql = in.readAll();
-    db.execBatch(sql);
+void forwardSignal(int signal)
+{
+    const char byte = static_cast<char>(signal);
+    const ssize_t written = ::write(signalPipe[1], &byte, 1);
+    Q_UNUSED(written);
+}
+
+bool installTerminationHandlers()
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalPipe) != 0) {
+        return false;
+    }
+    for (int fd : signalPipe) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    ::fcntl(signalPipe[1], F_SETFL, ::fcntl(signalPipe[1], F_GETFL) | O_NONBLOCK);
+    struct sigaction action = {};
+    action.sa_handler = forwardSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return ::sigaction(SIGTERM, &action, nullptr) == 0 && ::sigaction(SIGINT, &action, nullptr) == 0;
 }
+#endif
 } // namespace
 
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
 
-    const QString dbPath = QStringLiteral("users.db");
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption configOption(QStringLiteral("config"),
+                                          QStringLiteral("INI file with defaults for any option below, keyed by "
+                                                         "option name. Flags on the command line win."),
+                                          QStringLiteral("file"));
+    parser.addOption(configOption);
+    const QCommandLineOption portOption(QStringLiteral("port"), QStringLiteral("TCP port for clients."),
+                                        QStringLiteral("port"), QStringLiteral("5555"));
+    parser.addOption(portOption);
+    const QCommandLineOption bindOption(QStringLiteral("bind"),
+                                        QStringLiteral("Address to listen on, e.g. 127.0.0.1 (default: all)."),
+                                        QStringLiteral("address"));
+    parser.addOption(bindOption);
+    const QCommandLineOption dbOption(QStringLiteral("db"), QStringLiteral("SQLite database file."),
+                                      QStringLiteral("path"), QStringLiteral("users.db"));
+    parser.addOption(dbOption);
+    const QCommandLineOption journalModeOption(QStringLiteral("sqlite-journal-mode"),
+                                               QStringLiteral("PRAGMA journal_mode."),
+                                               QStringLiteral("mode"), QStringLiteral("WAL"));
+    parser.addOption(journalModeOption);
+    const QCommandLineOption synchronousOption(QStringLiteral("sqlite-synchronous"),
+                                               QStringLiteral("PRAGMA synchronous."),
+                                               QStringLiteral("level"), QStringLiteral("NORMAL"));
+    parser.addOption(synchronousOption);
+    const QCommandLineOption mmapOption(QStringLiteral("sqlite-mmap-mb"), QStringLiteral("PRAGMA mmap_size in MiB."),
+                                        QStringLiteral("mib"), QStringLiteral("256"));
+    parser.addOption(mmapOption);
+    const QCommandLineOption pageCacheOption(QStringLiteral("sqlite-cache-mb"),
+                                             QStringLiteral("SQLite page cache per connection in MiB."),
+                                             QStringLiteral("mib"), QStringLiteral("64"));
+    parser.addOption(pageCacheOption);
+    const QCommandLineOption busyTimeoutOption(QStringLiteral("sqlite-busy-ms"),
+                                               QStringLiteral("PRAGMA busy_timeout in milliseconds."),
+                                               QStringLiteral("ms"), QStringLiteral("5000"));
+    parser.addOption(busyTimeoutOption);
+    const QCommandLineOption workersOption(QStringLiteral("workers"),
+                                           QStringLiteral("Number of I/O worker threads (0 = single-threaded)."),
+                                           QStringLiteral("count"),
+                                           QString::number(QThread::idealThreadCount()));
+    parser.addOption(workersOption);
+    const QCommandLineOption statsIntervalOption(QStringLiteral("stats-interval"),
+                                                 QStringLiteral("Seconds between per-command stats dumps (0 = off)."),
+                                                 QStringLiteral("seconds"),
+                                                 QStringLiteral("0"));
+    parser.addOption(statsIntervalOption);
+    const QCommandLineOption dbThreadsOption(QStringLiteral("db-threads"),
+                                             QStringLiteral("Threads running blocking commands (LOGIN, REGISTER)."),
+                                             QStringLiteral("count"),
+                                             QStringLiteral("4"));
+    parser.addOption(dbThreadsOption);
+    const QCommandLineOption maxQueueOption(QStringLiteral("max-queue"),
+                                            QStringLiteral("Pending blocking commands before new ones are refused."),
+                                            QStringLiteral("count"),
+                                            QStringLiteral("4096"));
+    parser.addOption(maxQueueOption);
+    const QCommandLineOption maxInFlightOption(QStringLiteral("max-inflight"),
+                                               QStringLiteral("Requests per connection awaiting a reply before reading pauses."),
+                                               QStringLiteral("count"),
+                                               QStringLiteral("64"));
+    parser.addOption(maxInFlightOption);
+    const QCommandLineOption kdfIterationsOption(QStringLiteral("kdf-iterations"),
+                                                 QStringLiteral("PBKDF2 iterations for new password hashes."),
+                                                 QStringLiteral("count"),
+                                                 QStringLiteral("100000"));
+    parser.addOption(kdfIterationsOption);
+    const QCommandLineOption kdfThreadsOption(QStringLiteral("kdf-threads"),
+                                              QStringLiteral("Threads dedicated to password hashing."),
+                                              QStringLiteral("count"),
+                                              QString::number(qMax(1, QThread::idealThreadCount() / 2)));
+    parser.addOption(kdfThreadsOption);
+    const QCommandLineOption sessionTtlOption(QStringLiteral("session-ttl"),
+                                              QStringLiteral("Seconds a login token stays valid without use."),
+                                              QStringLiteral("seconds"),
+                                              QStringLiteral("86400"));
+    parser.addOption(sessionTtlOption);
+    const QCommandLineOption sessionSnapshotOption(QStringLiteral("session-snapshot"),
+                                                   QStringLiteral("File that keeps login sessions across restarts."),
+                                                   QStringLiteral("path"));
+    parser.addOption(sessionSnapshotOption);
+    const QCommandLineOption auctionShardsOption(QStringLiteral("auction-shards"),
+                                                 QStringLiteral("Threads owning auction state; bids are sharded by auction id."),
+                                                 QStringLiteral("count"),
+                                                 QString::number(qMax(1, QThread::idealThreadCount() / 2)));
+    parser.addOption(auctionShardsOption);
+    const QCommandLineOption writeBatchOption(QStringLiteral("write-batch"),
+                                              QStringLiteral("Most inserts (users, bids) committed in one transaction."),
+                                              QStringLiteral("count"),
+                                              QStringLiteral("256"));
+    parser.addOption(writeBatchOption);
+    const QCommandLineOption writeWindowOption(QStringLiteral("write-window-ms"),
+                                               QStringLiteral("How long a pending insert waits for others to share its commit."),
+                                               QStringLiteral("ms"),
+                                               QStringLiteral("2"));
+    parser.addOption(writeWindowOption);
+    const QCommandLineOption userCacheOption(QStringLiteral("user-cache"),
+                                             QStringLiteral("Accounts kept in the login cache (0 = off)."),
+                                             QStringLiteral("count"),
+                                             QStringLiteral("100000"));
+    parser.addOption(userCacheOption);
+    const QCommandLineOption tcpModeOption(QStringLiteral("tcp-mode"),
+                                           QStringLiteral("Reply socket policy: nodelay or nagle."),
+                                           QStringLiteral("mode"),
+                                           QStringLiteral("nodelay"));
+    parser.addOption(tcpModeOption);
+    const QCommandLineOption writeHighWaterOption(QStringLiteral("write-high-water"),
+                                                  QStringLiteral("KiB of unsent replies at which a connection stops being read."),
+                                                  QStringLiteral("kib"),
+                                                  QStringLiteral("1024"));
+    parser.addOption(writeHighWaterOption);
+    const QCommandLineOption writeLowWaterOption(QStringLiteral("write-low-water"),
+                                                 QStringLiteral("KiB of unsent replies below which reading resumes."),
+                                                 QStringLiteral("kib"),
+                                                 QStringLiteral("256"));
+    parser.addOption(writeLowWaterOption);
+    const QCommandLineOption maxSessionsOption(QStringLiteral("max-sessions"),
+                                               QStringLiteral("Concurrent sessions; further connections are closed "
+                                                              "on accept (0 = no limit)."),
+                                               QStringLiteral("count"),
+                                               QStringLiteral("10000"));
+    parser.addOption(maxSessionsOption);
+    const QCommandLineOption acceptRateOption(QStringLiteral("accept-rate"),
+                                              QStringLiteral("New connections admitted per second (0 = no limit)."),
+                                              QStringLiteral("count"),
+                                              QStringLiteral("2000"));
+    parser.addOption(acceptRateOption);
+    const QCommandLineOption maxBufferOption(QStringLiteral("max-buffer"),
+                                             QStringLiteral("KiB a session may buffer without completing a frame."),
+                                             QStringLiteral("kib"),
+                                             QStringLiteral("4096"));
+    parser.addOption(maxBufferOption);
+    const QCommandLineOption frameTimeoutOption(QStringLiteral("frame-timeout"),
+                                                QStringLiteral("Seconds a started frame may take to arrive (0 = no limit)."),
+                                                QStringLiteral("seconds"),
+                                                QStringLiteral("10"));
+    parser.addOption(frameTimeoutOption);
+    const QCommandLineOption idleTimeoutOption(QStringLiteral("idle-timeout"),
+                                               QStringLiteral("Seconds without traffic before a session is closed "
+                                                              "(0 = never)."),
+                                               QStringLiteral("seconds"),
+                                               QStringLiteral("300"));
+    parser.addOption(idleTimeoutOption);
+    const QCommandLineOption limitAuthAddressOption(QStringLiteral("limit-auth-ip"),
+                                                    QStringLiteral("LOGIN/REGISTER per client address, as rate:burst "
+                                                                   "per second (0 = off)."),
+                                                    QStringLiteral("rate:burst"),
+                                                    QStringLiteral("2:20"));
+    parser.addOption(limitAuthAddressOption);
+    const QCommandLineOption limitAuthUserOption(QStringLiteral("limit-auth-user"),
+                                                 QStringLiteral("Failed LOGINs per username, as rate:burst."),
+                                                 QStringLiteral("rate:burst"),
+                                                 QStringLiteral("0.2:5"));
+    parser.addOption(limitAuthUserOption);
+    const QCommandLineOption limitWriteOption(QStringLiteral("limit-write-ip"),
+                                              QStringLiteral("CREATE_AUCTION/PLACE_BID per client address."),
+                                              QStringLiteral("rate:burst"),
+                                              QStringLiteral("200:400"));
+    parser.addOption(limitWriteOption);
+    const QCommandLineOption limitReadOption(QStringLiteral("limit-read-ip"),
+                                             QStringLiteral("GET_AUCTION/SUBSCRIBE per client address."),
+                                             QStringLiteral("rate:burst"),
+                                             QStringLiteral("1000:2000"));
+    parser.addOption(limitReadOption);
+    const QCommandLineOption limitStatsOption(QStringLiteral("limit-stats-ip"),
+                                              QStringLiteral("STATS per client address."),
+                                              QStringLiteral("rate:burst"),
+                                              QStringLiteral("1:5"));
+    parser.addOption(limitStatsOption);
+    const QCommandLineOption rateLimitKeysOption(QStringLiteral("rate-limit-keys"),
+                                                 QStringLiteral("Token buckets kept in memory (0 = no rate limiting)."),
+                                                 QStringLiteral("count"),
+                                                 QStringLiteral("100000"));
+    parser.addOption(rateLimitKeysOption);
+    const QCommandLineOption shutdownGraceOption(QStringLiteral("shutdown-grace"),
+                                                 QStringLiteral("Seconds SIGTERM waits for in-flight requests before "
+                                                                "closing the remaining sessions."),
+                                                 QStringLiteral("seconds"),
+                                                 QStringLiteral("10"));
+    parser.addOption(shutdownGraceOption);
+    const QCommandLineOption reusePortOption(QStringLiteral("reuse-port"),
+                                             QStringLiteral("Listen with SO_REUSEPORT (1/0), so a new server can "
+                                                            "take over the port while this one drains."),
+                                             QStringLiteral("on"),
+                                             QStringLiteral("0"));
+    parser.addOption(reusePortOption);
+    const QCommandLineOption metricsPortOption(QStringLiteral("metrics-port"),
+                                               QStringLiteral("Serve Prometheus metrics on this port (0 = off)."),
+                                               QStringLiteral("port"),
+                                               QStringLiteral("0"));
+    parser.addOption(metricsPortOption);
+    const QCommandLineOption metricsBindOption(QStringLiteral("metrics-bind"),
+                                               QStringLiteral("Address the metrics endpoint listens on."),
+                                               QStringLiteral("address"),
+                                               QStringLiteral("127.0.0.1"));
+    parser.addOption(metricsBindOption);
+    const QCommandLineOption logLevelOption(QStringLiteral("log-level"),
+                                            QStringLiteral("trace, debug, info, warning, error or off. Per-frame "
+                                                           "traces are logged at debug."),
+                                            QStringLiteral("level"),
+                                            QStringLiteral("info"));
+    parser.addOption(logLevelOption);
+    const QCommandLineOption logFileOption(QStringLiteral("log-file"),
+                                           QStringLiteral("Append log lines to this file instead of stdout."),
+                                           QStringLiteral("path"));
+    parser.addOption(logFileOption);
+    const QCommandLineOption logSampleOption(QStringLiteral("log-sample"),
+                                             QStringLiteral("Keep one per-frame trace in every N per thread."),
+                                             QStringLiteral("n"),
+                                             QStringLiteral("1"));
+    parser.addOption(logSampleOption);
+    parser.process(app);
+
+    std::unique_ptr<QSettings> config;
+    if (parser.isSet(configOption)) {
+        config = std::make_unique<QSettings>(parser.value(configOption), QSettings::IniFormat);
+        if (config->status() != QSettings::NoError || !QFile::exists(parser.value(configOption))) {
+            qCritical("Cannot read config file.");
+            return 1;
+        }
+    }
+    // Command line, then config file, then the built-in default.
+    auto setting = [&parser, &config](const QCommandLineOption &option) {
+        if (parser.isSet(option) || !config) {
+            return parser.value(option);
+        }
+        return config->value(option.names().constFirst(), parser.value(option)).toString();
+    };
+
+    quint16 port = 0;
+    if (!parsePort(setting(portOption), false, port)) {
+        qCritical("--port must be between 1 and 65535.");
+        return 1;
+    }
+    quint16 metricsPort = 0;
+    if (!parsePort(setting(metricsPortOption), true, metricsPort)) {
+        qCritical("--metrics-port must be between 0 (off) and 65535.");
+        return 1;
+    }
+
+    AsyncLog::Level logLevel = AsyncLog::Level::Info;
+    if (!AsyncLog::parseLevel(setting(logLevelOption), logLevel)) {
+        qWarning("Unknown log level, using info.");
+    }
+    AsyncLog::setLevel(logLevel);
+    AsyncLog::setFrameSampling(qMax(1u, setting(logSampleOption).toUInt()));
+    if (!AsyncLog::start(setting(logFileOption))) {
+        qCritical("Unable to open log file.");
+        return 1;
+    }
+
+    SqliteOptions sqliteOptions;
+    sqliteOptions.journalMode = setting(journalModeOption);
+    sqliteOptions.synchronous = setting(synchronousOption);
+    sqliteOptions.mmapSizeBytes = qMax(0ll, setting(mmapOption).toLongLong()) * 1024 * 1024;
+    sqliteOptions.cacheSizeKb = qMax(1, setting(pageCacheOption).toInt()) * 1024;
+    sqliteOptions.busyTimeoutMs = qMax(0, setting(busyTimeoutOption).toInt());
+
     Database database;
-    if (!database.open(dbPath)) {
+    if (!database.open(setting(dbOption), sqliteOptions)) {
         qCritical("Failed to open database.");
         return 1;
     }
+    if (!database.migrate()) {
+        return 1;
+    }
+    const int userCacheSize = setting(userCacheOption).toInt();
+    if (userCacheSize > 0 && !database.enableUserCache(userCacheSize)) {
+        qWarning("User cache disabled.");
+    }
+
+    WriteBatchOptions batchOptions;
+    batchOptions.maxBatch = qMax(1, setting(writeBatchOption).toInt());
+    batchOptions.windowMs = qMax(0, setting(writeWindowOption).toInt());
+    WriteBatcher writeBatcher(database, batchOptions);
+
+    WorkerPool workers(setting(dbThreadsOption).toInt(), setting(maxQueueOption).toInt());
+    PasswordHasher hasher(setting(kdfIterationsOption).toInt(), setting(kdfThreadsOption).toInt(),
+                          setting(maxQueueOption).toInt());
+
+    SessionStore sessions(setting(sessionTtlOption).toLongLong());
+    const QString snapshotPath = setting(sessionSnapshotOption);
+    if (!snapshotPath.isEmpty() && sessions.loadSnapshot(snapshotPath)) {
+        qInfo("Restored %d session(s) from snapshot", sessions.size());
+    }
+    QTimer sweepTimer;
+    QObject::connect(&sweepTimer, &QTimer::timeout, &sweepTimer, [&sessions]() { sessions.sweep(); });
+    sweepTimer.start(1000);
+    QTimer snapshotTimer;
+    if (!snapshotPath.isEmpty()) {
+        QObject::connect(&snapshotTimer, &QTimer::timeout, &snapshotTimer, [&sessions, snapshotPath]() {
+            sessions.saveSnapshot(snapshotPath);
+        });
+        snapshotTimer.start(60 * 1000);
+    }
+
+    PriceFeed priceFeed;
+    AuctionEngine auctions(database, writeBatcher, setting(auctionShardsOption).toInt(),
+                           setting(maxQueueOption).toInt());
+    auctions.restore();
+    QObject::connect(&sweepTimer, &QTimer::timeout, &sweepTimer, [&auctions]() { auctions.closeExpired(); });
+    auctions.setBidListener([&priceFeed](const AuctionRecord &auction, qint64 minimumBid) {
+        priceFeed.publish(auction, minimumBid);
+    });
+
+    CommandHandler handler(database, hasher, sessions, auctions, priceFeed, writeBatcher, &workers);
+    RateLimitOptions rateLimits;
+    rateLimits.maxKeys = setting(rateLimitKeysOption).toInt();
+    if (!parseRateLimit(setting(limitAuthAddressOption), rateLimits.authPerAddress)
+        || !parseRateLimit(setting(limitAuthUserOption), rateLimits.authPerUser)
+        || !parseRateLimit(setting(limitWriteOption), rateLimits.writePerAddress)
+        || !parseRateLimit(setting(limitReadOption), rateLimits.readPerAddress)
+        || !parseRateLimit(setting(limitStatsOption), rateLimits.statsPerAddress)) {
+        qCritical("Rate limits must look like rate or rate:burst.");
+        return 1;
+    }
+    if (rateLimits.maxKeys > 0) {
+        handler.setRateLimits(rateLimits);
+    }
 
-    loadSchema(database);
+    SessionOptions sessionOptions;
+    sessionOptions.maxInFlight = qMax(1, setting(maxInFlightOption).toInt());
+    sessionOptions.writeHighWaterBytes = qMax(1ll, setting(writeHighWaterOption).toLongLong()) * 1024;
+    sessionOptions.writeLowWaterBytes =
+        qBound(0ll, setting(writeLowWaterOption).toLongLong() * 1024, sessionOptions.writeHighWaterBytes);
+    const QString tcpMode = setting(tcpModeOption);
+    sessionOptions.writeMode = tcpMode == QLatin1String("nagle") ? TcpWriteMode::Nagle : TcpWriteMode::NoDelay;
+    sessionOptions.maxBufferedBytes = qMax(1ll, setting(maxBufferOption).toLongLong()) * 1024;
+    sessionOptions.frameTimeoutMs = qMax(0, setting(frameTimeoutOption).toInt()) * 1000;
+    sessionOptions.idleTimeoutMs = qMax(0, setting(idleTimeoutOption).toInt()) * 1000;
 
-    CommandHandler handler(database);
+    AdmissionOptions admission;
+    admission.maxSessions = qMax(0, setting(maxSessionsOption).toInt());
+    admission.acceptRate = qMax(0, setting(acceptRateOption).toInt());
 
     TcpServer server(&handler);
-    const quint16 port = 5555;
-    if (!server.start(port)) {
+    server.setWorkerCount(setting(workersOption).toInt());
+    server.setSessionOptions(sessionOptions);
+    server.setAdmissionOptions(admission);
+    server.setReusePort(QVariant(setting(reusePortOption)).toBool());
+    const QString bindAddress = setting(bindOption);
+    if (!server.start(port, bindAddress.isEmpty() ? QHostAddress(QHostAddress::Any) : QHostAddress(bindAddress))) {
         qCritical("Unable to start server on port %hu", port);
         return 1;
     }
 
-    qInfo("Server listening on port %hu", port);
-    return app.exec();
+    qInfo("Server listening on port %hu with %d I/O worker(s)", port, server.workerCount());
+
+    // Everything read here lives until after app.exec() returns.
+    Metrics::Registry &metrics = Metrics::Registry::instance();
+    metrics.callback("auction_sessions", "Open client sessions.", Metrics::Kind::Gauge,
+                     [&server]() { return server.sessionCount(); });
+    metrics.callback("auction_rejected_connections_total", "Connections closed by admission control.",
+                     Metrics::Kind::Counter, [&server]() { return static_cast<double>(server.rejectedConnections()); });
+    metrics.callback("auction_throttled_requests_total", "Requests refused by rate limiting.", Metrics::Kind::Counter,
+                     [&handler]() { return static_cast<double>(handler.throttledRequests()); });
+    metrics.callback("auction_queue_depth", "Jobs waiting in a worker queue.", Metrics::Kind::Gauge,
+                     [&workers]() { return workers.pendingJobs(); }, "queue", "workers");
+    metrics.callback("auction_queue_depth", "Jobs waiting in a worker queue.", Metrics::Kind::Gauge,
+                     [&writeBatcher]() { return writeBatcher.pendingWrites(); }, "queue", "write_batcher");
+    metrics.callback("auction_log_dropped_total", "Log records dropped because a ring was full.",
+                     Metrics::Kind::Counter, []() { return static_cast<double>(AsyncLog::droppedRecords()); });
+
+    MetricsEndpoint metricsEndpoint;
+    if (metricsPort > 0) {
+        const QString metricsBind = setting(metricsBindOption);
+        if (!metricsEndpoint.start(metricsPort, QHostAddress(metricsBind))) {
+            return 1;
+        }
+        qInfo("Metrics on http://%s:%hu/metrics", qPrintable(metricsBind), metricsPort);
+    }
+
+    QTimer statsTimer;
+    const int statsInterval = setting(statsIntervalOption).toInt();
+    if (statsInterval > 0) {
+        QObject::connect(&statsTimer, &QTimer::timeout, &handler, [&handler]() {
+            qInfo().noquote() << "[STATS]" << QJsonDocument(handler.commandStats()).toJson(QJsonDocument::Compact);
+        });
+        statsTimer.start(statsInterval * 1000);
+    }
+
+    // SIGTERM / SIGINT: stop accepting, tell sessions, and quit once they
+    // have all closed or the grace period is over. A second signal quits now.
+    const int shutdownGraceMs = qMax(0, setting(shutdownGraceOption).toInt()) * 1000;
+    QTimer shutdownTimer;
+    QElapsedTimer shutdownClock;
+    auto beginShutdown = [&]() {
+        if (server.isShuttingDown()) {
+            qWarning("[SERVER] Second signal, stopping without waiting.");
+            app.quit();
+            return;
+        }
+        qInfo("[SERVER] Shutting down, draining %d session(s)", server.sessionCount());
+        server.beginShutdown(shutdownGraceMs);
+        shutdownClock.start();
+        QObject::connect(&shutdownTimer, &QTimer::timeout, &app, [&]() {
+            if (server.sessionCount() == 0 || shutdownClock.hasExpired(shutdownGraceMs)) {
+                shutdownTimer.stop();
+                app.quit();
+            }
+        });
+        shutdownTimer.start(50);
+    };
+#ifdef Q_OS_UNIX
+    QLocalSocket signalSocket;
+    if (installTerminationHandlers()
+        && signalSocket.setSocketDescriptor(signalPipe[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly)) {
+        QObject::connect(&signalSocket, &QLocalSocket::readyRead, &app, [&]() {
+            for (qint64 n = signalSocket.readAll().size(); n > 0; --n) {
+                beginShutdown();
+            }
+        });
+    } else {
+        qWarning("Cannot install signal handlers; SIGTERM will not drain.");
+    }
+#else
+    Q_UNUSED(beginShutdown);
+#endif
+
+    const int exitCode = app.exec();
+    if (server.sessionCount() > 0) {
+        qInfo("[SERVER] Closing %d session(s) still open", server.sessionCount());
+    }
+    // Let queued commands finish while their sessions still exist.
+    workers.drain();
+    hasher.drain();
+    auctions.drain();
+    writeBatcher.drain();
+    database.checkpoint();
+    if (!snapshotPath.isEmpty()) {
+        sessions.saveSnapshot(snapshotPath);
+    }
+    AsyncLog::stop();
+    return exitCode;
 }
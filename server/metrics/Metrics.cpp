@@ -0,0 +1,244 @@
+#include "Metrics.h"
+
+#include <QJsonObject>
+#include <QtAlgorithms>
+
+#include <cmath>
+
+namespace Metrics {
+
+namespace {
+// Prometheus buckets: powers of two from ~1us to ~69s, in nanoseconds.
+constexpr int kFirstExportExponent = 10;
+constexpr int kLastExportExponent = 36;
+
+QByteArray seriesKey(const QByteArray &name, const QByteArray &labelValue)
+{
+    return labelValue.isEmpty() ? name : name + ':' + labelValue;
+}
+
+QByteArray labelSet(const QByteArray &label, const QByteArray &value, const QByteArray &extra = QByteArray())
+{
+    QByteArray out;
+    if (!label.isEmpty()) {
+        out += label + "=\"" + value + '"';
+    }
+    if (!extra.isEmpty()) {
+        if (!out.isEmpty()) {
+            out += ',';
+        }
+        out += extra;
+    }
+    return out.isEmpty() ? out : '{' + out + '}';
+}
+
+QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 10);
+}
+} // namespace
+
+quint64 Counter::value() const
+{
+    quint64 total = 0;
+    for (const Cell &cell : cells) {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int Histogram::bucketFor(quint64 valueNs)
+{
+    if (valueNs < kSubBuckets) {
+        return static_cast<int>(valueNs);
+    }
+    const int exponent = 63 - qCountLeadingZeroBits(valueNs);
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    const int sub = static_cast<int>((valueNs >> (exponent - kSubBits)) & (kSubBuckets - 1));
+    return (exponent - kSubBits + 1) * kSubBuckets + sub;
+}
+
+quint64 Histogram::bucketLowerBound(int index)
+{
+    if (index < kSubBuckets) {
+        return static_cast<quint64>(index);
+    }
+    const int exponent = index / kSubBuckets + kSubBits - 1;
+    const quint64 sub = static_cast<quint64>(index % kSubBuckets);
+    return (kSubBuckets + sub) << (exponent - kSubBits);
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot out;
+    out.buckets.assign(kBuckets, 0);
+    for (const Shard &shard : shards) {
+        for (int i = 0; i < kBuckets; ++i) {
+            const quint64 n = shard.buckets[i].load(std::memory_order_relaxed);
+            out.buckets[i] += n;
+            out.count += n;
+        }
+        out.sumNs += shard.sumNs.load(std::memory_order_relaxed);
+        out.maxNs = qMax(out.maxNs, shard.maxNs.load(std::memory_order_relaxed));
+    }
+    return out;
+}
+
+quint64 Histogram::Snapshot::quantileNs(double q) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    const quint64 target = qMax<quint64>(1, static_cast<quint64>(std::ceil(q * count)));
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            const quint64 low = bucketLowerBound(i);
+            const quint64 high = bucketLowerBound(i + 1);
+            return qMin(maxNs, low + (high - low) / 2);
+        }
+    }
+    return maxNs;
+}
+
+quint64 Histogram::Snapshot::countBelow(quint64 limitNs) const
+{
+    quint64 total = 0;
+    for (int i = 0; i < kBuckets && bucketLowerBound(i + 1) <= limitNs; ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+Registry &Registry::instance()
+{
+    static Registry registry;
+    return registry;
+}
+
+Registry::Series &Registry::findOrAdd(const QByteArray &name, const QByteArray &help, Kind kind,
+                                      const QByteArray &label, const QByteArray &labelValue)
+{
+    Family &family = families[name];
+    if (family.series.empty()) {
+        family.help = help;
+        family.kind = kind;
+    }
+    for (const auto &series : family.series) {
+        if (series->label == label && series->labelValue == labelValue) {
+            return *series;
+        }
+    }
+    family.series.push_back(std::make_unique<Series>());
+    Series &series = *family.series.back();
+    series.label = label;
+    series.labelValue = labelValue;
+    return series;
+}
+
+Counter *Registry::counter(const QByteArray &name, const QByteArray &help, const QByteArray &label,
+                           const QByteArray &labelValue)
+{
+    QMutexLocker locker(&mutex);
+    Series &series = findOrAdd(name, help, Kind::Counter, label, labelValue);
+    if (!series.counter) {
+        series.counter = std::make_unique<Counter>();
+    }
+    return series.counter.get();
+}
+
+Histogram *Registry::histogram(const QByteArray &name, const QByteArray &help, const QByteArray &label,
+                               const QByteArray &labelValue)
+{
+    QMutexLocker locker(&mutex);
+    Series &series = findOrAdd(name, help, Kind::Histogram, label, labelValue);
+    if (!series.histogram) {
+        series.histogram = std::make_unique<Histogram>();
+    }
+    return series.histogram.get();
+}
+
+void Registry::callback(const QByteArray &name, const QByteArray &help, Kind kind, std::function<double()> read,
+                        const QByteArray &label, const QByteArray &labelValue)
+{
+    QMutexLocker locker(&mutex);
+    findOrAdd(name, help, kind, label, labelValue).read = std::move(read);
+}
+
+QJsonObject Registry::toJson() const
+{
+    QJsonObject counters;
+    QJsonObject gauges;
+    QJsonObject histograms;
+
+    QMutexLocker locker(&mutex);
+    for (const auto &[name, family] : families) {
+        for (const auto &series : family.series) {
+            const QString key = QString::fromLatin1(seriesKey(name, series->labelValue));
+            if (series->histogram) {
+                const Histogram::Snapshot snapshot = series->histogram->snapshot();
+                QJsonObject row;
+                row.insert(QStringLiteral("count"), static_cast<qint64>(snapshot.count));
+                row.insert(QStringLiteral("meanUs"), snapshot.count ? snapshot.sumNs / 1000.0 / snapshot.count : 0.0);
+                row.insert(QStringLiteral("p50Us"), snapshot.quantileNs(0.50) / 1000.0);
+                row.insert(QStringLiteral("p90Us"), snapshot.quantileNs(0.90) / 1000.0);
+                row.insert(QStringLiteral("p99Us"), snapshot.quantileNs(0.99) / 1000.0);
+                row.insert(QStringLiteral("p999Us"), snapshot.quantileNs(0.999) / 1000.0);
+                row.insert(QStringLiteral("maxUs"), snapshot.maxNs / 1000.0);
+                histograms.insert(key, row);
+            } else if (series->counter) {
+                counters.insert(key, static_cast<qint64>(series->counter->value()));
+            } else if (series->read) {
+                (family.kind == Kind::Counter ? counters : gauges).insert(key, series->read());
+            }
+        }
+    }
+
+    QJsonObject out;
+    out.insert(QStringLiteral("counters"), counters);
+    out.insert(QStringLiteral("gauges"), gauges);
+    out.insert(QStringLiteral("histograms"), histograms);
+    return out;
+}
+
+QByteArray Registry::toPrometheus() const
+{
+    QByteArray out;
+    QMutexLocker locker(&mutex);
+    for (const auto &[name, family] : families) {
+        const char *type = family.kind == Kind::Counter ? "counter"
+                           : family.kind == Kind::Gauge ? "gauge"
+                                                        : "histogram";
+        out += "# HELP " + name + ' ' + family.help + '\n';
+        out += "# TYPE " + name + ' ' + type + '\n';
+
+        for (const auto &series : family.series) {
+            if (series->histogram) {
+                const Histogram::Snapshot snapshot = series->histogram->snapshot();
+                for (int exponent = kFirstExportExponent; exponent <= kLastExportExponent; ++exponent) {
+                    const quint64 limitNs = quint64(1) << exponent;
+                    out += name + "_bucket"
+                           + labelSet(series->label, series->labelValue, "le=\"" + number(limitNs / 1e9) + '"') + ' '
+                           + QByteArray::number(snapshot.countBelow(limitNs)) + '\n';
+                }
+                out += name + "_bucket" + labelSet(series->label, series->labelValue, "le=\"+Inf\"") + ' '
+                       + QByteArray::number(snapshot.count) + '\n';
+                out += name + "_sum" + labelSet(series->label, series->labelValue) + ' '
+                       + number(snapshot.sumNs / 1e9) + '\n';
+                out += name + "_count" + labelSet(series->label, series->labelValue) + ' '
+                       + QByteArray::number(snapshot.count) + '\n';
+            } else {
+                const double value = series->counter ? static_cast<double>(series->counter->value())
+                                     : series->read  ? series->read()
+                                                     : 0.0;
+                out += name + labelSet(series->label, series->labelValue) + ' ' + number(value) + '\n';
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace Metrics
@@ -0,0 +1,155 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Process-wide metrics: counters, latency histograms and read-on-export
+// callbacks, exported as JSON (STATS command) and Prometheus text.
+//
+// Recording is a relaxed atomic add into a cell picked by the calling thread,
+// so hot paths on different threads never share a cache line and never take a
+// lock. Look a metric up once (registration locks) and keep the pointer; it
+// lives as long as the process.
+namespace Metrics {
+
+constexpr int kShards = 8;
+
+// Stable per-thread cell index, handed out round-robin on first use.
+inline int shardIndex()
+{
+    static std::atomic<int> nextShard{0};
+    thread_local const int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+
+class Counter
+{
+public:
+    void add(quint64 amount = 1)
+    {
+        cells[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    quint64 value() const;
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<quint64> value{0};
+    };
+    std::array<Cell, kShards> cells;
+};
+
+// Log-linear latency histogram in nanoseconds, HDR style: values below 16 are
+// exact, above that every power of two is split into 16 buckets, so any
+// reported quantile is within about 6% of the true value.
+class Histogram
+{
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kMaxExponent = 47; // ~39 hours; larger values are clamped
+    static constexpr int kBuckets = kSubBuckets * (kMaxExponent - kSubBits + 2);
+
+    void record(quint64 valueNs)
+    {
+        Shard &shard = shards[shardIndex()];
+        shard.buckets[bucketFor(valueNs)].fetch_add(1, std::memory_order_relaxed);
+        shard.sumNs.fetch_add(valueNs, std::memory_order_relaxed);
+        quint64 seen = shard.maxNs.load(std::memory_order_relaxed);
+        while (valueNs > seen && !shard.maxNs.compare_exchange_weak(seen, valueNs, std::memory_order_relaxed)) {
+        }
+    }
+
+    struct Snapshot
+    {
+        std::vector<quint64> buckets;
+        quint64 count = 0;
+        quint64 sumNs = 0;
+        quint64 maxNs = 0;
+
+        // Midpoint of the bucket holding quantile q (0..1), capped at maxNs.
+        quint64 quantileNs(double q) const;
+        // Samples below limitNs; exact when limitNs is a power of two.
+        quint64 countBelow(quint64 limitNs) const;
+    };
+    Snapshot snapshot() const;
+
+    static int bucketFor(quint64 valueNs);
+    static quint64 bucketLowerBound(int index);
+
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<quint64>, kBuckets> buckets{};
+        std::atomic<quint64> sumNs{0};
+        std::atomic<quint64> maxNs{0};
+    };
+    std::array<Shard, kShards> shards;
+};
+
+enum class Kind
+{
+    Counter,
+    Gauge,
+    Histogram,
+};
+
+// Metric names follow Prometheus conventions. Each series may carry one label
+// (e.g. command="LOGIN"); registering the same name and label twice returns
+// the existing series.
+class Registry
+{
+public:
+    static Registry &instance();
+
+    Counter *counter(const QByteArray &name, const QByteArray &help, const QByteArray &label = QByteArray(),
+                     const QByteArray &labelValue = QByteArray());
+    Histogram *histogram(const QByteArray &name, const QByteArray &help, const QByteArray &label = QByteArray(),
+                         const QByteArray &labelValue = QByteArray());
+    // Read on export, on the exporting thread. kind is Counter or Gauge. Whatever
+    // read captures must outlive every export; main() registers these for
+    // objects that live until the event loop has stopped.
+    void callback(const QByteArray &name, const QByteArray &help, Kind kind, std::function<double()> read,
+                  const QByteArray &label = QByteArray(), const QByteArray &labelValue = QByteArray());
+
+    // {"counters":{"name":n,"name:label":n},"gauges":{...},
+    //  "histograms":{"name":{"count":n,"meanUs":x,"p50Us":x,...,"maxUs":x}}}
+    QJsonObject toJson() const;
+    // Prometheus text exposition format 0.0.4; latencies in seconds.
+    QByteArray toPrometheus() const;
+
+private:
+    struct Series
+    {
+        QByteArray label;
+        QByteArray labelValue;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;
+    };
+    struct Family
+    {
+        QByteArray help;
+        Kind kind = Kind::Counter;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    Series &findOrAdd(const QByteArray &name, const QByteArray &help, Kind kind, const QByteArray &label,
+                      const QByteArray &labelValue);
+
+    mutable QMutex mutex;
+    std::map<QByteArray, Family> families;
+};
+
+} // namespace Metrics
+
+#endif // METRICS_H
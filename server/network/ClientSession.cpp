@@ -1,90 +1,440 @@
 #include "ClientSession.h"
 
+#include "AsyncLog.h"
+#include "TimerWheel.h"
+#include "metrics/Metrics.h"
 #include "protocol/CommandHandler.h"
 #include "protocol/Protocol.h"
 
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QDebug>
+#include <QThread>
 
-ClientSession::ClientSession(QTcpSocket *socket, CommandHandler *handler, QObject *parent)
+#include <utility>
+
+namespace {
+struct SessionMetrics
+{
+    Metrics::Counter *framesIn;
+    Metrics::Counter *framesOut;
+    Metrics::Counter *bytesIn;
+    Metrics::Counter *bytesOut;
+    Metrics::Histogram *decode;
+};
+
+const SessionMetrics &sessionMetrics()
+{
+    static const SessionMetrics metrics = []() {
+        Metrics::Registry &registry = Metrics::Registry::instance();
+        return SessionMetrics{
+            registry.counter("auction_frames_received_total", "Frames decoded from clients."),
+            registry.counter("auction_frames_sent_total", "Replies and pushes queued to clients."),
+            registry.counter("auction_bytes_received_total", "Bytes read from client sockets."),
+            registry.counter("auction_bytes_sent_total", "Bytes written to client sockets."),
+            registry.histogram("auction_decode_seconds", "Time to decode and parse one frame."),
+        };
+    }();
+    return metrics;
+}
+} // namespace
+
+ClientSession::ClientSession(QTcpSocket *socket, CommandHandler *handler, const SessionOptions &options,
+                             QObject *parent)
     : QObject(parent)
     , socket(socket)
+    , peer(socket->peerAddress().toString())
     , commandHandler(handler)
+    , options(options)
 {
+    socket->setReadBufferSize(options.readBufferBytes);
+    // Batching happens in the outbox, so Nagle would only add latency.
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, options.writeMode == TcpWriteMode::Nagle ? 0 : 1);
     connect(socket, &QTcpSocket::readyRead, this, &ClientSession::handleReadyRead);
     connect(socket, &QTcpSocket::disconnected, this, &ClientSession::handleDisconnected);
+    connect(socket, &QTcpSocket::bytesWritten, this, &ClientSession::handleBytesWritten);
+}
+
+void ClientSession::watchDeadlines(TimerWheel *timerWheel)
+{
+    wheel = timerWheel;
+    lastActivityMs = wheel->now();
+    if (options.idleTimeoutMs > 0) {
+        wheel->schedule(this, lastActivityMs + options.idleTimeoutMs);
+    }
+}
+
+qint64 ClientSession::checkDeadlines(qint64 nowMs)
+{
+    if (peerGone) {
+        return 0;
+    }
+    qint64 next = 0;
+    auto keepEarliest = [&next](qint64 deadline) {
+        if (next == 0 || deadline < next) {
+            next = deadline;
+        }
+    };
+
+    if (options.frameTimeoutMs > 0 && frameStartedMs >= 0) {
+        const qint64 deadline = frameStartedMs + options.frameTimeoutMs;
+        if (readPaused || writeBlocked) {
+            // Bytes wait in the decoder because of our own backpressure.
+            keepEarliest(nowMs + options.frameTimeoutMs);
+        } else if (nowMs >= deadline) {
+            abortConnection("frame not completed in time");
+            return 0;
+        } else {
+            keepEarliest(deadline);
+        }
+    }
+
+    if (options.idleTimeoutMs > 0) {
+        const qint64 deadline = lastActivityMs + options.idleTimeoutMs;
+        if (inFlight > 0) {
+            keepEarliest(qMax(deadline, nowMs + options.idleTimeoutMs));
+        } else if (nowMs >= deadline) {
+            abortConnection("idle timeout");
+            return 0;
+        } else {
+            keepEarliest(deadline);
+        }
+    }
+    return next;
 }
 
-QString ClientSession::peerAddress() const
+void ClientSession::touch()
 {
-    return socket ? socket->peerAddress().toString() : QString();
+    if (wheel) {
+        lastActivityMs = wheel->now();
+    }
+}
+
+void ClientSession::abortConnection(const char *reason)
+{
+    qWarning() << "[SERVER]" << reason << "from" << peerAddress() << ", closing";
+    decoder.clear();
+    socket->abort(); // emits disconnected()
 }
 
 void ClientSession::handleReadyRead()
 {
-    buffer.append(socket->readAll());
+    if (closing) {
+        // Left unread, data would turn the close into a reset and could cost
+        // the peer its last replies.
+        socket->readAll();
+        return;
+    }
+    if (draining) {
+        const QByteArray data = socket->readAll();
+        sessionMetrics().bytesIn->add(static_cast<quint64>(data.size()));
+        decoder.append(data);
+        rejectBuffered();
+        return;
+    }
+    if (readPaused || writeBlocked) {
+        return; // left in the socket until in-flight work or unsent replies drain
+    }
+    const QByteArray data = socket->readAll();
+    sessionMetrics().bytesIn->add(static_cast<quint64>(data.size()));
+    decoder.append(data);
     processBuffer();
 }
 
-void ClientSession::processBuffer()
+void ClientSession::processBuffer(bool drainAll)
 {
-    auto parseLen = [](const QByteArray &header) -> int {
-        const QList<QByteArray> parts = header.trimmed().split(';');
-        for (const QByteArray &p : parts) {
-            if (p.startsWith("LEN=")) {
-                bool ok = false;
-                int len = p.mid(4).toInt(&ok);
-                if (ok) return len;
-            }
-        }
-        return 0;
-    };
+    if (processing) {
+        return;
+    }
+    if (decoder.bufferedBytes() > options.maxBufferedBytes) {
+        abortConnection("read buffer limit exceeded");
+        return;
+    }
+    processing = true;
 
-    while (true) {
-        if (currentHeader.isEmpty()) {
-            const int newlineIndex = buffer.indexOf('\n');
-            if (newlineIndex == -1) {
-                return; // wait for more data
+    const SessionMetrics &metrics = sessionMetrics();
+    RawFrame raw;
+    FrameDecoder::Status status = FrameDecoder::Status::NeedMore;
+    quint64 decoded = 0;
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    while ((drainAll || (!readPaused && !writeBlocked)) && !draining
+           && (status = decoder.next(raw)) == FrameDecoder::Status::Ready) {
+        Frame frame = parseFrame(raw);
+        frame.session = this;
+        metrics.decode->record(static_cast<quint64>(decodeTimer.nsecsElapsed()));
+        AsyncLog::frame("[CLIENT->SERVER] %s req %d len %d", frame.command, static_cast<qint64>(frame.requestId),
+                        raw.payload.size());
+        ++decoded;
+        processFrame(frame);
+        decodeTimer.start();
+    }
+    processing = false;
+    if (decoded > 0) {
+        metrics.framesIn->add(decoded);
+    }
+
+    if (wheel) {
+        if (decoded > 0) {
+            touch();
+        }
+        if (decoder.bufferedBytes() == 0) {
+            frameStartedMs = -1;
+        } else if (decoded > 0 || frameStartedMs < 0) {
+            frameStartedMs = wheel->now();
+            if (options.frameTimeoutMs > 0) {
+                wheel->schedule(this, frameStartedMs + options.frameTimeoutMs);
             }
-            currentHeader = buffer.left(newlineIndex + 1);
-            buffer.remove(0, newlineIndex + 1);
-            expectedPayloadLen = parseLen(currentHeader);
         }
+    }
 
-        if (expectedPayloadLen > buffer.size()) {
-            return; // wait for full payload
+    if (status == FrameDecoder::Status::Malformed) {
+        qWarning() << "[SERVER] malformed frame header from" << peerAddress() << ", closing";
+        decoder.clear();
+        socket->disconnectFromHost();
+    }
+}
+
+void ClientSession::processFrame(const Frame &frame)
+{
+    const quint64 sequence = nextSequence++;
+    ++inFlight;
+
+    if (frame.commandId == BinaryProtocol::Command::Hello) {
+        negotiateProtocol(frame, sequence);
+        return;
+    }
+
+    if (!commandHandler) {
+        completeRequest(sequence, Response{BinaryProtocol::Command::Error, 0, {{"message", "No handler"}}});
+        return;
+    }
+
+    // The session is not deleted while inFlight > 0, so capturing this is safe.
+    commandHandler->dispatch(frame, [this, sequence](const Response &response) {
+        if (QThread::currentThread() == thread()) {
+            completeRequest(sequence, response);
+            return;
         }
+        QMetaObject::invokeMethod(this, [this, sequence, response]() {
+            completeRequest(sequence, response);
+        }, Qt::QueuedConnection);
+    });
 
-        QByteArray payload = buffer.left(expectedPayloadLen);
-        buffer.remove(0, expectedPayloadLen);
+    if (inFlight >= options.maxInFlight) {
+        readPaused = true;
+    }
+}
 
-        if (!commandHandler) {
-            sendResponse(buildResponse(QStringLiteral("ERROR"), 0, {{"message", "No handler"}}));
-        } else {
-            Frame frame = parseFrame(currentHeader, payload);
-            qInfo() << "[CLIENT->SERVER]" << frame.command << "req" << frame.requestId << "len" << payload.size();
-            const QByteArray response = commandHandler->handle(frame);
-            sendResponse(response);
+void ClientSession::negotiateProtocol(const Frame &frame, quint64 sequence)
+{
+    qint64 requested = 1;
+    if (!BinaryProtocol::toInt64(frame.payload.value(QStringLiteral("protocol")), requested)) {
+        requested = 1; // missing or malformed: stay on text
+    }
+    const ProtocolVersion agreed = requested >= 2 ? ProtocolVersion::Binary : ProtocolVersion::Text;
+    // Peers that match replies by REQ can take them as soon as they complete.
+    const bool wantOrdered = frame.payload.value(QStringLiteral("ordered")).toBool(true);
+
+    // The reply still uses the old encoding; the peer switches once it reads it.
+    QCborMap payload;
+    payload.insert(QStringLiteral("protocol"), static_cast<int>(agreed));
+    payload.insert(QStringLiteral("ordered"), wantOrdered);
+    completeRequest(sequence, Response{BinaryProtocol::Command::HelloOk, frame.requestId, payload});
+
+    ordered = wantOrdered;
+    protocolVersion = agreed;
+    decoder.setMode(agreed == ProtocolVersion::Binary ? FrameDecoder::Mode::Binary : FrameDecoder::Mode::Text);
+}
+
+void ClientSession::completeRequest(quint64 sequence, const Response &response)
+{
+    --inFlight;
+    const QByteArray data = encodeResponse(response, protocolVersion);
+
+    if (!ordered) {
+        sendResponse(data);
+    } else if (sequence == nextToWrite) {
+        sendResponse(data);
+        ++nextToWrite;
+        for (auto it = heldResponses.begin(); it != heldResponses.end() && it.key() == nextToWrite;
+             it = heldResponses.erase(it)) {
+            sendResponse(it.value());
+            ++nextToWrite;
         }
+    } else {
+        heldResponses.insert(sequence, data);
+    }
 
-        currentHeader.clear();
-        expectedPayloadLen = -1;
+    if (peerGone) {
+        if (inFlight == 0) {
+            emit sessionClosed(this);
+        }
+        return;
     }
+
+    if (readPaused && inFlight < options.maxInFlight) {
+        readPaused = false;
+        resumeReading();
+    }
+    closeIfDrained();
 }
 
-void ClientSession::processFrame(const Frame &frame)
+void ClientSession::resumeReading()
 {
-    Q_UNUSED(frame);
+    if (processing || peerGone || readPaused || writeBlocked || draining) {
+        return;
+    }
+    if (socket->bytesAvailable() > 0) {
+        const QByteArray data = socket->readAll();
+        sessionMetrics().bytesIn->add(static_cast<quint64>(data.size()));
+        decoder.append(data);
+    }
+    processBuffer();
 }
 
 void ClientSession::handleDisconnected()
 {
-    emit sessionClosed(this);
+    peerGone = true;
+    if (inFlight == 0) {
+        emit sessionClosed(this);
+    }
+}
+
+void ClientSession::pushUpdate(const PriceUpdate &update)
+{
+    if (peerGone) {
+        return;
+    }
+    if (heldPushes.isEmpty() && unsentBytes() <= options.pushHighWaterBytes) {
+        queueWrite(update.frame(protocolVersion));
+        return;
+    }
+    // Replaces any older price for the same auction that has not gone out yet.
+    heldPushes.insert(update.auctionId, update);
+    flushPushes();
+}
+
+void ClientSession::beginShutdown(int graceMs)
+{
+    if (draining || peerGone) {
+        return;
+    }
+    // Requests the peer sent before the notice still get real answers.
+    if (socket->bytesAvailable() > 0) {
+        const QByteArray data = socket->readAll();
+        sessionMetrics().bytesIn->add(static_cast<quint64>(data.size()));
+        decoder.append(data);
+    }
+    processBuffer(true);
+    if (peerGone || socket->state() != QAbstractSocket::ConnectedState) {
+        return; // processBuffer dropped the peer: malformed frame or oversized buffer
+    }
+    draining = true;
+    frameStartedMs = -1;
+
+    QCborMap payload;
+    payload.insert(QStringLiteral("reason"), QStringLiteral("shutdown"));
+    payload.insert(QStringLiteral("graceMs"), graceMs);
+    queueWrite(encodeResponse(Response{BinaryProtocol::Command::ServerShutdown, 0, payload}, protocolVersion));
+    closeIfDrained();
+}
+
+void ClientSession::rejectBuffered()
+{
+    static const QCborMap payload{
+        {QStringLiteral("code"), 503},
+        {QStringLiteral("message"), QStringLiteral("Server shutting down")},
+    };
+
+    // closeIfDrained() waits until the loop is done, so every frame in this
+    // batch gets its reply before the connection closes.
+    processing = true;
+    RawFrame raw;
+    FrameDecoder::Status status;
+    while ((status = decoder.next(raw)) == FrameDecoder::Status::Ready) {
+        const Frame frame = parseFrame(raw);
+        const quint64 sequence = nextSequence++;
+        ++inFlight;
+        completeRequest(sequence, commandHandler ? commandHandler->failResponse(frame, payload)
+                                                 : Response{BinaryProtocol::Command::Error, frame.requestId, payload});
+    }
+    processing = false;
+    if (status == FrameDecoder::Status::Malformed || decoder.bufferedBytes() > options.maxBufferedBytes) {
+        decoder.clear();
+    }
+    closeIfDrained();
+}
+
+void ClientSession::closeIfDrained()
+{
+    if (!draining || closing || peerGone || processing || inFlight > 0) {
+        return;
+    }
+    flushPushes();
+    flushOutbox();
+    closing = true;
+    socket->disconnectFromHost(); // closes once everything written has been sent
+}
+
+void ClientSession::handleBytesWritten()
+{
+    touch();
+    if (!heldPushes.isEmpty()) {
+        flushPushes();
+    }
+    if (writeBlocked && socket->bytesToWrite() <= options.writeLowWaterBytes) {
+        writeBlocked = false;
+        resumeReading();
+    }
+}
+
+void ClientSession::flushPushes()
+{
+    if (peerGone || unsentBytes() > options.pushHighWaterBytes) {
+        return;
+    }
+    const QHash<qint64, PriceUpdate> pushes = std::exchange(heldPushes, {});
+    for (const PriceUpdate &update : pushes) {
+        queueWrite(update.frame(protocolVersion));
+    }
+}
+
+void ClientSession::queueWrite(const QByteArray &data)
+{
+    sessionMetrics().framesOut->add();
+    if (outbox.isEmpty()) {
+        outbox = data; // shares the buffer; a lone frame is never copied
+    } else {
+        outbox.append(data);
+    }
+    if (!flushScheduled) {
+        flushScheduled = true;
+        QMetaObject::invokeMethod(this, &ClientSession::flushOutbox, Qt::QueuedConnection);
+    }
+}
+
+void ClientSession::flushOutbox()
+{
+    flushScheduled = false;
+    if (outbox.isEmpty() || peerGone || closing) {
+        outbox.clear();
+        return;
+    }
+
+    sessionMetrics().bytesOut->add(static_cast<quint64>(outbox.size()));
+    // One contiguous buffer per pass means one send() for everything queued.
+    socket->write(outbox);
+    outbox.clear();
+
+    if (!writeBlocked && socket->bytesToWrite() > options.writeHighWaterBytes) {
+        writeBlocked = true;
+    }
 }
 
 void ClientSession::sendResponse(const QByteArray &data)
 {
-    if (!socket) return;
-    qInfo() << "[SERVER->CLIENT] bytes" << data.size();
-    socket->write(data);
+    if (!socket || peerGone) return;
+    AsyncLog::frame("[SERVER->CLIENT] bytes %d", QByteArray(), data.size(), 0);
+    queueWrite(data);
 }
@@ -1,38 +1,130 @@
 #ifndef CLIENTSESSION_H
 #define CLIENTSESSION_H
 
+#include <QHash>
+#include <QMap>
 #include <QObject>
 #include <QTcpSocket>
 
+#include "FrameDecoder.h"
+#include "auction/PriceFeed.h"
 #include "protocol/Protocol.h"
 
 class CommandHandler;
+class TimerWheel;
+
+enum class TcpWriteMode
+{
+    NoDelay, // TCP_NODELAY; each flushed batch goes out immediately
+    Nagle,   // kernel default
+};
+
+struct SessionOptions
+{
+    // Reading pauses once this many requests await a reply.
+    int maxInFlight = 64;
+    // Cap on Qt's socket read buffer, so a paused session pushes back on TCP.
+    qint64 readBufferBytes = 256 * 1024;
+    // Above this many unsent bytes, pushes are held back and merged per auction.
+    qint64 pushHighWaterBytes = 64 * 1024;
+    // Reading stops while more than writeHighWaterBytes are unsent and resumes
+    // once the peer has drained them below writeLowWaterBytes.
+    qint64 writeHighWaterBytes = 1024 * 1024;
+    qint64 writeLowWaterBytes = 256 * 1024;
+    TcpWriteMode writeMode = TcpWriteMode::NoDelay;
+    // Bytes a peer may have buffered without completing a frame; this also
+    // bounds the largest frame the server accepts.
+    qint64 maxBufferedBytes = 4 * 1024 * 1024;
+    // A started frame must be complete within this long (0 = no limit).
+    int frameTimeoutMs = 10 * 1000;
+    // Closes sessions that neither sent a frame nor read a byte for this long
+    // while nothing was in flight (0 = never).
+    int idleTimeoutMs = 5 * 60 * 1000;
+};
 
 class ClientSession : public QObject
 {
     Q_OBJECT
 
 public:
-    ClientSession(QTcpSocket *socket, CommandHandler *handler, QObject *parent = nullptr);
-    QString peerAddress() const;
+    ClientSession(QTcpSocket *socket, CommandHandler *handler, const SessionOptions &options = SessionOptions(),
+                  QObject *parent = nullptr);
+    // Captured when the session is created; safe to read from any thread.
+    QString peerAddress() const { return peer; }
+
+    // Enforces frameTimeoutMs and idleTimeoutMs through wheel, which must live
+    // on the session's thread and outlive it. Sessions without one never time out.
+    void watchDeadlines(TimerWheel *wheel);
+    // Called by the wheel. Closes the session if a deadline has passed and
+    // returns when it next needs checking, or 0 for never.
+    qint64 checkDeadlines(qint64 nowMs);
+
+    // Writes a PRICE_UPDATE push, or keeps only the newest one per auction
+    // while the peer is not keeping up. Call on the session's thread.
+    void pushUpdate(const PriceUpdate &update);
+
+    // Dispatches every complete request already received, then sends
+    // SERVER_SHUTDOWN. Requests that arrive after that are answered with a
+    // FAIL reply (code 503). The connection closes once every dispatched
+    // request has been answered. Call on the session's thread.
+    void beginShutdown(int graceMs);
 
 signals:
+    // Emitted once the peer is gone and no reply is still owed to it.
     void sessionClosed(ClientSession *session);
 
 private slots:
     void handleReadyRead();
     void handleDisconnected();
+    void handleBytesWritten();
 
 private:
     void processFrame(const Frame &frame);
-    void processBuffer();
+    // drainAll dispatches every complete frame, ignoring the in-flight and
+    // write limits; used once, right before shutting down.
+    void processBuffer(bool drainAll = false);
+    // While draining: answers each complete frame with a 503 FAIL.
+    void rejectBuffered();
+    void negotiateProtocol(const Frame &frame, quint64 sequence);
+    void completeRequest(quint64 sequence, const Response &response);
     void sendResponse(const QByteArray &data);
+    void flushPushes();
+    // Outgoing frames are gathered here and written once per event-loop pass.
+    void queueWrite(const QByteArray &data);
+    void flushOutbox();
+    qint64 unsentBytes() const { return socket->bytesToWrite() + outbox.size(); }
+    void resumeReading();
+    void touch();
+    void abortConnection(const char *reason);
+    void closeIfDrained();
 
     QTcpSocket *socket;
+    const QString peer;
     CommandHandler *commandHandler;
-    QByteArray buffer;
-    QByteArray currentHeader;
-    int expectedPayloadLen = -1;
+    const SessionOptions options;
+    FrameDecoder decoder;
+    ProtocolVersion protocolVersion = ProtocolVersion::Text;
+
+    // Replies are written in request order unless the peer negotiated
+    // out-of-order delivery; early completions wait in heldResponses.
+    bool ordered = true;
+    quint64 nextSequence = 0;
+    quint64 nextToWrite = 0;
+    QMap<quint64, QByteArray> heldResponses;
+    QHash<qint64, PriceUpdate> heldPushes;
+    QByteArray outbox;
+    bool flushScheduled = false;
+    int inFlight = 0;
+    bool readPaused = false;  // too many requests in flight
+    bool writeBlocked = false; // peer is not reading its replies
+    bool processing = false;
+    bool peerGone = false;
+    bool draining = false; // SERVER_SHUTDOWN sent; new requests are refused
+    bool closing = false;  // disconnectFromHost() called
+
+    TimerWheel *wheel = nullptr;
+    qint64 lastActivityMs = 0;
+    qint64 frameStartedMs = -1; // -1 while no partial frame is buffered
 };
 
 #endif // CLIENTSESSION_H
@@ -0,0 +1,158 @@
+#include "IoWorkerPool.h"
+
+#include "AsyncLog.h"
+
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QThread>
+
+#include <utility>
+
+IoWorker::IoWorker(CommandHandler *handler, const SessionOptions &options, QObject *parent)
+    : QObject(parent)
+    , commandHandler(handler)
+    , sessionOptions(options)
+    , wheel(250, 512, this)
+{
+}
+
+void IoWorker::adoptSocket(qintptr descriptor)
+{
+    auto *socket = new QTcpSocket();
+    if (!socket->setSocketDescriptor(descriptor)) {
+        qWarning() << "[SERVER] failed to adopt socket:" << socket->errorString();
+        delete socket;
+        activeSessions.deref();
+        return;
+    }
+
+    auto *session = new ClientSession(socket, commandHandler, sessionOptions, this);
+    socket->setParent(session);
+    sessions.append(session);
+    session->watchDeadlines(&wheel);
+
+    const QString addr = session->peerAddress();
+    const quint16 port = socket->peerPort();
+    AsyncLog::log(AsyncLog::Level::Info, "[SERVER] client connected %s:%d", addr.toLatin1(), port);
+    emit clientConnected(addr);
+
+    connect(session, &ClientSession::sessionClosed, this, &IoWorker::handleSessionClosed);
+    connect(session, &ClientSession::destroyed, this, [this, session]() {
+        sessions.removeOne(session);
+        wheel.cancel(session);
+    });
+    if (shutdownGraceMs >= 0) {
+        session->beginShutdown(shutdownGraceMs);
+    }
+}
+
+void IoWorker::beginShutdown(int graceMs)
+{
+    shutdownGraceMs = graceMs;
+    for (ClientSession *session : std::as_const(sessions)) {
+        session->beginShutdown(graceMs);
+    }
+}
+
+void IoWorker::handleSessionClosed(ClientSession *session)
+{
+    const QString addr = session->peerAddress();
+    AsyncLog::log(AsyncLog::Level::Info, "[SERVER] client disconnected %s", addr.toLatin1());
+    activeSessions.deref();
+    wheel.cancel(session);
+    emit clientDisconnected(addr);
+    session->deleteLater();
+}
+
+IoWorkerPool::IoWorkerPool(CommandHandler *handler, int workerCount, const SessionOptions &options,
+                           QObject *parent)
+    : QObject(parent)
+{
+    if (workerCount <= 0) {
+        auto *worker = new IoWorker(handler, options, this);
+        connect(worker, &IoWorker::clientConnected, this, &IoWorkerPool::clientConnected);
+        connect(worker, &IoWorker::clientDisconnected, this, &IoWorkerPool::clientDisconnected);
+        workers.append(worker);
+        return;
+    }
+
+    for (int i = 0; i < workerCount; ++i) {
+        auto *thread = new QThread(this);
+        thread->setObjectName(QStringLiteral("io-worker-%1").arg(i));
+
+        auto *worker = new IoWorker(handler, options);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(worker, &IoWorker::clientConnected, this, &IoWorkerPool::clientConnected);
+        connect(worker, &IoWorker::clientDisconnected, this, &IoWorkerPool::clientDisconnected);
+
+        workers.append(worker);
+        threads.append(thread);
+        thread->start();
+    }
+}
+
+IoWorkerPool::~IoWorkerPool()
+{
+    for (QThread *thread : threads) {
+        thread->quit();
+    }
+    for (QThread *thread : threads) {
+        thread->wait();
+    }
+}
+
+void IoWorkerPool::dispatch(qintptr descriptor)
+{
+    IoWorker *worker = pickWorker();
+    worker->reserve();
+    if (threads.isEmpty()) {
+        worker->adoptSocket(descriptor);
+        return;
+    }
+    QMetaObject::invokeMethod(worker, [worker, descriptor]() {
+        worker->adoptSocket(descriptor);
+    }, Qt::QueuedConnection);
+}
+
+void IoWorkerPool::beginShutdown(int graceMs)
+{
+    for (IoWorker *worker : std::as_const(workers)) {
+        if (threads.isEmpty()) {
+            worker->beginShutdown(graceMs);
+            continue;
+        }
+        // Queued behind any adoptSocket() already dispatched to this worker.
+        QMetaObject::invokeMethod(worker, [worker, graceMs]() {
+            worker->beginShutdown(graceMs);
+        }, Qt::QueuedConnection);
+    }
+}
+
+int IoWorkerPool::sessionCount() const
+{
+    int total = 0;
+    for (const IoWorker *worker : workers) {
+        total += worker->sessionCount();
+    }
+    return total;
+}
+
+IoWorker *IoWorkerPool::pickWorker()
+{
+    // Scan from the round-robin cursor so equally loaded workers take turns.
+    const int count = workers.size();
+    int best = nextWorker % count;
+    int bestLoad = workers.at(best)->sessionCount();
+    for (int i = 1; i < count && bestLoad > 0; ++i) {
+        const int candidate = (nextWorker + i) % count;
+        const int load = workers.at(candidate)->sessionCount();
+        if (load < bestLoad) {
+            best = candidate;
+            bestLoad = load;
+        }
+    }
+    nextWorker = (best + 1) % count;
+    return workers.at(best);
+}
@@ -0,0 +1,79 @@
+#ifndef IOWORKERPOOL_H
+#define IOWORKERPOOL_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QVector>
+
+#include "ClientSession.h"
+#include "TimerWheel.h"
+
+class CommandHandler;
+class QThread;
+
+// Owns the sessions of one event loop. Lives on its own QThread, or on the
+// listening thread when the pool runs in single-threaded mode.
+class IoWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    IoWorker(CommandHandler *handler, const SessionOptions &options, QObject *parent = nullptr);
+
+    int sessionCount() const { return activeSessions.loadRelaxed(); }
+    // Counted at dispatch time so a burst of accepts spreads before adoption runs.
+    void reserve() { activeSessions.ref(); }
+
+    // Called on the worker's thread; wraps the accepted descriptor in a session.
+    void adoptSocket(qintptr descriptor);
+    // Called on the worker's thread; starts the shutdown of every session,
+    // including ones adopted afterwards.
+    void beginShutdown(int graceMs);
+
+signals:
+    void clientConnected(const QString &address);
+    void clientDisconnected(const QString &address);
+
+private slots:
+    void handleSessionClosed(ClientSession *session);
+
+private:
+    CommandHandler *commandHandler;
+    const SessionOptions sessionOptions;
+    QVector<ClientSession *> sessions;
+    TimerWheel wheel; // idle and frame deadlines of this thread's sessions
+    QAtomicInt activeSessions;
+    int shutdownGraceMs = -1; // set once the server is shutting down
+};
+
+// Spreads accepted sockets across N worker event loops, picking the least
+// loaded worker (round-robin among ties).
+class IoWorkerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    // workerCount == 0 keeps every session on the calling thread.
+    IoWorkerPool(CommandHandler *handler, int workerCount, const SessionOptions &options,
+                 QObject *parent = nullptr);
+    ~IoWorkerPool() override;
+
+    void dispatch(qintptr descriptor);
+    // Tells every session on every worker that the server is going away.
+    void beginShutdown(int graceMs);
+    int workerCount() const { return threads.size(); }
+    int sessionCount() const;
+
+signals:
+    void clientConnected(const QString &address);
+    void clientDisconnected(const QString &address);
+
+private:
+    IoWorker *pickWorker();
+
+    QVector<IoWorker *> workers;
+    QVector<QThread *> threads;
+    int nextWorker = 0;
+};
+
+#endif // IOWORKERPOOL_H
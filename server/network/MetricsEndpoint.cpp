@@ -0,0 +1,69 @@
+#include "MetricsEndpoint.h"
+
+#include "metrics/Metrics.h"
+
+#include <QDebug>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace {
+constexpr int kMaxRequestBytes = 8 * 1024;
+constexpr int kRequestTimeoutMs = 5000;
+
+QByteArray httpResponse(const QByteArray &status, const QByteArray &contentType, const QByteArray &body)
+{
+    return "HTTP/1.0 " + status + "\r\nContent-Type: " + contentType + "\r\nContent-Length: "
+           + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+}
+} // namespace
+
+MetricsEndpoint::MetricsEndpoint(QObject *parent)
+    : QObject(parent)
+    , server(this)
+{
+    connect(&server, &QTcpServer::newConnection, this, &MetricsEndpoint::handleNewConnection);
+}
+
+bool MetricsEndpoint::start(quint16 port, const QHostAddress &address)
+{
+    if (!server.listen(address, port)) {
+        qWarning() << "Metrics listen failed:" << server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsEndpoint::handleNewConnection()
+{
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { handleReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        // A scraper that never finishes its request does not keep the socket.
+        QTimer::singleShot(kRequestTimeoutMs, socket, [socket]() { socket->abort(); });
+    }
+}
+
+void MetricsEndpoint::handleReadyRead(QTcpSocket *socket)
+{
+    // Only the request line matters; wait for the end of the headers.
+    const QByteArray head = socket->peek(kMaxRequestBytes);
+    if (!head.contains("\r\n\r\n") && !head.contains("\n\n")) {
+        if (head.size() >= kMaxRequestBytes) {
+            socket->abort();
+        }
+        return;
+    }
+    socket->disconnect(this);
+    socket->readAll();
+
+    const QList<QByteArray> requestLine = head.left(head.indexOf('\n')).trimmed().split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QByteArray path = requestLine.value(1);
+    if (method == "GET" && (path == "/metrics" || path.startsWith("/metrics?"))) {
+        socket->write(httpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                                   Metrics::Registry::instance().toPrometheus()));
+    } else {
+        socket->write(httpResponse("404 Not Found", "text/plain", "Not found\n"));
+    }
+    socket->disconnectFromHost();
+}
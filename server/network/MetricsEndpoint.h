@@ -0,0 +1,30 @@
+#ifndef METRICSENDPOINT_H
+#define METRICSENDPOINT_H
+
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Minimal HTTP/1.0 responder for Prometheus scrapes: GET /metrics returns the
+// registry in text format, anything else gets 404. Runs on the thread that
+// owns it, separate from the protocol port, and closes after each reply.
+class MetricsEndpoint : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsEndpoint(QObject *parent = nullptr);
+
+    // Loopback unless told otherwise: the metrics are not authenticated.
+    bool start(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+
+private:
+    void handleNewConnection();
+    void handleReadyRead(QTcpSocket *socket);
+
+    QTcpServer server;
+};
+
+#endif // METRICSENDPOINT_H
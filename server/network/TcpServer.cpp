@@ -1,49 +1,227 @@
 #include "TcpServer.h"
 
-#include "ClientSession.h"
+#include "AsyncLog.h"
+#include "IoWorkerPool.h"
 #include "protocol/CommandHandler.h"
 
 #include <QDebug>
+#include <QTcpSocket>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+void ListenSocket::incomingConnection(qintptr socketDescriptor)
+{
+    if (onIncoming) {
+        onIncoming(socketDescriptor);
+    }
+}
 
 TcpServer::TcpServer(CommandHandler *handler, QObject *parent)
     : QObject(parent)
     , commandHandler(handler)
 {
-    connect(&server, &QTcpServer::newConnection, this, &TcpServer::handleNewConnection);
+    server.onIncoming = [this](qintptr socketDescriptor) {
+        handleNewConnection(socketDescriptor);
+    };
+    admitTimer.setSingleShot(true);
+    connect(&admitTimer, &QTimer::timeout, this, &TcpServer::admitQueued);
+}
+
+TcpServer::~TcpServer()
+{
+    server.close();
+    while (!queuedDescriptors.isEmpty()) {
+        reject(queuedDescriptors.dequeue(), nullptr);
+    }
+    delete pool;
+}
+
+void TcpServer::setWorkerCount(int count)
+{
+    if (pool) {
+        qWarning() << "Worker count must be set before the server starts.";
+        return;
+    }
+    workers = qMax(0, count);
 }
 
-bool TcpServer::start(quint16 port)
+bool TcpServer::start(quint16 port, const QHostAddress &address)
 {
-    if (!server.listen(QHostAddress::Any, port)) {
+    if (!pool) {
+        pool = new IoWorkerPool(commandHandler, workers, sessionOptions);
+        connect(pool, &IoWorkerPool::clientConnected, this, &TcpServer::clientConnected);
+        connect(pool, &IoWorkerPool::clientDisconnected, this, &TcpServer::clientDisconnected);
+    }
+
+    acceptClock.start();
+    lastRefillNs = 0;
+    acceptTokens = qMax(1, admission.acceptRate / 10);
+
+    if (reusePort) {
+        return listenReusePort(port, address);
+    }
+    if (!server.listen(address, port)) {
         qWarning() << "Server listen failed:" << server.errorString();
         return false;
     }
     return true;
 }
 
-void TcpServer::handleNewConnection()
+bool TcpServer::listenReusePort(quint16 port, const QHostAddress &address)
 {
-    while (server.hasPendingConnections()) {
-        QTcpSocket *socket = server.nextPendingConnection();
-        auto *session = new ClientSession(socket, commandHandler, this);
-        sessions.append(session);
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    // QTcpServer::listen() cannot set options before bind(), so the socket is
+    // built here and handed over already listening.
+    const bool anyAddress = address == QHostAddress(QHostAddress::Any);
+    const bool v6 = anyAddress || address.protocol() == QAbstractSocket::IPv6Protocol;
+    const int fd = ::socket(v6 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        qWarning() << "Server socket failed:" << std::strerror(errno);
+        return false;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
 
-        const QString addr = socket->peerAddress().toString();
-        const quint16 port = socket->peerPort();
-        qInfo() << "[SERVER] client connected" << addr << ":" << port;
-        emit clientConnected(addr);
+    const int on = 1;
+    const int off = 0;
+    bool ok = ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == 0
+              && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == 0;
 
-        connect(session, &ClientSession::sessionClosed, this, &TcpServer::handleSessionClosed);
-        connect(session, &ClientSession::destroyed, this, [this, session]() {
-            sessions.removeOne(session);
-        });
+    sockaddr_storage storage{};
+    socklen_t length = 0;
+    if (v6) {
+        auto *in6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        if (anyAddress) {
+            in6->sin6_addr = in6addr_any;
+            // Dual stack, like QTcpServer does for QHostAddress::Any.
+            ok = ok && ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) == 0;
+        } else {
+            const Q_IPV6ADDR raw = address.toIPv6Address();
+            std::memcpy(&in6->sin6_addr, raw.c, sizeof(raw.c));
+        }
+        length = sizeof(sockaddr_in6);
+    } else {
+        auto *in4 = reinterpret_cast<sockaddr_in *>(&storage);
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        in4->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length = sizeof(sockaddr_in);
     }
+    ok = ok && ::bind(fd, reinterpret_cast<sockaddr *>(&storage), length) == 0 && ::listen(fd, SOMAXCONN) == 0;
+    if (!ok) {
+        qWarning() << "Server listen failed:" << std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (!server.setSocketDescriptor(fd)) {
+        qWarning() << "Server listen failed:" << server.errorString();
+        ::close(fd);
+        return false;
+    }
+    return true;
+#else
+    qWarning("SO_REUSEPORT is not available on this platform; listening without it.");
+    if (!server.listen(address, port)) {
+        qWarning() << "Server listen failed:" << server.errorString();
+        return false;
+    }
+    return true;
+#endif
 }
 
-void TcpServer::handleSessionClosed(ClientSession *session)
+void TcpServer::beginShutdown(int graceMs)
 {
-    const QString addr = session->peerAddress();
-    qInfo() << "[SERVER] client disconnected" << addr;
-    emit clientDisconnected(addr);
-    session->deleteLater();
+    if (shuttingDown || !pool) {
+        return;
+    }
+    shuttingDown = true;
+
+    // Connections still in the kernel accept queue would be reset when the
+    // socket closes (with SO_REUSEPORT they are not moved to the other
+    // listener), so take them now; they get the notice like everyone else.
+    if (server.isListening()) {
+        server.waitForNewConnection(0);
+        server.close();
+    }
+    admitTimer.stop();
+    while (!queuedDescriptors.isEmpty()) {
+        pool->dispatch(queuedDescriptors.dequeue());
+    }
+    pool->beginShutdown(graceMs);
+}
+
+int TcpServer::sessionCount() const
+{
+    return pool ? pool->sessionCount() : 0;
+}
+
+void TcpServer::handleNewConnection(qintptr socketDescriptor)
+{
+    if (admission.maxSessions > 0 && sessionCount() + queuedDescriptors.size() >= admission.maxSessions) {
+        reject(socketDescriptor, "[SERVER] session limit reached, connection closed");
+        return;
+    }
+    if (shuttingDown || admission.acceptRate <= 0 || (queuedDescriptors.isEmpty() && takeAcceptToken())) {
+        pool->dispatch(socketDescriptor);
+        return;
+    }
+    if (queuedDescriptors.size() >= admission.acceptQueue) {
+        reject(socketDescriptor, "[SERVER] admission queue full, connection closed");
+        return;
+    }
+
+    // QTcpServer keeps accepting what is already pending in this pass; those
+    // wait here, and anything later stays in the kernel backlog.
+    queuedDescriptors.enqueue(socketDescriptor);
+    if (!admitTimer.isActive()) {
+        server.pauseAccepting();
+        admitTimer.start(qMax(1, static_cast<int>(std::ceil(1000.0 / admission.acceptRate))));
+    }
+}
+
+void TcpServer::admitQueued()
+{
+    while (!queuedDescriptors.isEmpty() && takeAcceptToken()) {
+        pool->dispatch(queuedDescriptors.dequeue());
+    }
+    if (queuedDescriptors.isEmpty()) {
+        server.resumeAccepting();
+        return;
+    }
+    admitTimer.start(qMax(1, static_cast<int>(std::ceil(1000.0 / admission.acceptRate))));
+}
+
+bool TcpServer::takeAcceptToken()
+{
+    const qint64 nowNs = acceptClock.nsecsElapsed();
+    const double burst = qMax(1, admission.acceptRate / 10);
+    acceptTokens = qMin(burst, acceptTokens + (nowNs - lastRefillNs) * admission.acceptRate / 1e9);
+    lastRefillNs = nowNs;
+    if (acceptTokens < 1.0) {
+        return false;
+    }
+    acceptTokens -= 1.0;
+    return true;
+}
+
+void TcpServer::reject(qintptr socketDescriptor, const char *reason)
+{
+    QTcpSocket socket;
+    if (socket.setSocketDescriptor(socketDescriptor)) {
+        socket.abort();
+    }
+    if (reason) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        AsyncLog::log(AsyncLog::Level::Warning, reason);
+    }
 }
@@ -1,13 +1,50 @@
 #ifndef TCPSERVER_H
 #define TCPSERVER_H
 
+#include <QElapsedTimer>
+#include <QHostAddress>
 #include <QObject>
+#include <QQueue>
 #include <QTcpServer>
-#include <QTcpSocket>
-#include <QVector>
+#include <QTimer>
+
+#include <atomic>
+#include <functional>
+
+#include "ClientSession.h"
 
-class ClientSession;
 class CommandHandler;
+class IoWorkerPool;
+
+// QTcpServer that hands raw descriptors to a callback instead of creating
+// QTcpSocket objects on the listening thread.
+class ListenSocket : public QTcpServer
+{
+public:
+    explicit ListenSocket(QObject *parent = nullptr)
+        : QTcpServer(parent)
+    {
+    }
+
+    std::function<void(qintptr)> onIncoming;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+};
+
+struct AdmissionOptions
+{
+    // Connections accepted while this many sessions are open are closed
+    // straight away (0 = no limit).
+    int maxSessions = 10000;
+    // New sessions handed to the I/O threads per second, in bursts of at most
+    // a tenth of that (0 = no limit). Above the rate, accepting pauses and the
+    // kernel backlog absorbs the storm, so established sessions keep their
+    // I/O threads.
+    int acceptRate = 2000;
+    // Accepted sockets that may wait for an admission slot; more are closed.
+    int acceptQueue = 512;
+};
 
 class TcpServer : public QObject
 {
@@ -15,20 +52,59 @@ class TcpServer : public QObject
 
 public:
     explicit TcpServer(CommandHandler *handler, QObject *parent = nullptr);
-    bool start(quint16 port);
+    ~TcpServer() override;
+
+    // Number of I/O threads sessions are spread across; 0 keeps every session
+    // on the listening thread. Must be called before start().
+    void setWorkerCount(int count);
+    int workerCount() const { return workers; }
+    // Applies to sessions accepted after start(); must be called before it.
+    void setSessionOptions(const SessionOptions &options) { sessionOptions = options; }
+    void setAdmissionOptions(const AdmissionOptions &options) { admission = options; }
+    // Binds with SO_REUSEPORT so a second process can listen on the same port
+    // while this one drains. Both must set it. Unix only; must be called
+    // before start().
+    void setReusePort(bool on) { reusePort = on; }
+
+    bool start(quint16 port, const QHostAddress &address = QHostAddress::Any);
+    // Accepts whatever is already waiting, closes the listening socket and
+    // sends SERVER_SHUTDOWN to every session. Sessions close themselves once
+    // their in-flight requests are answered; sessionCount() reaches 0 when
+    // all are gone.
+    void beginShutdown(int graceMs);
+    bool isShuttingDown() const { return shuttingDown; }
+    quint16 serverPort() const { return server.serverPort(); }
+    int sessionCount() const;
+    // Connections closed on accept because of the session limit or a full
+    // admission queue.
+    quint64 rejectedConnections() const { return rejected.load(std::memory_order_relaxed); }
 
 signals:
     void clientConnected(const QString &address);
     void clientDisconnected(const QString &address);
 
-private slots:
-    void handleNewConnection();
-    void handleSessionClosed(ClientSession *session);
-
 private:
-    QTcpServer server;
-    QVector<ClientSession *> sessions;
+    void handleNewConnection(qintptr socketDescriptor);
+    void admitQueued();
+    bool takeAcceptToken();
+    void reject(qintptr socketDescriptor, const char *reason);
+    bool listenReusePort(quint16 port, const QHostAddress &address);
+
+    ListenSocket server;
+    IoWorkerPool *pool = nullptr;
     CommandHandler *commandHandler;
+    int workers = 0;
+    SessionOptions sessionOptions;
+    AdmissionOptions admission;
+    bool reusePort = false;
+    bool shuttingDown = false;
+
+    QQueue<qintptr> queuedDescriptors;
+    QTimer admitTimer;
+    QElapsedTimer acceptClock;
+    double acceptTokens = 0;
+    qint64 lastRefillNs = 0;
+    std::atomic<quint64> rejected{0};
 };
 
 #endif // TCPSERVER_H
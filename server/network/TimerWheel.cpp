@@ -0,0 +1,80 @@
+#include "TimerWheel.h"
+
+#include "ClientSession.h"
+
+TimerWheel::TimerWheel(int tickMs, int bucketCount, QObject *parent)
+    : QObject(parent)
+    , tickMs(qMax(1, tickMs))
+    , timer(this)
+    , buckets(qMax(1, bucketCount))
+{
+    clock.start();
+    timer.setInterval(this->tickMs);
+    connect(&timer, &QTimer::timeout, this, &TimerWheel::tick);
+}
+
+void TimerWheel::schedule(ClientSession *session, qint64 deadlineMs)
+{
+    if (!timer.isActive()) {
+        nextTick = now() / tickMs + 1;
+        timer.start();
+    }
+    // Round up, and never into a bucket the wheel has already passed.
+    const qint64 due = qMax((deadlineMs + tickMs - 1) / tickMs, nextTick);
+    auto it = dueTicks.find(session);
+    if (it != dueTicks.end()) {
+        if (it.value() <= due) {
+            return;
+        }
+        it.value() = due; // the old bucket entry goes stale
+    } else {
+        dueTicks.insert(session, due);
+    }
+    buckets[static_cast<int>(due % buckets.size())].append(session);
+}
+
+void TimerWheel::cancel(ClientSession *session)
+{
+    dueTicks.remove(session);
+}
+
+void TimerWheel::tick()
+{
+    const qint64 currentTick = now() / tickMs;
+    QVector<ClientSession *> expired;
+    for (; nextTick <= currentTick; ++nextTick) {
+        const int index = static_cast<int>(nextTick % buckets.size());
+        QVector<ClientSession *> &bucket = buckets[index];
+        int kept = 0;
+        for (ClientSession *session : bucket) {
+            const auto it = dueTicks.constFind(session);
+            if (it == dueTicks.cend() || it.value() % buckets.size() != index) {
+                continue; // cancelled or moved to another bucket
+            }
+            if (it.value() > nextTick) {
+                bucket[kept++] = session; // due on a later turn of the wheel
+                continue;
+            }
+            dueTicks.erase(it);
+            expired.append(session);
+        }
+        bucket.resize(kept);
+    }
+
+    // Run after the sweep, so sessions rescheduling themselves land in buckets
+    // the wheel has not visited yet.
+    const qint64 nowMs = now();
+    for (ClientSession *session : expired) {
+        const qint64 next = session->checkDeadlines(nowMs);
+        if (next > 0) {
+            schedule(session, next);
+        }
+    }
+
+    if (dueTicks.isEmpty()) {
+        timer.stop();
+        for (QVector<ClientSession *> &bucket : buckets) {
+            bucket.clear();
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class ClientSession;
+
+// Hashed timer wheel shared by every session of one I/O thread, so idle and
+// frame deadlines cost one QTimer per thread instead of one per socket.
+// Deadlines are rounded up to the tick. A session keeps a single entry; moving
+// a deadline later is free, because the session recomputes its real deadline
+// when the entry fires (see ClientSession::checkDeadlines).
+// Must only be used from the thread it lives on.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TimerWheel(int tickMs = 250, int bucketCount = 512, QObject *parent = nullptr);
+
+    // Monotonic milliseconds since the wheel was created.
+    qint64 now() const { return clock.elapsed(); }
+
+    // Checks session at deadlineMs, unless it is already due no later than that.
+    void schedule(ClientSession *session, qint64 deadlineMs);
+    void cancel(ClientSession *session);
+
+private:
+    void tick();
+
+    const int tickMs;
+    QTimer timer;
+    QElapsedTimer clock;
+    qint64 nextTick = 0; // absolute index of the tick handled next
+    // Slots may hold stale entries; dueTicks is authoritative.
+    QVector<QVector<ClientSession *>> buckets;
+    QHash<ClientSession *, qint64> dueTicks;
+};
+
+#endif // TIMERWHEEL_H
@@ -1,62 +1,305 @@
 #include "CommandHandler.h"
 
+#include "auction/AuctionEngine.h"
+#include "auction/PriceFeed.h"
+#include "auth/PasswordHasher.h"
+#include "auth/SessionStore.h"
 #include "db/Database.h"
+#include "db/WriteBatcher.h"
+#include "network/ClientSession.h"
 #include "protocol/Protocol.h"
+#include "protocol/WorkerPool.h"
 
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCborArray>
 #include <QJsonObject>
+#include <QStringList>
 
-CommandHandler::CommandHandler(Database &db, QObject *parent)
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+using BinaryProtocol::Command;
+
+namespace {
+constexpr int kDefaultPageSize = 100;
+constexpr int kMaxPageSize = 500;
+constexpr int kDefaultSearchPageSize = 50;
+constexpr int kMaxSearchPageSize = 100;
+constexpr int kMaxCategoryLength = 64;
+constexpr int kMaxQueryLength = 200;
+constexpr int kMaxQueryTerms = 8;
+
+// Optional integer field: fallback when absent or null, false when it is
+// present but not an integer that fits in qint64.
+bool readInteger(const QCborMap &payload, const QString &key, qint64 fallback, qint64 &out)
+{
+    const QCborValue value = payload.value(key);
+    if (value.isUndefined() || value.isNull()) {
+        out = fallback;
+        return true;
+    }
+    return BinaryProtocol::toInt64(value, out);
+}
+
+// The summary row shared by LIST_AUCTIONS and SEARCH_AUCTIONS.
+QCborMap auctionRow(const AuctionRecord &auction)
+{
+    QCborMap row;
+    row.insert(QStringLiteral("auctionId"), auction.id);
+    row.insert(QStringLiteral("title"), auction.title);
+    row.insert(QStringLiteral("category"), auction.category);
+    row.insert(QStringLiteral("currentPrice"), auction.currentPrice);
+    row.insert(QStringLiteral("minimumBid"), auction.minimumBid());
+    row.insert(QStringLiteral("leaderId"), auction.leaderId);
+    row.insert(QStringLiteral("bidCount"), auction.bidCount);
+    row.insert(QStringLiteral("endsAt"), auction.endsAtMs);
+    row.insert(QStringLiteral("status"), auction.open ? QStringLiteral("open") : QStringLiteral("closed"));
+    return row;
+}
+
+// User text to an FTS5 expression: every word becomes a quoted prefix term,
+// so operators and stray quotes are matched as text and never fail to parse.
+// Empty when there is nothing to search for.
+QString ftsQuery(const QString &text)
+{
+    QStringList terms;
+    for (const QString &word : text.simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+        const bool searchable = std::any_of(word.cbegin(), word.cend(), [](QChar c) { return c.isLetterOrNumber(); });
+        if (!searchable) {
+            continue;
+        }
+        QString term = word;
+        term.replace(QLatin1Char('"'), QLatin1String("\"\""));
+        terms.append(QLatin1Char('"') + term + QLatin1String("\"*"));
+        if (terms.size() == kMaxQueryTerms) {
+            break;
+        }
+    }
+    return terms.join(QLatin1Char(' '));
+}
+
+void runEntry(const CommandRegistry::Entry &entry, const Frame &frame, const CommandRegistry::Responder &done)
+{
+    if (entry.asyncHandler) {
+        entry.asyncHandler(frame, done);
+    } else {
+        done(entry.handler(frame));
+    }
+}
+} // namespace
+
+CommandHandler::CommandHandler(Database &db, PasswordHasher &hasher, SessionStore &sessions, AuctionEngine &auctions,
+                               PriceFeed &feed, WriteBatcher &writer, WorkerPool *workers, QObject *parent)
     : QObject(parent)
     , database(db)
+    , passwordHasher(hasher)
+    , sessionStore(sessions)
+    , auctionEngine(auctions)
+    , priceFeed(feed)
+    , writeBatcher(writer)
+    , workerPool(workers)
+    , dispatchLatency(Metrics::Registry::instance().histogram(
+          "auction_dispatch_seconds", "I/O-thread time per request in dispatch, including handlers that answer inline."))
+{
+    registry.add({Command::Ping, false, RateLimitClass::None, Execution::Sync},
+                 [this](const Frame &frame) { return handlePing(frame); });
+    registry.addAsync({Command::Login, false, RateLimitClass::Auth, Execution::Async},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handleLogin(frame, done); });
+    registry.addAsync({Command::Register, false, RateLimitClass::Auth, Execution::Async},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handleRegister(frame, done); });
+    registry.add({Command::Logout, true, RateLimitClass::None, Execution::Sync},
+                 [this](const Frame &frame) { return handleLogout(frame); });
+    registry.add({Command::Resume, true, RateLimitClass::Read, Execution::Sync},
+                 [this](const Frame &frame) { return handleResume(frame); });
+    // Auction commands only queue onto the owning shard, so they stay off the worker pool.
+    registry.addAsync({Command::CreateAuction, true, RateLimitClass::Write, Execution::Sync},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handleCreateAuction(frame, done); });
+    registry.addAsync({Command::PlaceBid, true, RateLimitClass::Write, Execution::Sync},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handlePlaceBid(frame, done); });
+    registry.addAsync({Command::GetAuction, false, RateLimitClass::Read, Execution::Sync},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handleGetAuction(frame, done); });
+    // Subscriptions are per connection and must be changed on its I/O thread.
+    registry.addAsync({Command::Subscribe, false, RateLimitClass::Read, Execution::Sync},
+                      [this](const Frame &frame, const CommandRegistry::Responder &done) { handleSubscribe(frame, done); });
+    registry.add({Command::Unsubscribe, false, RateLimitClass::None, Execution::Sync},
+                 [this](const Frame &frame) { return handleUnsubscribe(frame); });
+    // Serialising every series is not cheap: logged-in callers only, off the I/O thread.
+    registry.add({Command::Stats, true, RateLimitClass::Stats, Execution::Async},
+                 [this](const Frame &frame) { return handleStats(frame); });
+    // Reads SQLite rather than the shards, so it goes to the worker pool.
+    registry.add({Command::ListAuctions, false, RateLimitClass::Read, Execution::Async},
+                 [this](const Frame &frame) { return handleListAuctions(frame); });
+    registry.add({Command::SearchAuctions, false, RateLimitClass::Read, Execution::Async},
+                 [this](const Frame &frame) { return handleSearchAuctions(frame); });
+}
+
+void CommandHandler::setRateLimits(const RateLimitOptions &options)
 {
+    rateLimiter = std::make_unique<RateLimiter>(options);
 }
 
-QByteArray CommandHandler::handle(const Frame &frame)
+void CommandHandler::dispatch(const Frame &frame, const CommandRegistry::Responder &done)
 {
-    const QString verb = frame.command.toUpper();
-    if (verb == QLatin1String("PING")) {
-        QJsonObject payload;
-        payload.insert(QStringLiteral("message"), QStringLiteral("PONG"));
-        return buildResponse(QStringLiteral("PONG"), frame.requestId, payload);
+    QElapsedTimer timer;
+    timer.start();
+    dispatchFrame(frame, done);
+    dispatchLatency->record(static_cast<quint64>(timer.nsecsElapsed()));
+}
+
+void CommandHandler::dispatchFrame(const Frame &frame, const CommandRegistry::Responder &done)
+{
+    const CommandRegistry::Entry *entry = registry.find(frame.commandId);
+    if (!entry) {
+        done(makeError(frame, QStringLiteral("Unknown command")));
+        return;
+    }
+
+    // Before the login check and any queueing, so a flood costs no SQL or KDF work.
+    const RateLimitClass rateClass = entry->spec.rateLimit;
+    if (rateLimiter && rateClass != RateLimitClass::None) {
+        const QString address = frame.session ? frame.session->peerAddress() : QString();
+        if (!rateLimiter->allow(rateClass, address)) {
+            done(throttledReply(frame));
+            return;
+        }
+    }
+
+    Frame request = frame;
+    if (entry->spec.authRequired) {
+        // Tokens live in memory, so this costs a hash lookup, not a query.
+        SessionInfo session;
+        const QByteArray token = frame.payload.value(QStringLiteral("token")).toString().toLatin1();
+        if (!sessionStore.validate(token, &session)) {
+            QCborMap payload;
+            payload.insert(QStringLiteral("code"), 401);
+            payload.insert(QStringLiteral("message"), QStringLiteral("Not logged in"));
+            done(Response{BinaryProtocol::failReply(frame.commandId), frame.requestId, payload});
+            return;
+        }
+        request.userId = session.userId;
+        request.username = session.username;
     }
 
-    if (verb == QLatin1String("LOGIN")) {
-        return handleLogin(frame);
+    QElapsedTimer timer;
+    timer.start();
+    CommandRegistry::Responder finish = [entry, timer, done](const Response &response) {
+        entry->latency->record(static_cast<quint64>(timer.nsecsElapsed()));
+        done(response);
+    };
+
+    if (entry->spec.execution == Execution::Sync || !workerPool) {
+        runEntry(*entry, request, finish);
+        return;
     }
 
-    if (verb == QLatin1String("REGISTER")) {
-        return handleRegister(frame);
+    if (!workerPool->submit([entry, request, finish]() { runEntry(*entry, request, finish); })) {
+        done(makeError(frame, QStringLiteral("Server busy")));
     }
+}
+
+Response CommandHandler::handlePing(const Frame &frame)
+{
+    QCborMap payload;
+    payload.insert(QStringLiteral("message"), QStringLiteral("PONG"));
+    return Response{Command::Pong, frame.requestId, payload};
+}
 
-    return makeError(frame.command, frame.requestId, QStringLiteral("Unknown command"));
+Response CommandHandler::handleStats(const Frame &frame)
+{
+    QJsonObject payload = Metrics::Registry::instance().toJson();
+    payload.insert(QStringLiteral("commands"), registry.statsSnapshot());
+    return Response{Command::StatsOk, frame.requestId, QCborMap::fromJsonObject(payload)};
 }
 
-QByteArray CommandHandler::handleLogin(const Frame &frame)
+void CommandHandler::handleLogin(const Frame &frame, const CommandRegistry::Responder &done)
 {
     const QString username = frame.payload.value(QStringLiteral("username")).toString();
     const QString password = frame.payload.value(QStringLiteral("password")).toString();
     const QString clientName = frame.payload.value(QStringLiteral("client")).toString();
 
     if (username.isEmpty() || password.isEmpty()) {
-        return makeError(QStringLiteral("LOGIN"), frame.requestId, QStringLiteral("Missing credentials"));
+        done(makeError(frame, QStringLiteral("Missing credentials")));
+        return;
+    }
+    // Only failed attempts drain the per-username budget (see loginFailed).
+    if (rateLimiter && !rateLimiter->loginAllowed(username)) {
+        done(throttledReply(frame));
+        return;
     }
 
-    if (database.verifyLogin(username, password)) {
-        QJsonObject payload;
-        payload.insert(QStringLiteral("userId"), 1);
-        payload.insert(QStringLiteral("username"), username);
-        payload.insert(QStringLiteral("token"), QStringLiteral("demo_token"));
-        payload.insert(QStringLiteral("client"), clientName);
-        return buildResponse(QStringLiteral("LOGIN_OK"), frame.requestId, payload);
+    qint64 userId = 0;
+    QString record;
+    if (!database.findCredentials(username, userId, record)) {
+        // Same KDF work as a wrong password, so response time does not reveal unknown emails.
+        const bool queued = passwordHasher.verifyAsync(password, passwordHasher.decoyRecord(),
+            [this, frame, done](const PasswordHasher::Verdict &) { done(loginFailed(frame)); });
+        if (!queued) {
+            done(makeError(frame, QStringLiteral("Server busy")));
+        }
+        return;
     }
 
-    QJsonObject payload;
+    // The KDF runs on the hasher pool; this worker is free again once it is queued.
+    const bool queued = passwordHasher.verifyAsync(password, record,
+        [this, frame, done, userId, username, password, clientName](const PasswordHasher::Verdict &verdict) {
+            if (!verdict.matches) {
+                done(loginFailed(frame));
+                return;
+            }
+            if (verdict.needsRehash) {
+                // Best effort and off the reply path: the old record keeps working until it lands.
+                passwordHasher.hashAsync(password, [this, userId, username](const QString &upgraded) {
+                    writeBatcher.submit([userId, username, upgraded](Database &db) {
+                        return db.updatePassword(userId, username, upgraded) ? WriteResult::Ok : WriteResult::Failed;
+                    });
+                });
+            }
+
+            QCborMap payload;
+            payload.insert(QStringLiteral("userId"), userId);
+            payload.insert(QStringLiteral("username"), username);
+            payload.insert(QStringLiteral("token"), QString::fromLatin1(sessionStore.issue(userId, username)));
+            payload.insert(QStringLiteral("client"), clientName);
+            done(Response{Command::LoginOk, frame.requestId, payload});
+        });
+    if (!queued) {
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+Response CommandHandler::handleLogout(const Frame &frame)
+{
+    sessionStore.revoke(frame.payload.value(QStringLiteral("token")).toString().toLatin1());
+
+    QCborMap payload;
+    payload.insert(QStringLiteral("message"), QStringLiteral("Logged out"));
+    return Response{Command::LogoutOk, frame.requestId, payload};
+}
+
+Response CommandHandler::handleResume(const Frame &frame)
+{
+    // dispatch already checked the token and slid its expiry forward.
+    QCborMap payload;
+    payload.insert(QStringLiteral("userId"), frame.userId);
+    payload.insert(QStringLiteral("username"), frame.username);
+    return Response{Command::ResumeOk, frame.requestId, payload};
+}
+
+Response CommandHandler::loginFailed(const Frame &frame)
+{
+    if (rateLimiter) {
+        rateLimiter->recordLoginFailure(frame.payload.value(QStringLiteral("username")).toString());
+    }
+
+    QCborMap payload;
     payload.insert(QStringLiteral("code"), 401);
     payload.insert(QStringLiteral("message"), QStringLiteral("Invalid credentials"));
-    return buildResponse(QStringLiteral("LOGIN_FAIL"), frame.requestId, payload);
+    return Response{Command::LoginFail, frame.requestId, payload};
 }
 
-QByteArray CommandHandler::handleRegister(const Frame &frame)
+void CommandHandler::handleRegister(const Frame &frame, const CommandRegistry::Responder &done)
 {
     const QString username = frame.payload.value(QStringLiteral("username")).toString();
     const QString password = frame.payload.value(QStringLiteral("password")).toString();
@@ -64,31 +307,374 @@ QByteArray CommandHandler::handleRegister(const Frame &frame)
     const QString phone = frame.payload.value(QStringLiteral("phone")).toString();
 
     if (username.isEmpty() || password.isEmpty()) {
-        return makeError(QStringLiteral("REGISTER"), frame.requestId, QStringLiteral("Missing fields"));
+        done(makeError(frame, QStringLiteral("Missing fields")));
+        return;
     }
 
     if (database.userExists(username)) {
-        return makeError(QStringLiteral("REGISTER"), frame.requestId, QStringLiteral("Email already registered"));
+        done(makeError(frame, QStringLiteral("Email already registered")));
+        return;
     }
 
     UserRecord user;
     user.email = username;
-    user.password = password;
     user.fullName = fullName.isEmpty() ? username : fullName;
     user.phone = phone;
 
-    if (!database.insertUser(user)) {
-        return makeError(QStringLiteral("REGISTER"), frame.requestId, QStringLiteral("Failed to create user"));
+    const bool queued = passwordHasher.hashAsync(password, [this, frame, done, user](const QString &record) mutable {
+        user.password = record;
+        // Committed together with other pending inserts; the UNIQUE index settles signup races.
+        const bool accepted = writeBatcher.submit([user](Database &db) { return db.insertUser(user); },
+            [this, frame, done](WriteResult result) {
+                if (result == WriteResult::Duplicate) {
+                    done(makeError(frame, QStringLiteral("Email already registered")));
+                    return;
+                }
+                if (result != WriteResult::Ok) {
+                    done(makeError(frame, QStringLiteral("Failed to create user")));
+                    return;
+                }
+
+                QCborMap payload;
+                payload.insert(QStringLiteral("message"), QStringLiteral("Register success"));
+                done(Response{Command::RegisterOk, frame.requestId, payload});
+            });
+        if (!accepted) {
+            done(makeError(frame, QStringLiteral("Server busy")));
+        }
+    });
+    if (!queued) {
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+void CommandHandler::handleCreateAuction(const Frame &frame, const CommandRegistry::Responder &done)
+{
+    constexpr qint64 kMinDurationSeconds = 60;
+    constexpr qint64 kMaxDurationSeconds = 30ll * 24 * 3600;
+
+    const QString title = frame.payload.value(QStringLiteral("title")).toString().trimmed();
+    qint64 startPrice = -1;
+    qint64 minIncrement = 1;
+    qint64 duration = 3600;
+    if (!readInteger(frame.payload, QStringLiteral("startPrice"), -1, startPrice)
+        || !readInteger(frame.payload, QStringLiteral("minIncrement"), 1, minIncrement)
+        || !readInteger(frame.payload, QStringLiteral("durationSeconds"), 3600, duration)) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid auction")));
+        return;
+    }
+
+    if (title.isEmpty() || startPrice < 0 || startPrice > AuctionRecord::kMaxAmount || minIncrement < 1
+        || minIncrement > AuctionRecord::kMaxAmount) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid auction")));
+        return;
+    }
+    if (duration < kMinDurationSeconds || duration > kMaxDurationSeconds) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid duration")));
+        return;
+    }
+    const QString category = frame.payload.value(QStringLiteral("category")).toString().trimmed().toLower();
+    if (category.size() > kMaxCategoryLength) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid category")));
+        return;
+    }
+
+    AuctionRecord auction;
+    auction.sellerId = frame.userId;
+    auction.title = title;
+    auction.description = frame.payload.value(QStringLiteral("description")).toString();
+    auction.category = category;
+    auction.startPrice = startPrice;
+    auction.minIncrement = minIncrement;
+    auction.createdAtMs = QDateTime::currentMSecsSinceEpoch();
+    auction.endsAtMs = auction.createdAtMs + duration * 1000;
+
+    const bool queued = auctionEngine.create(auction, [this, frame, done](const AuctionSnapshot *created) {
+        if (!created) {
+            done(auctionFailed(frame, 503, QStringLiteral("Server busy")));
+            return;
+        }
+        done(Response{Command::CreateAuctionOk, frame.requestId, created->toCbor()});
+    });
+    if (!queued) {
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+void CommandHandler::handlePlaceBid(const Frame &frame, const CommandRegistry::Responder &done)
+{
+    BidRecord bid;
+    bid.bidderId = frame.userId;
+    if (!readInteger(frame.payload, QStringLiteral("auctionId"), 0, bid.auctionId)
+        || !readInteger(frame.payload, QStringLiteral("amount"), 0, bid.amount) || bid.auctionId <= 0
+        || bid.amount <= 0 || bid.amount > AuctionRecord::kMaxAmount) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid bid")));
+        return;
     }
 
-    QJsonObject payload;
-    payload.insert(QStringLiteral("message"), QStringLiteral("Register success"));
-    return buildResponse(QStringLiteral("REGISTER_OK"), frame.requestId, payload);
+    const bool queued = auctionEngine.placeBid(bid, [this, frame, done](const BidOutcome &outcome) {
+        const AuctionRecord &auction = outcome.snapshot.auction;
+        Response response;
+        switch (outcome.status) {
+        case BidOutcome::Status::Accepted: {
+            QCborMap payload;
+            payload.insert(QStringLiteral("auctionId"), auction.id);
+            payload.insert(QStringLiteral("amount"), auction.currentPrice);
+            payload.insert(QStringLiteral("leaderId"), auction.leaderId);
+            payload.insert(QStringLiteral("bidCount"), auction.bidCount);
+            payload.insert(QStringLiteral("minimumBid"), outcome.minimumBid);
+            done(Response{Command::PlaceBidOk, frame.requestId, payload});
+            return;
+        }
+        case BidOutcome::Status::NotFound:
+            response = auctionFailed(frame, 404, QStringLiteral("Auction not found"));
+            break;
+        case BidOutcome::Status::Closed:
+            response = auctionFailed(frame, 410, QStringLiteral("Auction closed"));
+            break;
+        case BidOutcome::Status::OwnAuction:
+            response = auctionFailed(frame, 403, QStringLiteral("Cannot bid on your own auction"));
+            break;
+        case BidOutcome::Status::TooLow:
+            response = auctionFailed(frame, 409, QStringLiteral("Bid too low"));
+            break;
+        case BidOutcome::Status::Busy:
+            response = auctionFailed(frame, 503, QStringLiteral("Server busy"));
+            break;
+        }
+        if (outcome.status != BidOutcome::Status::NotFound) {
+            response.payload.insert(QStringLiteral("currentPrice"), auction.currentPrice);
+            response.payload.insert(QStringLiteral("minimumBid"), outcome.minimumBid);
+        }
+        done(response);
+    });
+    if (!queued) {
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+void CommandHandler::handleGetAuction(const Frame &frame, const CommandRegistry::Responder &done)
+{
+    qint64 auctionId = 0;
+    if (!readInteger(frame.payload, QStringLiteral("auctionId"), 0, auctionId)) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid auction id")));
+        return;
+    }
+    const bool queued = auctionEngine.get(auctionId, [this, frame, done](const AuctionSnapshot *auction) {
+        if (!auction) {
+            done(auctionFailed(frame, 404, QStringLiteral("Auction not found")));
+            return;
+        }
+        done(Response{Command::GetAuctionOk, frame.requestId, auction->toCbor()});
+    });
+    if (!queued) {
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+void CommandHandler::handleSubscribe(const Frame &frame, const CommandRegistry::Responder &done)
+{
+    qint64 auctionId = 0;
+    if (!readInteger(frame.payload, QStringLiteral("auctionId"), 0, auctionId)) {
+        done(auctionFailed(frame, 400, QStringLiteral("Invalid auction id")));
+        return;
+    }
+    ClientSession *session = frame.session;
+    if (!session) {
+        done(makeError(frame, QStringLiteral("Not a connection")));
+        return;
+    }
+    if (!priceFeed.subscribe(session, auctionId)) {
+        done(auctionFailed(frame, 429, QStringLiteral("Too many subscriptions")));
+        return;
+    }
+
+    // Subscribed before reading the state, so no bid falls between the two. In
+    // ordered mode pushes can still overtake this reply; clients keep the
+    // state with the higher bidCount.
+    const bool queued = auctionEngine.get(auctionId, [this, frame, done, session, auctionId](const AuctionSnapshot *auction) {
+        if (!auction) {
+            // Posted ahead of the reply, and the session lives until the reply is written.
+            QMetaObject::invokeMethod(session, [this, session, auctionId]() {
+                priceFeed.unsubscribe(session, auctionId);
+            }, Qt::QueuedConnection);
+            done(auctionFailed(frame, 404, QStringLiteral("Auction not found")));
+            return;
+        }
+        done(Response{Command::SubscribeOk, frame.requestId, auction->toCbor()});
+    });
+    if (!queued) {
+        priceFeed.unsubscribe(session, auctionId);
+        done(makeError(frame, QStringLiteral("Server busy")));
+    }
+}
+
+Response CommandHandler::handleUnsubscribe(const Frame &frame)
+{
+    qint64 auctionId = 0;
+    if (!readInteger(frame.payload, QStringLiteral("auctionId"), 0, auctionId)) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid auction id"));
+    }
+    if (frame.session) {
+        priceFeed.unsubscribe(frame.session, auctionId);
+    }
+
+    QCborMap payload;
+    payload.insert(QStringLiteral("auctionId"), auctionId);
+    return Response{Command::UnsubscribeOk, frame.requestId, payload};
+}
+
+Response CommandHandler::handleListAuctions(const Frame &frame)
+{
+    qint64 beforeId = 0;
+    qint64 requestedLimit = kDefaultPageSize;
+    if (!readInteger(frame.payload, QStringLiteral("beforeId"), 0, beforeId)
+        || !readInteger(frame.payload, QStringLiteral("limit"), kDefaultPageSize, requestedLimit)) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid page"));
+    }
+    if (beforeId <= 0) {
+        beforeId = std::numeric_limits<qint64>::max();
+    }
+    const int limit = static_cast<int>(qBound<qint64>(1, requestedLimit, kMaxPageSize));
+
+    QVector<AuctionRecord> auctions;
+    if (!database.listAuctions(beforeId, limit, QDateTime::currentMSecsSinceEpoch(), auctions)) {
+        return makeError(frame, QStringLiteral("Database error"));
+    }
+
+    QCborArray rows;
+    for (const AuctionRecord &auction : std::as_const(auctions)) {
+        rows.append(auctionRow(auction));
+    }
+
+    QCborMap payload;
+    payload.insert(QStringLiteral("auctions"), rows);
+    // A short page is the last one.
+    payload.insert(QStringLiteral("nextBeforeId"), auctions.size() == limit ? auctions.constLast().id : 0);
+    return Response{Command::ListAuctionsOk, frame.requestId, payload};
+}
+
+Response CommandHandler::handleSearchAuctions(const Frame &frame)
+{
+    const QCborMap &payload = frame.payload;
+    AuctionSearch search;
+
+    const QString text = payload.value(QStringLiteral("query")).toString();
+    if (text.size() > kMaxQueryLength) {
+        return auctionFailed(frame, 400, QStringLiteral("Query too long"));
+    }
+    search.match = ftsQuery(text);
+    if (search.match.isEmpty() && !text.trimmed().isEmpty()) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid query"));
+    }
+
+    search.category = payload.value(QStringLiteral("category")).toString().trimmed().toLower();
+    if (search.category.size() > kMaxCategoryLength) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid category"));
+    }
+
+    const QString status = payload.value(QStringLiteral("status")).toString(QStringLiteral("open"));
+    if (status != QLatin1String("open") && status != QLatin1String("closed")) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid status"));
+    }
+    search.open = status == QLatin1String("open");
+    search.nowMs = QDateTime::currentMSecsSinceEpoch();
+
+    const QString sort = payload.value(QStringLiteral("sort")).toString(QStringLiteral("newest"));
+    if (sort == QLatin1String("endingSoon")) {
+        // Matches come out of FTS5 by rowid; any other order would sort them all.
+        if (!search.match.isEmpty()) {
+            return auctionFailed(frame, 400, QStringLiteral("endingSoon cannot be combined with query"));
+        }
+        search.order = AuctionSearch::Order::EndingSoon;
+    } else if (sort != QLatin1String("newest")) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid sort"));
+    }
+
+    qint64 limit = kDefaultSearchPageSize;
+    if (!readInteger(payload, QStringLiteral("endsAfter"), search.endsAfterMs, search.endsAfterMs)
+        || !readInteger(payload, QStringLiteral("endsBefore"), search.endsBeforeMs, search.endsBeforeMs)) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid time range"));
+    }
+    if (!readInteger(payload, QStringLiteral("limit"), kDefaultSearchPageSize, limit)) {
+        return auctionFailed(frame, 400, QStringLiteral("Invalid limit"));
+    }
+    search.limit = static_cast<int>(qBound<qint64>(1, limit, kMaxSearchPageSize));
+
+    // "<id>" for newest, "<endsAt>:<id>" for endingSoon; clients pass it back as is.
+    const QString cursor = payload.value(QStringLiteral("cursor")).toString();
+    if (!cursor.isEmpty()) {
+        const QStringList parts = cursor.split(QLatin1Char(':'));
+        const bool ending = search.order == AuctionSearch::Order::EndingSoon;
+        bool idOk = false;
+        bool endsOk = !ending;
+        search.afterId = parts.constLast().toLongLong(&idOk);
+        if (ending && parts.size() == 2) {
+            search.afterEndsAtMs = parts.constFirst().toLongLong(&endsOk);
+        }
+        if (parts.size() != (ending ? 2 : 1) || !idOk || !endsOk || search.afterId <= 0) {
+            return auctionFailed(frame, 400, QStringLiteral("Invalid cursor"));
+        }
+    }
+
+    QVector<AuctionRecord> auctions;
+    if (!database.searchAuctions(search, auctions)) {
+        return makeError(frame, QStringLiteral("Database error"));
+    }
+
+    QCborArray rows;
+    for (const AuctionRecord &auction : std::as_const(auctions)) {
+        rows.append(auctionRow(auction));
+    }
+
+    QString nextCursor; // empty after a short page, which is the last one
+    if (auctions.size() == search.limit) {
+        const AuctionRecord &last = auctions.constLast();
+        nextCursor = search.order == AuctionSearch::Order::EndingSoon
+                         ? QStringLiteral("%1:%2").arg(last.endsAtMs).arg(last.id)
+                         : QString::number(last.id);
+    }
+
+    QCborMap reply;
+    reply.insert(QStringLiteral("auctions"), rows);
+    reply.insert(QStringLiteral("nextCursor"), nextCursor);
+    return Response{Command::SearchAuctionsOk, frame.requestId, reply};
+}
+
+Response CommandHandler::auctionFailed(const Frame &frame, int code, const QString &message) const
+{
+    QCborMap payload;
+    payload.insert(QStringLiteral("code"), code);
+    payload.insert(QStringLiteral("message"), message);
+    return Response{BinaryProtocol::failReply(frame.commandId), frame.requestId, payload};
+}
+
+Response CommandHandler::throttledReply(const Frame &frame) const
+{
+    // Built once; every throttled reply shares this payload.
+    static const QCborMap payload{
+        {QStringLiteral("code"), 429},
+        {QStringLiteral("message"), QStringLiteral("Too many requests")},
+    };
+    return Response{BinaryProtocol::failReply(frame.commandId), frame.requestId, payload};
+}
+
+Response CommandHandler::failResponse(const Frame &frame, const QCborMap &payload) const
+{
+    Response response{Command::Unknown, frame.requestId, payload};
+    if (registry.find(frame.commandId)) {
+        response.command = BinaryProtocol::failReply(frame.commandId);
+    } else if (!frame.command.isEmpty()) {
+        response.commandName = frame.command + "_FAIL";
+    } else {
+        response.command = Command::Error;
+    }
+    return response;
 }
 
-QByteArray CommandHandler::makeError(const QString &cmd, quint64 reqId, const QString &message)
+Response CommandHandler::makeError(const Frame &frame, const QString &message) const
 {
-    QJsonObject payload;
+    QCborMap payload;
     payload.insert(QStringLiteral("message"), message);
-    return buildResponse(cmd + QStringLiteral("_FAIL"), reqId, payload);
+    return failResponse(frame, payload);
 }
@@ -1,28 +1,80 @@
 #ifndef COMMANDHANDLER_H
 #define COMMANDHANDLER_H
 
+#include <QJsonArray>
 #include <QObject>
 #include <QString>
 
+#include <memory>
+
+#include "protocol/CommandRegistry.h"
 #include "protocol/Protocol.h"
+#include "protocol/RateLimiter.h"
 
+class AuctionEngine;
 class Database;
+class PasswordHasher;
+class PriceFeed;
+class SessionStore;
+class WorkerPool;
+class WriteBatcher;
 
 class CommandHandler : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit CommandHandler(Database &db, QObject *parent = nullptr);
+    // Async commands run on workers; without a pool they run inline like sync ones.
+    CommandHandler(Database &db, PasswordHasher &hasher, SessionStore &sessions, AuctionEngine &auctions,
+                   PriceFeed &feed, WriteBatcher &writer, WorkerPool *workers = nullptr, QObject *parent = nullptr);
+
+    // Runs the handler registered for frame and hands its reply to done, either
+    // inline or later from a worker thread.
+    void dispatch(const Frame &frame, const CommandRegistry::Responder &done);
+
+    // Enables per-address and per-user throttling of rate-limited commands.
+    // Must be called before the first dispatch; there is no limiting without it.
+    void setRateLimits(const RateLimitOptions &options);
+    quint64 throttledRequests() const { return rateLimiter ? rateLimiter->throttledCount() : 0; }
+
+    // Per-command call counts and latency, see CommandRegistry::statsSnapshot().
+    QJsonArray commandStats() const { return registry.statsSnapshot(); }
 
-    QByteArray handle(const Frame &frame);
+    // Failure reply for frame carrying payload: <CMD>_FAIL by id for registered
+    // commands, by name for other verbs, ERROR when there is no name at all.
+    Response failResponse(const Frame &frame, const QCborMap &payload) const;
 
 private:
-    QByteArray handleLogin(const Frame &frame);
-    QByteArray handleRegister(const Frame &frame);
-    QByteArray makeError(const QString &cmd, quint64 reqId, const QString &message);
+    void dispatchFrame(const Frame &frame, const CommandRegistry::Responder &done);
+    Response handlePing(const Frame &frame);
+    Response handleStats(const Frame &frame);
+    void handleLogin(const Frame &frame, const CommandRegistry::Responder &done);
+    void handleRegister(const Frame &frame, const CommandRegistry::Responder &done);
+    Response handleLogout(const Frame &frame);
+    Response handleResume(const Frame &frame);
+    void handleCreateAuction(const Frame &frame, const CommandRegistry::Responder &done);
+    void handlePlaceBid(const Frame &frame, const CommandRegistry::Responder &done);
+    void handleGetAuction(const Frame &frame, const CommandRegistry::Responder &done);
+    void handleSubscribe(const Frame &frame, const CommandRegistry::Responder &done);
+    Response handleUnsubscribe(const Frame &frame);
+    Response handleListAuctions(const Frame &frame);
+    Response handleSearchAuctions(const Frame &frame);
+    Response auctionFailed(const Frame &frame, int code, const QString &message) const;
+    // Also charges the attempt to the username's failed-login budget.
+    Response loginFailed(const Frame &frame);
+    Response throttledReply(const Frame &frame) const;
+    Response makeError(const Frame &frame, const QString &message) const;
 
     Database &database;
+    PasswordHasher &passwordHasher;
+    SessionStore &sessionStore;
+    AuctionEngine &auctionEngine;
+    PriceFeed &priceFeed;
+    WriteBatcher &writeBatcher;
+    WorkerPool *workerPool;
+    CommandRegistry registry;
+    std::unique_ptr<RateLimiter> rateLimiter;
+    Metrics::Histogram *dispatchLatency;
 };
 
 #endif // COMMANDHANDLER_H
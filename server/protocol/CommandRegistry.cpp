@@ -0,0 +1,45 @@
+#include "CommandRegistry.h"
+
+#include <QJsonObject>
+
+void CommandRegistry::add(const CommandSpec &spec, Handler handler)
+{
+    insert(spec).handler = std::move(handler);
+}
+
+void CommandRegistry::addAsync(const CommandSpec &spec, AsyncHandler handler)
+{
+    insert(spec).asyncHandler = std::move(handler);
+}
+
+CommandRegistry::Entry &CommandRegistry::insert(const CommandSpec &spec)
+{
+    const auto index = static_cast<size_t>(spec.id);
+    if (index >= entries.size()) {
+        entries.resize(index + 1);
+    }
+    entries[index] = std::make_unique<Entry>();
+    entries[index]->spec = spec;
+    entries[index]->latency = Metrics::Registry::instance().histogram(
+        "auction_command_seconds", "Time from dispatch to reply, per command.", "command",
+        BinaryProtocol::commandName(spec.id));
+    return *entries[index];
+}
+
+QJsonArray CommandRegistry::statsSnapshot() const
+{
+    QJsonArray stats;
+    for (const auto &entry : entries) {
+        if (!entry) {
+            continue;
+        }
+        const Metrics::Histogram::Snapshot latency = entry->latency->snapshot();
+        QJsonObject row;
+        row.insert(QStringLiteral("command"), QString::fromLatin1(BinaryProtocol::commandName(entry->spec.id)));
+        row.insert(QStringLiteral("calls"), static_cast<qint64>(latency.count));
+        row.insert(QStringLiteral("avgUs"), latency.count ? latency.sumNs / 1000.0 / latency.count : 0.0);
+        row.insert(QStringLiteral("maxUs"), latency.maxNs / 1000.0);
+        stats.append(row);
+    }
+    return stats;
+}
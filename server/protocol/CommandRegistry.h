@@ -0,0 +1,75 @@
+#ifndef COMMANDREGISTRY_H
+#define COMMANDREGISTRY_H
+
+#include <QJsonArray>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BinaryProtocol.h"
+#include "metrics/Metrics.h"
+#include "protocol/Protocol.h"
+
+enum class RateLimitClass
+{
+    None,
+    Auth,  // LOGIN / REGISTER: credential guessing and signup floods
+    Write, // state-changing auction traffic
+    Read,  // lookups and searches
+    Stats, // STATS: a full metrics snapshot per call
+};
+
+enum class Execution
+{
+    Sync,  // cheap; runs inline on the session's I/O thread
+    Async, // may block on SQLite or CPU-heavy work
+};
+
+struct CommandSpec
+{
+    BinaryProtocol::Command id = BinaryProtocol::Command::Unknown;
+    bool authRequired = false;
+    RateLimitClass rateLimit = RateLimitClass::None;
+    Execution execution = Execution::Sync;
+};
+
+// Handlers keyed by wire command id. Lookup is an index into a flat table, so
+// dispatch neither allocates nor compares strings. Every entry also records
+// its latency into a lock-free histogram.
+class CommandRegistry
+{
+public:
+    // Delivers the reply for one frame; called exactly once, from any thread.
+    using Responder = std::function<void(const Response &)>;
+    using Handler = std::function<Response(const Frame &)>;
+    using AsyncHandler = std::function<void(const Frame &, const Responder &)>;
+
+    struct Entry
+    {
+        CommandSpec spec;
+        Handler handler;           // set for handlers that answer inline
+        AsyncHandler asyncHandler; // set for handlers that answer later
+        Metrics::Histogram *latency = nullptr; // auction_command_seconds{command=...}
+    };
+
+    // Registering the same id twice replaces the earlier handler.
+    void add(const CommandSpec &spec, Handler handler);
+    void addAsync(const CommandSpec &spec, AsyncHandler handler);
+
+    const Entry *find(BinaryProtocol::Command id) const
+    {
+        const auto index = static_cast<size_t>(id);
+        return index < entries.size() ? entries[index].get() : nullptr;
+    }
+
+    // [{"command":"LOGIN","calls":N,"avgUs":x,"maxUs":y}, ...]
+    QJsonArray statsSnapshot() const;
+
+private:
+    Entry &insert(const CommandSpec &spec);
+
+    std::vector<std::unique_ptr<Entry>> entries;
+};
+
+#endif // COMMANDREGISTRY_H
@@ -1,42 +1,65 @@
 #include "Protocol.h"
 
+#include <QCborValue>
 #include <QJsonDocument>
+#include <QJsonObject>
 
-namespace {
-constexpr char kCmd[] = "CMD=";
-constexpr char kReq[] = "REQ=";
-constexpr char kLen[] = "LEN=";
-}
+using BinaryProtocol::Command;
 
-Frame parseFrame(const QByteArray &headerLine, const QByteArray &payloadBytes)
+Frame parseFrame(const RawFrame &raw)
 {
     Frame frame;
-    const QList<QByteArray> parts = headerLine.trimmed().split(';');
-    for (const QByteArray &part : parts) {
-        if (part.startsWith(kCmd)) {
-            frame.command = QString::fromUtf8(part.mid(strlen(kCmd)));
-        } else if (part.startsWith(kReq)) {
-            frame.requestId = part.mid(strlen(kReq)).toULongLong();
-        } else if (part.startsWith(kLen)) {
-            // length is validated by session.
+    frame.requestId = raw.requestId;
+
+    if (raw.binary) {
+        frame.commandId = static_cast<Command>(raw.commandId);
+        frame.command = BinaryProtocol::commandName(frame.commandId);
+        const QCborValue payload = QCborValue::fromCbor(raw.payload);
+        if (payload.isMap()) {
+            frame.payload = payload.toMap();
         }
+        return frame;
     }
 
-    const QJsonDocument doc = QJsonDocument::fromJson(payloadBytes);
+    // raw.command is a view, so the common exact-case lookup does not allocate.
+    frame.commandId = BinaryProtocol::commandFromName(raw.command);
+    if (frame.commandId == Command::Unknown) {
+        frame.commandId = BinaryProtocol::commandFromName(raw.command.toUpper());
+    }
+    frame.command = frame.commandId != Command::Unknown
+                        ? BinaryProtocol::commandName(frame.commandId)
+                        : QByteArray(raw.command.constData(), raw.command.size());
+
+    const QJsonDocument doc = QJsonDocument::fromJson(raw.payload);
     if (doc.isObject()) {
-        frame.payload = doc.object();
+        frame.payload = QCborMap::fromJsonObject(doc.object());
     }
     return frame;
 }
 
-QByteArray buildResponse(const QString &command, quint64 reqId, const QJsonObject &payload)
+QByteArray buildResponse(const QByteArray &command, quint64 reqId, const QCborMap &payload)
 {
-    const QByteArray json = QJsonDocument(payload).toJson(QJsonDocument::Compact);
-    const QString header = QStringLiteral("CMD=%1;REQ=%2;LEN=%3\n")
-                               .arg(command)
-                               .arg(reqId)
-                               .arg(json.size());
-    QByteArray out = header.toUtf8();
+    const QByteArray json = QJsonDocument(payload.toJsonObject()).toJson(QJsonDocument::Compact);
+    QByteArray out;
+    out.reserve(command.size() + json.size() + 48);
+    out.append("CMD=").append(command);
+    out.append(";REQ=").append(QByteArray::number(reqId));
+    out.append(";LEN=").append(QByteArray::number(json.size()));
+    out.append('\n');
     out.append(json);
     return out;
 }
+
+QByteArray encodeResponse(const Response &response, ProtocolVersion version)
+{
+    if (version == ProtocolVersion::Text) {
+        const QByteArray name = response.command != Command::Unknown ? BinaryProtocol::commandName(response.command)
+                                                                     : response.commandName;
+        return buildResponse(name, response.requestId, response.payload);
+    }
+
+    // Replies to verbs without a wire id go out as ERROR.
+    const Command command = response.command != Command::Unknown ? response.command : Command::Error;
+    const QByteArray cbor = response.payload.toCborValue().toCbor();
+    return BinaryProtocol::encodeFrame(command, response.requestId, cbor);
+}
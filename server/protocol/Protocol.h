@@ -2,17 +2,42 @@
 #define PROTOCOL_H
 
 #include <QByteArray>
-#include <QJsonObject>
+#include <QCborMap>
 #include <QString>
 
+#include "BinaryProtocol.h"
+#include "FrameDecoder.h"
+
+class ClientSession;
+
+enum class ProtocolVersion
+{
+    Text = 1,   // CMD=...;REQ=...;LEN=...\n + compact JSON
+    Binary = 2, // BinaryProtocol header + CBOR
+};
+
 struct Frame
 {
-    QString command;
+    BinaryProtocol::Command commandId = BinaryProtocol::Command::Unknown;
+    QByteArray command; // wire name, kept for logs and errors on unknown verbs
+    quint64 requestId = 0;
+    // Decoded once on arrival; v2 CBOR is kept as is, v1 JSON is converted.
+    QCborMap payload;
+    qint64 userId = 0; // set by dispatch once an authRequired command's token checks out
+    QString username;  // likewise
+    ClientSession *session = nullptr; // connection it arrived on, for per-connection commands
+};
+
+struct Response
+{
+    BinaryProtocol::Command command = BinaryProtocol::Command::Unknown;
     quint64 requestId = 0;
-    QJsonObject payload;
+    QCborMap payload;
+    QByteArray commandName; // only for replies without a wire id, e.g. "FOO_FAIL"
 };
 
-Frame parseFrame(const QByteArray &headerLine, const QByteArray &payloadBytes);
-QByteArray buildResponse(const QString &command, quint64 reqId, const QJsonObject &payload);
+Frame parseFrame(const RawFrame &raw);
+QByteArray buildResponse(const QByteArray &command, quint64 reqId, const QCborMap &payload);
+QByteArray encodeResponse(const Response &response, ProtocolVersion version);
 
 #endif // PROTOCOL_H
@@ -0,0 +1,79 @@
+#include "RateLimiter.h"
+
+#include <QtGlobal>
+
+RateLimiter::RateLimiter(const RateLimitOptions &options)
+    : options(options)
+{
+    clock.start();
+    const int perShard = qMax(1, options.maxKeys / kShardCount);
+    for (Shard &shard : shards) {
+        shard.buckets.setMaxCost(perShard);
+    }
+}
+
+bool RateLimiter::allow(RateLimitClass rateClass, const QString &address)
+{
+    const qint64 nowNs = clock.nsecsElapsed();
+    bool allowed = true;
+    switch (rateClass) {
+    case RateLimitClass::None:
+        return true;
+    case RateLimitClass::Auth:
+        allowed = take(options.authPerAddress, QStringLiteral("a:") + address, nowNs);
+        break;
+    case RateLimitClass::Write:
+        allowed = take(options.writePerAddress, QStringLiteral("w:") + address, nowNs);
+        break;
+    case RateLimitClass::Read:
+        allowed = take(options.readPerAddress, QStringLiteral("r:") + address, nowNs);
+        break;
+    case RateLimitClass::Stats:
+        allowed = take(options.statsPerAddress, QStringLiteral("s:") + address, nowNs);
+        break;
+    }
+    if (!allowed) {
+        throttled.fetch_add(1, std::memory_order_relaxed);
+    }
+    return allowed;
+}
+
+bool RateLimiter::loginAllowed(const QString &username)
+{
+    // Keyed by username, so one account cannot be guessed at from many
+    // addresses a few attempts at a time.
+    if (take(options.authPerUser, userKey(username), clock.nsecsElapsed(), 0.0)) {
+        return true;
+    }
+    throttled.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void RateLimiter::recordLoginFailure(const QString &username)
+{
+    take(options.authPerUser, userKey(username), clock.nsecsElapsed());
+}
+
+bool RateLimiter::take(const RateLimit &limit, const QString &key, qint64 nowNs, double cost)
+{
+    // A two-character key means the address or username was empty.
+    if (!limit.enabled() || key.size() <= 2) {
+        return true;
+    }
+
+    Shard &shard = shards[qHash(key) % kShardCount];
+    QMutexLocker locker(&shard.mutex);
+    Bucket *bucket = shard.buckets.object(key);
+    if (!bucket) {
+        bucket = new Bucket{limit.burst, nowNs};
+        shard.buckets.insert(key, bucket); // evicts the least recently used bucket when full
+    } else {
+        bucket->tokens = qMin(limit.burst, bucket->tokens + (nowNs - bucket->updatedNs) * limit.perSecond / 1e9);
+        bucket->updatedNs = nowNs;
+    }
+    if (bucket->tokens < 1.0) {
+        return false;
+    }
+    bucket->tokens -= cost;
+    return true;
+}
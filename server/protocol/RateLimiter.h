@@ -0,0 +1,79 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+#include <atomic>
+
+#include "protocol/CommandRegistry.h"
+
+// Sustained rate and burst size of one token bucket; perSecond <= 0 disables it.
+struct RateLimit
+{
+    double perSecond = 0;
+    double burst = 0;
+
+    bool enabled() const { return perSecond > 0; }
+};
+
+struct RateLimitOptions
+{
+    RateLimit authPerAddress{2, 20};  // LOGIN / REGISTER per client address
+    RateLimit authPerUser{0.2, 5};    // failed LOGINs per username
+    RateLimit writePerAddress{200, 400};
+    RateLimit readPerAddress{1000, 2000};
+    RateLimit statsPerAddress{1, 5};
+    // Buckets kept in memory; the least recently used are forgotten first.
+    int maxKeys = 100000;
+};
+
+// Token buckets per client address, one set per RateLimitClass, plus one
+// per username that only failed logins drain. Buckets live in a sharded
+// LRU, so memory stays bounded no matter how many keys a flood uses; an
+// evicted bucket simply starts full again. Safe to call from any thread.
+class RateLimiter
+{
+public:
+    explicit RateLimiter(const RateLimitOptions &options);
+
+    // Takes one token from the address bucket of rateClass. An empty address
+    // is not limited. Returns false if the bucket was empty.
+    bool allow(RateLimitClass rateClass, const QString &address);
+    // False while username has used up its failed-login budget; takes nothing,
+    // so correct passwords never lock an account.
+    bool loginAllowed(const QString &username);
+    // Charges one failed login to username.
+    void recordLoginFailure(const QString &username);
+    quint64 throttledCount() const { return throttled.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kShardCount = 16;
+
+    struct Bucket
+    {
+        double tokens = 0;
+        qint64 updatedNs = 0;
+    };
+
+    struct Shard
+    {
+        QMutex mutex;
+        QCache<QString, Bucket> buckets;
+    };
+
+    // Refills key's bucket and takes one token if cost is 1; with cost 0 it
+    // only reports whether a token is there.
+    bool take(const RateLimit &limit, const QString &key, qint64 nowNs, double cost = 1.0);
+    static QString userKey(const QString &username) { return QStringLiteral("u:") + username.toLower(); }
+
+    const RateLimitOptions options;
+    QElapsedTimer clock;
+    std::array<Shard, kShardCount> shards;
+    std::atomic<quint64> throttled{0};
+};
+
+#endif // RATELIMITER_H
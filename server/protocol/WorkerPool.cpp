@@ -0,0 +1,26 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadCount, int maxQueueDepth)
+    : maxDepth(qMax(1, maxQueueDepth))
+{
+    pool.setMaxThreadCount(qMax(1, threadCount));
+    pool.setExpiryTimeout(-1);
+}
+
+WorkerPool::~WorkerPool()
+{
+    pool.waitForDone();
+}
+
+bool WorkerPool::submit(std::function<void()> job)
+{
+    if (pending.fetchAndAddRelaxed(1) >= maxDepth) {
+        pending.fetchAndAddRelaxed(-1);
+        return false;
+    }
+    pool.start([this, job = std::move(job)]() {
+        job();
+        pending.fetchAndAddRelaxed(-1);
+    });
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QAtomicInt>
+#include <QThreadPool>
+
+#include <functional>
+
+// Fixed set of long-lived threads for blocking command work (SQLite, KDFs).
+// Threads never expire so their pooled database connections stay open, and
+// the queue is bounded: submit() refuses work instead of growing without limit.
+class WorkerPool
+{
+public:
+    WorkerPool(int threadCount, int maxQueueDepth);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Returns false, without running job, when maxQueueDepth jobs are already pending.
+    bool submit(std::function<void()> job);
+    // Blocks until every accepted job has run.
+    void drain() { pool.waitForDone(); }
+
+    int pendingJobs() const { return pending.loadRelaxed(); }
+    int threadCount() const { return pool.maxThreadCount(); }
+
+private:
+    QThreadPool pool;
+    const int maxDepth;
+    QAtomicInt pending;
+};
+
+#endif // WORKERPOOL_H